@@ -0,0 +1,684 @@
+// 跨後端基準測試（make bench）：
+// 對每個程式、每個後端先編譯（記錄編譯時間），再暖身執行 warmup 次、正式執行 runs 次，
+// 以 JSON 輸出牆鐘時間的中位數 / p95 / 最小值、編譯時間與輸出的 FNV-1a 校驗和。
+// 同一個程式在所有後端的校驗和必須相同；給定 --baseline 時與先前存下的結果比較，
+// 中位數變慢超過 --threshold 百分比即視為效能退步，結束狀態為 1。
+//
+// 每次執行另以 perf_event_open 計數（只計使用者態）：指令數、週期數、分支預測失誤、
+// L1 指令 / 資料快取失誤與 task-clock，取各次執行的中位數，並算出 IPC；
+// 另以 interpreter --count-ops 取得每個程式執行的 IR 指令數，換算成每個後端每秒執行的 BF 指令數。
+// 硬體計數器不可用（虛擬機、perf_event_paranoid 過高）時對應欄位輸出 null。
+//
+// 後端：interpreter、jit（interpreter --jit）、tiered（interpreter --tiered）、x86（compiler_x86 + as/ld）、
+//       x86_64（compiler_x86_64 + cc -nostdlib）、x86_64_elf（compiler_x86_64 --emit-elf，不經過組譯與連結）、llvm（llvm/llvm.c -O2 + llc + cc）、
+//       llvm_jit（compiler_llvm --jit，執行時間包含行程內的最佳化與 codegen）
+// 工具鏈找不到（例如沒有安裝 llc）時略過該後端並在 stderr 提示。
+//
+// 用法：bf_bench [--build DIR] [--work DIR] [--runs N] [--warmup N] [--backends LIST]
+//                [--json FILE] [--baseline FILE] [--threshold PCT] [--no-counters] program.bf...
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../util.h"
+
+#define MAX_RUNS 1000
+// 差距小於此毫秒數時不視為退步，避免 hello.bf 這類極短程式被雜訊誤判
+#define MIN_DELTA_MS 1.0
+
+// 每次執行收集的計數器；type / config 對應 perf_event_attr
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct counter_def {
+    const char *name;       // JSON 欄位名稱
+    uint32_t type;
+    uint64_t config;
+} counter_defs[] = {
+    {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1i_misses",    PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1I)},
+    {"l1d_misses",    PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+#define NUM_COUNTERS (sizeof(counter_defs) / sizeof(counter_defs[0]))
+#define COUNTER_INSTRUCTIONS 0
+#define COUNTER_CYCLES 1
+#define COUNTER_NONE (-1)   // 計數器不可用
+
+struct bench_config {
+    const char *build;      // make 產生的執行檔所在目錄
+    const char *work;       // 編譯產物（.s / .ll / 執行檔）的目錄
+    int runs;
+    int warmup;
+    double threshold;       // 效能退步門檻（百分比）
+    int counters;           // 是否收集 perf 計數器
+};
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// FNV-1a 64 位元，逐塊累積
+static uint64_t fnv1a(uint64_t h, const uint8_t *p, size_t n){
+    for (size_t i = 0; i < n; i++){
+        h ^= p[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+#define FNV_INIT UINT64_C(0xcbf29ce484222325)
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid){
+    return (int)syscall(SYS_perf_event_open, attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// 為尚未 exec 的子行程開啟計數器：exec 時才開始計數，只計使用者態。
+// 開不起來的計數器 fd 為 -1，並只提示一次
+static void counters_open(pid_t pid, int fds[NUM_COUNTERS]){
+    static int warned[NUM_COUNTERS];
+    for (size_t i = 0; i < NUM_COUNTERS; i++){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_defs[i].type;
+        attr.config = counter_defs[i].config;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // 計數器多於硬體暫存器時會被多工輪替，讀取時依實際計數時間比例放大
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[i] = perf_event_open(&attr, pid);
+        if (fds[i] < 0 && !warned[i]){
+            fprintf(stderr, "bf_bench: perf counter %s unavailable (%s)\n", counter_defs[i].name, strerror(errno));
+            warned[i] = 1;
+        }
+    }
+}
+
+static void counters_read(int fds[NUM_COUNTERS], int64_t counts[NUM_COUNTERS]){
+    for (size_t i = 0; i < NUM_COUNTERS; i++){
+        uint64_t data[3];   // value, time_enabled, time_running
+        counts[i] = COUNTER_NONE;
+        if (fds[i] < 0){
+            continue;
+        }
+        if (read(fds[i], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] > 0){
+            counts[i] = (int64_t)((double)data[0] * (double)data[1] / (double)data[2]);
+        }
+        close(fds[i]);
+    }
+}
+
+// 執行 argv：stdin 接 /dev/null；stdout 寫到 out_path，或（out_path 為 NULL 時）經由 pipe 計算校驗和；
+// err_path 不為 NULL 時 stderr 寫到該檔案。counts 不為 NULL 時收集 perf 計數器：
+// 子行程先等待 go pipe，父行程開好計數器後才放行 exec，計數範圍恰好是被測程式本身。
+// 回傳經過的毫秒數；無法執行或結束狀態不為 0 時回傳 -1
+static double spawn(char *const argv[], const char *out_path, const char *err_path, uint64_t *checksum, int64_t counts[]){
+    int fds[2] = {-1, -1};
+    int go[2] = {-1, -1};
+    if (out_path == NULL && pipe(fds) != 0){
+        err("pipe failed");
+    }
+    if (counts != NULL && pipe(go) != 0){
+        err("pipe failed");
+    }
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0){
+        err("fork failed");
+    }
+    if (pid == 0){
+        int in = open("/dev/null", O_RDONLY);
+        if (in >= 0){
+            dup2(in, STDIN_FILENO);
+            close(in);
+        }
+        if (out_path != NULL){
+            int out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out < 0){
+                _exit(127);
+            }
+            dup2(out, STDOUT_FILENO);
+            close(out);
+        }else{
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+        }
+        if (err_path != NULL){
+            int out = open(err_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out < 0){
+                _exit(127);
+            }
+            dup2(out, STDERR_FILENO);
+            close(out);
+        }
+        if (counts != NULL){
+            char c;
+            close(go[1]);
+            while (read(go[0], &c, 1) < 0 && errno == EINTR){
+            }
+            close(go[0]);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    int counter_fds[NUM_COUNTERS];
+    if (counts != NULL){
+        counters_open(pid, counter_fds);
+        close(go[0]);
+        // 計時從放行子行程開始，不含開啟計數器的時間
+        start = now_ms();
+        close(go[1]);
+    }
+
+    uint64_t h = FNV_INIT;
+    if (out_path == NULL){
+        static uint8_t buf[1 << 16];
+        close(fds[1]);
+        for (;;){
+            ssize_t n = read(fds[0], buf, sizeof(buf));
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n <= 0){
+                break;
+            }
+            h = fnv1a(h, buf, (size_t)n);
+        }
+        close(fds[0]);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR){
+    }
+    double elapsed = now_ms() - start;
+    if (counts != NULL){
+        counters_read(counter_fds, counts);
+    }
+    if (checksum != NULL){
+        *checksum = h;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        return -1;
+    }
+    return elapsed;
+}
+
+// 依序執行編譯步驟，回傳總時間；任一步失敗回傳 -1
+static double run_steps(char *const *const steps[], const char *const outputs[], int n){
+    double total = 0;
+    for (int i = 0; i < n; i++){
+        double t = spawn(steps[i], outputs[i], NULL, NULL, NULL);
+        if (t < 0){
+            return -1;
+        }
+        total += t;
+    }
+    return total;
+}
+
+// 一個後端：prepare() 把 src 編譯到 exe（解譯類後端不需要），填入執行用的 argv，回傳編譯時間（毫秒）
+struct backend {
+    const char *name;
+    double (*prepare)(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv);
+};
+
+static double prepare_interpreter(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    (void)exe;
+    snprintf(tool, PATH_MAX, "%s/interpreter", cfg->build);
+    argv[0] = tool;
+    argv[1] = (char *)src;
+    argv[2] = NULL;
+    return 0;
+}
+
+static double prepare_jit(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    (void)exe;
+    snprintf(tool, PATH_MAX, "%s/interpreter", cfg->build);
+    argv[0] = tool;
+    argv[1] = "--jit";
+    argv[2] = (char *)src;
+    argv[3] = NULL;
+    return 0;
+}
+
+static double prepare_tiered(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    (void)exe;
+    snprintf(tool, PATH_MAX, "%s/interpreter", cfg->build);
+    argv[0] = tool;
+    argv[1] = "--tiered";
+    argv[2] = (char *)src;
+    argv[3] = NULL;
+    return 0;
+}
+
+static double prepare_x86(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    char s[PATH_MAX], o[PATH_MAX];
+    snprintf(tool, PATH_MAX, "%s/compiler_x86", cfg->build);
+    snprintf(s, sizeof(s), "%s.s", exe);
+    snprintf(o, sizeof(o), "%s.o", exe);
+    char *compile[] = {tool, (char *)src, NULL};
+    char *assemble[] = {"as", "--32", "-o", o, s, NULL};
+    char *link[] = {"ld", "-m", "elf_i386", "-o", (char *)exe, o, NULL};
+    char *const *steps[] = {compile, assemble, link};
+    const char *outputs[] = {s, NULL, NULL};
+    argv[0] = (char *)exe;
+    argv[1] = NULL;
+    return run_steps(steps, outputs, 3);
+}
+
+static double prepare_x86_64(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    char s[PATH_MAX];
+    snprintf(tool, PATH_MAX, "%s/compiler_x86_64", cfg->build);
+    snprintf(s, sizeof(s), "%s.s", exe);
+    char *compile[] = {tool, (char *)src, NULL};
+    char *link[] = {"cc", "-nostdlib", "-no-pie", "-o", (char *)exe, s, NULL};
+    char *const *steps[] = {compile, link};
+    const char *outputs[] = {s, NULL};
+    argv[0] = (char *)exe;
+    argv[1] = NULL;
+    return run_steps(steps, outputs, 2);
+}
+
+static double prepare_x86_64_elf(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    snprintf(tool, PATH_MAX, "%s/compiler_x86_64", cfg->build);
+    char *compile[] = {tool, "--emit-elf", (char *)exe, (char *)src, NULL};
+    char *const *steps[] = {compile};
+    const char *outputs[] = {NULL};
+    argv[0] = (char *)exe;
+    argv[1] = NULL;
+    return run_steps(steps, outputs, 1);
+}
+
+static double prepare_llvm(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    char ll[PATH_MAX], o[PATH_MAX];
+    snprintf(tool, PATH_MAX, "%s/compiler_llvm", cfg->build);
+    snprintf(ll, sizeof(ll), "%s.ll", exe);
+    snprintf(o, sizeof(o), "%s.o", exe);
+    char *compile[] = {tool, "-O2", (char *)src, NULL};
+    char *codegen[] = {"llc", "-O2", "-relocation-model=pic", "-filetype=obj", "-o", o, ll, NULL};
+    char *link[] = {"cc", "-o", (char *)exe, o, NULL};
+    char *const *steps[] = {compile, codegen, link};
+    const char *outputs[] = {ll, NULL, NULL};
+    argv[0] = (char *)exe;
+    argv[1] = NULL;
+    return run_steps(steps, outputs, 3);
+}
+
+static double prepare_llvm_jit(const struct bench_config *cfg, const char *src, const char *exe, char *tool, char **argv){
+    (void)exe;
+    snprintf(tool, PATH_MAX, "%s/compiler_llvm", cfg->build);
+    argv[0] = tool;
+    argv[1] = "--jit";
+    argv[2] = (char *)src;
+    argv[3] = NULL;
+    return 0;
+}
+
+static const struct backend backends[] = {
+    {"interpreter", prepare_interpreter},
+    {"jit",         prepare_jit},
+    {"tiered",      prepare_tiered},
+    {"x86",         prepare_x86},
+    {"x86_64",      prepare_x86_64},
+    {"x86_64_elf",  prepare_x86_64_elf},
+    {"llvm",        prepare_llvm},
+    {"llvm_jit",    prepare_llvm_jit},
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+// 解析以逗號分隔的後端名稱，回傳位元遮罩
+static unsigned parse_backend_list(const char *list){
+    unsigned mask = 0;
+    while (*list){
+        size_t len = strcspn(list, ",");
+        size_t j = 0;
+        while (j < NUM_BACKENDS && !(strlen(backends[j].name) == len && strncmp(list, backends[j].name, len) == 0)){
+            j++;
+        }
+        if (j == NUM_BACKENDS){
+            err("unknown backend (use interpreter, jit, tiered, x86, x86_64, x86_64_elf, llvm or llvm_jit)");
+        }
+        mask |= 1u << j;
+        list += len;
+        if (*list == ','){
+            list++;
+        }
+    }
+    return mask;
+}
+
+struct result {
+    char program[64];
+    const char *backend;
+    double compile_ms;
+    double median_ms;
+    double p95_ms;
+    double min_ms;
+    uint64_t checksum;
+    int64_t counters[NUM_COUNTERS];    // 各次執行的中位數，COUNTER_NONE 表示不可用
+    int64_t ops;                       // interpreter 執行的 IR 指令數，COUNTER_NONE 表示未知
+};
+
+static int compare_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_int64(const void *a, const void *b){
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 計數器樣本的中位數；任何一次沒有計到就視為不可用
+static int64_t counter_median(int64_t *samples, int n){
+    for (int i = 0; i < n; i++){
+        if (samples[i] == COUNTER_NONE){
+            return COUNTER_NONE;
+        }
+    }
+    qsort(samples, (size_t)n, sizeof(int64_t), compare_int64);
+    return n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+}
+
+// 已排序樣本的百分位數（nearest-rank）
+static double percentile(const double *sorted, int n, double p){
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    if (rank < 1){
+        rank = 1;
+    }
+    if (rank > n){
+        rank = n;
+    }
+    return sorted[rank - 1];
+}
+
+// 程式名稱：去掉目錄與 .bf 副檔名
+static void program_name(const char *path, char *name, size_t size){
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(name, size, "%s", base);
+    char *dot = strrchr(name, '.');
+    if (dot != NULL && strcmp(dot, ".bf") == 0){
+        *dot = '\0';
+    }
+}
+
+// 編譯並量測一個 (程式, 後端)；後端無法使用時回傳 0
+static int bench_one(const struct bench_config *cfg, const struct backend *be, const char *src, struct result *r){
+    char exe[PATH_MAX], tool[PATH_MAX];
+    char *argv[8];
+    program_name(src, r->program, sizeof(r->program));
+    r->backend = be->name;
+    snprintf(exe, sizeof(exe), "%s/%s.%s", cfg->work, r->program, be->name);
+
+    r->compile_ms = be->prepare(cfg, src, exe, tool, argv);
+    if (r->compile_ms < 0){
+        fprintf(stderr, "bf_bench: skipping %s/%s (build failed)\n", r->program, be->name);
+        return 0;
+    }
+
+    static double samples[MAX_RUNS];
+    static int64_t counter_samples[NUM_COUNTERS][MAX_RUNS];
+    for (int i = 0; i < cfg->warmup + cfg->runs; i++){
+        uint64_t checksum;
+        int64_t counts[NUM_COUNTERS];
+        int measured = i >= cfg->warmup;
+        double t = spawn(argv, NULL, NULL, &checksum, measured && cfg->counters ? counts : NULL);
+        if (t < 0){
+            fprintf(stderr, "bf_bench: skipping %s/%s (run failed)\n", r->program, be->name);
+            return 0;
+        }
+        if (i == 0){
+            r->checksum = checksum;
+        }else if (checksum != r->checksum){
+            fprintf(stderr, "bf_bench: %s/%s output differs between runs\n", r->program, be->name);
+        }
+        if (measured){
+            samples[i - cfg->warmup] = t;
+            for (size_t c = 0; c < NUM_COUNTERS; c++){
+                counter_samples[c][i - cfg->warmup] = cfg->counters ? counts[c] : COUNTER_NONE;
+            }
+        }
+    }
+    for (size_t c = 0; c < NUM_COUNTERS; c++){
+        r->counters[c] = counter_median(counter_samples[c], cfg->runs);
+    }
+    qsort(samples, (size_t)cfg->runs, sizeof(double), compare_double);
+    r->median_ms = cfg->runs % 2 ? samples[cfg->runs / 2]
+                                 : (samples[cfg->runs / 2 - 1] + samples[cfg->runs / 2]) / 2;
+    r->p95_ms = percentile(samples, cfg->runs, 95);
+    r->min_ms = samples[0];
+    fprintf(stderr, "bf_bench: %-12s %-12s median %10.3f ms  p95 %10.3f ms  compile %8.3f ms\n",
+            r->program, be->name, r->median_ms, r->p95_ms, r->compile_ms);
+    return 1;
+}
+
+// 以 interpreter --count-ops 取得程式執行的 IR 指令數（stderr 最後一行 "executed ops: N"）
+static int64_t count_ops(const struct bench_config *cfg, const char *src){
+    char tool[PATH_MAX], log[PATH_MAX], name[64], line[128];
+    program_name(src, name, sizeof(name));
+    snprintf(tool, sizeof(tool), "%s/interpreter", cfg->build);
+    snprintf(log, sizeof(log), "%s/%s.ops", cfg->work, name);
+    char *argv[] = {tool, "--count-ops", (char *)src, NULL};
+    if (spawn(argv, "/dev/null", log, NULL, NULL) < 0){
+        fprintf(stderr, "bf_bench: unable to count ops of %s\n", name);
+        return COUNTER_NONE;
+    }
+    int64_t ops = COUNTER_NONE;
+    FILE *fp = fopen(log, "r");
+    if (fp != NULL){
+        long long n;
+        while (fgets(line, sizeof(line), fp) != NULL){
+            if (sscanf(line, "executed ops: %lld", &n) == 1){
+                ops = n;
+            }
+        }
+        fclose(fp);
+    }
+    return ops;
+}
+
+// 輸出 , "key": value；不可用時輸出 null
+static void json_field(FILE *fp, const char *key, double value, int valid, const char *format){
+    fprintf(fp, ", \"%s\": ", key);
+    if (valid){
+        fprintf(fp, format, value);
+    }else{
+        fprintf(fp, "null");
+    }
+}
+
+static void write_json(FILE *fp, const struct bench_config *cfg, const struct result *results, int n){
+    fprintf(fp, "{\n  \"runs\": %d,\n  \"warmup\": %d,\n  \"results\": [\n", cfg->runs, cfg->warmup);
+    for (int i = 0; i < n; i++){
+        const struct result *r = &results[i];
+        // 每筆結果一行，比較基準時逐行讀回
+        fprintf(fp, "    {\"program\": \"%s\", \"backend\": \"%s\", \"compile_ms\": %.3f, "
+                    "\"median_ms\": %.3f, \"p95_ms\": %.3f, \"min_ms\": %.3f, \"checksum\": \"%016llx\"",
+                r->program, r->backend, r->compile_ms, r->median_ms, r->p95_ms, r->min_ms,
+                (unsigned long long)r->checksum);
+        for (size_t c = 0; c < NUM_COUNTERS; c++){
+            json_field(fp, counter_defs[c].name, (double)r->counters[c], r->counters[c] != COUNTER_NONE, "%.0f");
+        }
+        int64_t insns = r->counters[COUNTER_INSTRUCTIONS], cycles = r->counters[COUNTER_CYCLES];
+        json_field(fp, "ipc", cycles > 0 ? (double)insns / (double)cycles : 0,
+                   insns != COUNTER_NONE && cycles > 0, "%.3f");
+        json_field(fp, "ops", (double)r->ops, r->ops != COUNTER_NONE, "%.0f");
+        json_field(fp, "ops_per_sec", r->median_ms > 0 ? (double)r->ops / (r->median_ms / 1e3) : 0,
+                   r->ops != COUNTER_NONE && r->median_ms > 0, "%.0f");
+        fprintf(fp, "}%s\n", i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+// 從一行 JSON 取出字串欄位 "key": "value"
+static int json_string(const char *line, const char *key, char *out, size_t size){
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL){
+        return 0;
+    }
+    p += strlen(pattern);
+    size_t len = strcspn(p, "\"");
+    if (len >= size){
+        return 0;
+    }
+    memcpy(out, p, len);
+    out[len] = '\0';
+    return 1;
+}
+
+// 從一行 JSON 取出數值欄位 "key": number
+static int json_number(const char *line, const char *key, double *out){
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *p = strstr(line, pattern);
+    return p != NULL && sscanf(p + strlen(pattern), "%lf", out) == 1;
+}
+
+// 與基準比較中位數，回傳退步的項目數；基準中沒有的項目不比較
+static int compare_baseline(const char *path, const struct result *results, int n, double threshold){
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL){
+        fprintf(stderr, "bf_bench: baseline %s not found, skipping comparison\n", path);
+        return 0;
+    }
+    int regressions = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL){
+        char program[64], backend[32], checksum[32];
+        double median;
+        if (!json_string(line, "program", program, sizeof(program)) ||
+            !json_string(line, "backend", backend, sizeof(backend)) ||
+            !json_number(line, "median_ms", &median)){
+            continue;
+        }
+        for (int i = 0; i < n; i++){
+            const struct result *r = &results[i];
+            if (strcmp(r->program, program) != 0 || strcmp(r->backend, backend) != 0){
+                continue;
+            }
+            double change = median > 0 ? (r->median_ms - median) / median * 100 : 0;
+            if (change > threshold && r->median_ms - median > MIN_DELTA_MS){
+                fprintf(stderr, "regression: %s/%s median %.3f ms vs baseline %.3f ms (%+.1f%% > %.1f%%)\n",
+                        program, backend, r->median_ms, median, change, threshold);
+                regressions++;
+            }
+            char now[32];
+            snprintf(now, sizeof(now), "%016llx", (unsigned long long)r->checksum);
+            if (json_string(line, "checksum", checksum, sizeof(checksum)) && strcmp(checksum, now) != 0){
+                fprintf(stderr, "regression: %s/%s output checksum %s differs from baseline %s\n",
+                        program, backend, now, checksum);
+                regressions++;
+            }
+        }
+    }
+    fclose(fp);
+    return regressions;
+}
+
+#define USAGE "Usage: bf_bench [--build DIR] [--work DIR] [--runs N] [--warmup N] [--backends LIST] [--json FILE] [--baseline FILE] [--threshold PCT] [--no-counters] program.bf..."
+
+int main(int argc, char *argv[]){
+    struct bench_config cfg = {"build", NULL, 5, 1, 10.0, 1};
+    unsigned backend_mask = (1u << NUM_BACKENDS) - 1;
+    const char *json_path = NULL;
+    const char *baseline = NULL;
+    const char *programs[256];
+    int num_programs = 0;
+
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--build") == 0 && i + 1 < argc){
+            cfg.build = argv[++i];
+        }else if (strcmp(argv[i], "--work") == 0 && i + 1 < argc){
+            cfg.work = argv[++i];
+        }else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc){
+            cfg.runs = atoi(argv[++i]);
+        }else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc){
+            cfg.warmup = atoi(argv[++i]);
+        }else if (strcmp(argv[i], "--backends") == 0 && i + 1 < argc){
+            backend_mask = parse_backend_list(argv[++i]);
+        }else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc){
+            json_path = argv[++i];
+        }else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc){
+            baseline = argv[++i];
+        }else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc){
+            cfg.threshold = atof(argv[++i]);
+        }else if (strcmp(argv[i], "--no-counters") == 0){
+            cfg.counters = 0;
+        }else if (argv[i][0] != '-' && num_programs < (int)(sizeof(programs) / sizeof(programs[0]))){
+            programs[num_programs++] = argv[i];
+        }else{
+            err(USAGE);
+        }
+    }
+    if (num_programs == 0 || cfg.runs < 1 || cfg.runs > MAX_RUNS || cfg.warmup < 0){
+        err(USAGE);
+    }
+
+    char work[PATH_MAX];
+    if (cfg.work == NULL){
+        snprintf(work, sizeof(work), "%s/bench", cfg.build);
+        cfg.work = work;
+    }
+    struct stat st;
+    if (mkdir(cfg.work, 0755) != 0 && (stat(cfg.work, &st) != 0 || !S_ISDIR(st.st_mode))){
+        err("unable to create the work directory");
+    }
+
+    struct result *results = malloc(sizeof(struct result) * (size_t)num_programs * NUM_BACKENDS);
+    if (results == NULL){
+        err("memory allocation failed");
+    }
+    int n = 0, mismatches = 0;
+    for (int p = 0; p < num_programs; p++){
+        int first = n;
+        int64_t ops = cfg.counters ? count_ops(&cfg, programs[p]) : COUNTER_NONE;
+        for (size_t b = 0; b < NUM_BACKENDS; b++){
+            if ((backend_mask & (1u << b)) && bench_one(&cfg, &backends[b], programs[p], &results[n])){
+                results[n++].ops = ops;
+            }
+        }
+        // 同一個程式在每個後端的輸出都必須相同
+        for (int i = first + 1; i < n; i++){
+            if (results[i].checksum != results[first].checksum){
+                fprintf(stderr, "bf_bench: %s output of %s differs from %s\n",
+                        results[i].program, results[i].backend, results[first].backend);
+                mismatches++;
+            }
+        }
+    }
+
+    FILE *out = stdout;
+    if (json_path != NULL && (out = fopen(json_path, "w")) == NULL){
+        err("unable to write the JSON report");
+    }
+    write_json(out, &cfg, results, n);
+    if (out != stdout){
+        fclose(out);
+    }
+
+    int regressions = baseline != NULL ? compare_baseline(baseline, results, n, cfg.threshold) : 0;
+    free(results);
+    return mismatches || regressions ? 1 : 0;
+}
@@ -0,0 +1,9 @@
+巢狀計數迴圈：8 輪，每輪 10^7 次最內層的清零；最內層以外的迴圈含有子迴圈，無法轉成線性迴圈，
+主要測試指令分派與跳躍。每輪結束輸出一個點
+>++++++++
+<++++++++++++++++++++++++++++++++++++++++++++++>
+[
+>++++++++++[>++++++++++[>++++++++++[>++++++++++[>++++++++++[>++++++++++[>++++++++++[>++++++++++[-]<-]<-]<-]<-]<-]<-]<-]
+<<.>-
+]
+++++++++++.
@@ -0,0 +1,13 @@
+大量輸出：三層 255 次迴圈，共輸出約 1600 萬個 A 與結尾的換行，測試輸出路徑
+++++++++[>++++++++<-]>+
+>-
+[
+  >-
+  [
+    >-
+    [<<<.>>>-]
+    <-
+  ]
+  <-
+]
+++++++++++.
@@ -0,0 +1,19 @@
+掃描迴圈：在約 2000 格連續的 1 上來回掃描 255 乘 255 次，測試掃描迴圈的速度
+格子配置：c0 外層計數 c1 內層計數 c2 暫存 c3 為 0 的左端哨兵 c4 起為連續的 1
+-
+>>>>
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+-[[>+<-]+>-]
+<[<]<<<
+[
+  >[-]-
+  [>>>[>]<[<]<<-]
+  <-
+]
+>>++++++++[<++++++++++>-]<+++.>++++++++++.
@@ -0,0 +1,209 @@
+// AOT 編譯器的擴充性基準（make scale-bench）：
+// 產生 1 KB 到 --max-size（預設 100 MB，十進位單位）、每次放大 10 倍的 Brainfuck 程式，內容模仿程式產生器的輸出：
+// 長串的 + - 與 > <、清零與線性迴圈、輸出，以及深度隨大小成長的巢狀迴圈（最大的程式有數十萬層）。
+// 對每個編譯器量測編譯時間（輸出丟到 /dev/null）與峰值記憶體，另外列出每 MB 原始碼的編譯時間：
+// 編譯時間與大小成正比時，各個大小的每 MB 時間應該接近，最後一欄為相對於 1 MB 的倍數。
+// 編譯失敗（例如巢狀太深、記憶體不足）時該列標示 failed，結束狀態為 1。
+//
+// 用法：bf_scale_bench [--build DIR] [--work DIR] [--max-size N] [compiler...]
+//       compiler 預設為 compiler_x86 與 compiler_x86_64（在 --build 目錄下）
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../util.h"
+
+#define MIN_SIZE 1000
+#define MB 1e6
+#define MAX_COMPILERS 8
+
+#define USAGE "Usage: bf_scale_bench [--build DIR] [--work DIR] [--max-size N] [compiler...]"
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// 固定種子的 xorshift，每次產生的程式都相同
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(uint32_t n){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state % n);
+}
+
+struct generator {
+    FILE *fp;
+    size_t written;
+    long depth;
+};
+
+static void put(struct generator *g, const char *s, size_t n){
+    fwrite(s, 1, n, g->fp);
+    g->written += n;
+}
+
+static void put_run(struct generator *g, char c, size_t n){
+    char buf[256];
+    memset(buf, c, sizeof(buf));
+    while (n > 0){
+        size_t k = n < sizeof(buf) ? n : sizeof(buf);
+        put(g, buf, k);
+        n -= k;
+    }
+}
+
+// 產生約 size 位元組的程式：開頭先開 size / 256 層巢狀迴圈，中間隨機混合各種片段並隨機開關迴圈，
+// 最後關閉所有還開著的迴圈
+static void generate(const char *path, size_t size){
+    struct generator g = {fopen(path, "w"), 0, 0};
+    if (g.fp == NULL){
+        err("unable to write the generated program");
+    }
+    rng_state = 0x9e3779b97f4a7c15ULL ^ size;
+    long nest = (long)(size / 256);
+    for (long i = 0; i < nest; i++){
+        put(&g, "+[>", 3);
+        g.depth++;
+    }
+    while (g.written + (size_t)g.depth * 2 < size){
+        switch (rng(8)) {
+            case 0: put_run(&g, rng(2) ? '+' : '-', 1 + rng(200)); break;
+            case 1: put_run(&g, rng(2) ? '>' : '<', 1 + rng(4)); break;
+            case 2: put(&g, "[-]", 3); break;
+            case 3: put(&g, "[->+>++<<]", 10); break;
+            case 4: put(&g, ".", 1); break;
+            case 5: put(&g, "[", 1); g.depth++; break;
+            case 6:
+                if (g.depth > nest){
+                    put(&g, "-]", 2);
+                    g.depth--;
+                }
+                break;
+            default: put(&g, "+>-<", 4); break;
+        }
+    }
+    while (g.depth > 0){
+        put(&g, "-]", 2);
+        g.depth--;
+    }
+    if (fclose(g.fp) != 0){
+        err("unable to write the generated program");
+    }
+}
+
+// 執行 compiler program > /dev/null，回傳毫秒數與峰值記憶體（KB）；失敗時回傳 -1
+static double compile(const char *compiler, const char *program, long *max_rss){
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0){
+        err("fork failed");
+    }
+    if (pid == 0){
+        int out = open("/dev/null", O_WRONLY);
+        if (out >= 0){
+            dup2(out, STDOUT_FILENO);
+            close(out);
+        }
+        execl(compiler, compiler, program, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR){
+    }
+    double elapsed = now_ms() - start;
+    *max_rss = usage.ru_maxrss;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        return -1;
+    }
+    return elapsed;
+}
+
+int main(int argc, char *argv[]){
+    const char *build = "build";
+    const char *work = NULL;
+    size_t max_size = (size_t)100 << 20;
+    const char *names[MAX_COMPILERS];
+    int num_compilers = 0;
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--build") == 0 && i + 1 < argc){
+            build = argv[++i];
+        }else if (strcmp(argv[i], "--work") == 0 && i + 1 < argc){
+            work = argv[++i];
+        }else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc){
+            max_size = parse_size(argv[++i]);
+        }else if (argv[i][0] != '-' && num_compilers < MAX_COMPILERS){
+            names[num_compilers++] = argv[i];
+        }else{
+            err(USAGE);
+        }
+    }
+    if (num_compilers == 0){
+        names[num_compilers++] = "compiler_x86";
+        names[num_compilers++] = "compiler_x86_64";
+    }
+
+    char work_dir[PATH_MAX];
+    if (work == NULL){
+        snprintf(work_dir, sizeof(work_dir), "%s/scale", build);
+        work = work_dir;
+    }
+    struct stat st;
+    if (mkdir(work, 0755) != 0 && (stat(work, &st) != 0 || !S_ISDIR(st.st_mode))){
+        err("unable to create the work directory");
+    }
+
+    // 1 MB 的每 MB 時間作為比較基準（最大大小不到 1 MB 時用最後一個大小）
+    double reference[MAX_COMPILERS] = {0};
+    int failed = 0;
+    printf("%-16s %10s %12s %12s %10s %10s %8s\n", "compiler", "size", "compile ms", "ms / MB", "MB/s", "max RSS", "vs 1MB");
+    for (size_t size = MIN_SIZE; size <= max_size; size *= 10){
+        char program[PATH_MAX + 32];
+        snprintf(program, sizeof(program), "%s/scale_%zu.bf", work, size);
+        generate(program, size);
+        for (int c = 0; c < num_compilers; c++){
+            char compiler[PATH_MAX];
+            snprintf(compiler, sizeof(compiler), "%s/%s", build, names[c]);
+            long rss = 0;
+            double ms = compile(compiler, program, &rss);
+            char size_text[32];
+            if (size >= MB){
+                snprintf(size_text, sizeof(size_text), "%.0f MB", size / MB);
+            }else{
+                snprintf(size_text, sizeof(size_text), "%.0f KB", size / 1e3);
+            }
+            if (ms < 0){
+                printf("%-16s %10s %12s\n", names[c], size_text, "failed");
+                failed = 1;
+                continue;
+            }
+            double mb = size / MB;
+            double per_mb = ms / mb;
+            if (reference[c] == 0 && (size >= MB || size * 10 > max_size)){
+                reference[c] = per_mb;
+            }
+            char ratio[16] = "-";
+            if (reference[c] > 0){
+                snprintf(ratio, sizeof(ratio), "%.2fx", per_mb / reference[c]);
+            }
+            printf("%-16s %10s %12.2f %12.1f %10.1f %7.1f MB %8s\n", names[c], size_text, ms, per_mb,
+                   mb / (ms / 1e3), rss / 1e3, ratio);
+            fflush(stdout);
+        }
+        remove(program);
+    }
+    return failed;
+}
@@ -0,0 +1,154 @@
+// 序列化的位元組碼（.bfc）：最佳化過的 IR 連同已配對的跳躍目標、位移與慣用寫法的 op 原樣寫入檔案，
+// 解譯器以 mmap 載入後直接在映射的頁面上執行，不需要讀取原始碼、解析或重跑最佳化 pass，
+// 最佳化只在部署時（--emit-bfc）做一次。
+// 格式：32 位元組的標頭，接著 op_count 個與記憶體中排列相同的 struct op。
+// 標頭記錄格式版本、op 大小與位元組順序（其他架構產生的檔案直接拒絕）、儲存格寬度、
+// 產生時使用的 pass 與 op 陣列的 FNV-1a 64 檢查碼；載入時另外以 ir_validate() 檢查跳躍目標、
+// 掃描步長與指標移動的大小，損壞或偽造的檔案不會讓執行迴圈跳出陣列、卡在步長 0 的掃描，
+// 或一次越過紙帶的保護區。
+#ifndef BF_BYTECODE_H
+#define BF_BYTECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "bf_ir.h"
+
+#define BFC_MAGIC "BFC\x1a"
+#define BFC_VERSION 1
+#define BFC_BYTE_ORDER 0x01020304u
+
+struct bfc_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t op_size;       // sizeof(struct op)
+    uint32_t byte_order;    // BFC_BYTE_ORDER 以產生端的位元組順序寫入
+    uint32_t cell_bits;
+    uint32_t op_count;      // 含結尾的 OP_END
+    uint32_t passes;        // 產生時使用的最佳化 pass（PASS_* 位元遮罩）
+    uint64_t checksum;      // op 陣列的 FNV-1a 64
+};
+
+// 程式的 .bfc 映像（標頭 + op 陣列，呼叫端 free）
+static inline void *bfc_image(const struct program *prog, unsigned passes, size_t *size){
+    size_t ops_size = sizeof(struct op) * (size_t)prog->size;
+    *size = sizeof(struct bfc_header) + ops_size;
+    uint8_t *image = malloc(*size);
+    if (image == NULL){
+        err("memory allocation failed");
+    }
+    struct bfc_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BFC_MAGIC, sizeof(h.magic));
+    h.version = BFC_VERSION;
+    h.op_size = sizeof(struct op);
+    h.byte_order = BFC_BYTE_ORDER;
+    h.cell_bits = (uint32_t)prog->cell_bits;
+    h.op_count = (uint32_t)prog->size;
+    h.passes = passes;
+    h.checksum = fnv1a_64(FNV1A_64_OFFSET, prog->ops, ops_size);
+    memcpy(image, &h, sizeof(h));
+    memcpy(image + sizeof(h), prog->ops, ops_size);
+    return image;
+}
+
+// 檢查映像並讓 prog 直接指向其中的 op 陣列（不複製，映像必須比 prog 活得久，也不能交給 free_program()）；
+// 成功時回傳 NULL，否則回傳錯誤原因
+static inline const char *bfc_view(const void *image, size_t size, struct program *prog){
+    struct bfc_header h;
+    if (size < sizeof(h)){
+        return "not a .bfc file";
+    }
+    memcpy(&h, image, sizeof(h));
+    if (memcmp(h.magic, BFC_MAGIC, sizeof(h.magic)) != 0){
+        return "not a .bfc file";
+    }
+    if (h.version != BFC_VERSION){
+        return "unsupported .bfc version";
+    }
+    if (h.op_size != sizeof(struct op) || h.byte_order != BFC_BYTE_ORDER){
+        return ".bfc file was built for a different architecture";
+    }
+    if (!valid_cell_bits((int)h.cell_bits) || h.op_count > INT32_MAX
+        || size != sizeof(h) + sizeof(struct op) * (size_t)h.op_count){
+        return "truncated or malformed .bfc file";
+    }
+    const struct op *ops = (const struct op *)((const uint8_t *)image + sizeof(h));
+    if (fnv1a_64(FNV1A_64_OFFSET, ops, sizeof(struct op) * (size_t)h.op_count) != h.checksum){
+        return ".bfc checksum mismatch";
+    }
+    if (ir_validate(ops, (int)h.op_count, (int)h.cell_bits) != 0){
+        return "corrupt .bfc instruction stream";
+    }
+    prog->ops = (struct op *)ops;
+    prog->size = (int)h.op_count;
+    prog->capacity = 0;
+    prog->cell_bits = (int)h.cell_bits;
+    return NULL;
+}
+
+// 檔案開頭是否為 .bfc 的 magic
+static inline int bfc_is_file(const char *path){
+    char magic[4];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        return 0;
+    }
+    int is_bfc = read(fd, magic, sizeof(magic)) == (ssize_t)sizeof(magic) && memcmp(magic, BFC_MAGIC, sizeof(magic)) == 0;
+    close(fd);
+    return is_bfc;
+}
+
+// 以唯讀 mmap 載入 .bfc 並讓 prog 指向映射中的 op 陣列；MAP_POPULATE 讓整個檔案一次讀入，
+// 檢查碼與執行都不會再逐頁觸發 page fault。回傳映射（結束時交給 bfc_unmap()），失敗時直接結束
+static inline void *bfc_map(const char *path, struct program *prog, size_t *size){
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0){
+        err("can't open file");
+    }
+    *size = (size_t)st.st_size;
+    void *map = mmap(NULL, *size ? *size : 1, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        err("mmap failed");
+    }
+    const char *error = bfc_view(map, *size, prog);
+    if (error != NULL){
+        err(error);
+    }
+    return map;
+}
+
+static inline void bfc_unmap(void *map, size_t size){
+    munmap(map, size ? size : 1);
+}
+
+// 寫出 .bfc；先寫到暫存檔再 rename()，執行中的行程不會映射到寫一半的檔案
+static inline void bfc_write(const char *path, const struct program *prog, unsigned passes){
+    // 載入時會被拒絕的程式（單一指標移動超過保護區）不寫出
+    if (ir_validate(prog->ops, prog->size, prog->cell_bits) != 0){
+        err("program can't be stored as .bfc: a single pointer move exceeds the tape guard");
+    }
+    size_t size;
+    void *image = bfc_image(prog, passes, &size);
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL){
+        err("can't write .bfc file");
+    }
+    int ok = fwrite(image, 1, size, fp) == size;
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0){
+        remove(tmp);
+        err("can't write .bfc file");
+    }
+    free(image);
+}
+
+#endif
@@ -0,0 +1,307 @@
+// 內容定址的編譯快取（--cache）：
+// 鍵是「清理後的原始碼（只保留 8 個指令字元）+ 後端名稱 + 影響輸出的選項」的 128 位元 FNV-1a 雜湊，
+// 值是該後端編譯的結果（解譯器的 IR 以 .bfc 格式存放、JIT 的機器碼），同一個程式第二次執行時直接讀回，跳過整個前端與最佳化。
+// 每個項目是快取目錄中的一個檔案 <雜湊>.<種類>，標頭記錄格式版本、完整的鍵與內容的檢查碼，任何一項不符都當作未命中。
+// 寫入先寫到同目錄的暫存檔再 rename()，同時執行的其他行程不會讀到寫一半的項目；
+// 目錄總大小超過上限時依最後使用時間（命中時更新 mtime）從最舊的項目開始刪除。
+// 命中 / 未命中次數除了本次執行之外，也以 flock 保護累計在目錄中的 stats 檔。
+#ifndef BF_CACHE_H
+#define BF_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "util.h"
+
+#define BF_CACHE_SIZE_DEFAULT ((size_t)256 << 20)
+#define BF_CACHE_VERSION 2      // IR 或機器碼的格式改變時遞增，舊項目自動失效（2：IR 改存 .bfc 映像）
+#define BF_CACHE_MAGIC "BFCACHE"
+
+struct cache_key {
+    uint64_t hi, lo;
+};
+
+struct cache {
+    char dir[PATH_MAX - 64];    // 保留項目檔名的長度
+    size_t limit;               // 目錄總大小上限（位元組）
+    unsigned long long hits, misses, stores, evictions;
+};
+
+struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t key_hi, key_lo;
+    uint64_t size;              // 內容的位元組數
+    uint64_t checksum;          // 內容的 FNV-1a 64
+};
+
+// 128 位元 FNV-1a
+#define CACHE_FNV_PRIME (((unsigned __int128)0x0000000001000000ULL << 64) | 0x000000000000013BULL)
+#define CACHE_FNV_OFFSET (((unsigned __int128)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL)
+
+static inline void cache_hash(struct cache_key *key, const void *data, size_t n){
+    unsigned __int128 h = ((unsigned __int128)key->hi << 64) | key->lo;
+    const uint8_t *p = data;
+    for (size_t i = 0; i < n; i++){
+        h ^= p[i];
+        h *= CACHE_FNV_PRIME;
+    }
+    key->hi = (uint64_t)(h >> 64);
+    key->lo = (uint64_t)h;
+}
+
+// 鍵：只有指令字元參與雜湊，註解與排版不同的同一個程式共用項目；
+// backend 與 options 各以 '\0' 結尾，避免不同欄位的字串接起來相同
+static inline struct cache_key cache_key(const char *text, size_t size, const char *backend, const char *options){
+    struct cache_key key = {(uint64_t)(CACHE_FNV_OFFSET >> 64), (uint64_t)CACHE_FNV_OFFSET};
+    char chunk[4096];
+    size_t n = 0;
+    for (size_t i = 0; i < size; i++){
+        char c = text[i];
+        if (c != '+' && c != '-' && c != '<' && c != '>' && c != '.' && c != ',' && c != '[' && c != ']'){
+            continue;
+        }
+        chunk[n++] = c;
+        if (n == sizeof(chunk)){
+            cache_hash(&key, chunk, n);
+            n = 0;
+        }
+    }
+    cache_hash(&key, chunk, n);
+    cache_hash(&key, "", 1);
+    cache_hash(&key, backend, strlen(backend) + 1);
+    cache_hash(&key, options, strlen(options) + 1);
+    return key;
+}
+
+// 依序建立路徑上的每一層目錄（mkdir -p）
+static inline int cache_mkdirs(const char *dir){
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char *p = path + 1; ; p++){
+        if (*p == '/' || *p == '\0'){
+            char c = *p;
+            *p = '\0';
+            if (mkdir(path, 0755) != 0 && errno != EEXIST){
+                return -1;
+            }
+            if (c == '\0'){
+                return 0;
+            }
+            *p = c;
+        }
+    }
+}
+
+// 快取目錄：dir（--cache-dir）、$BF_CACHE_DIR、$XDG_CACHE_HOME/bf、~/.cache/bf 依序取第一個有設定的。
+// 無法建立目錄時印出警告並回傳 -1，呼叫端照常編譯、不使用快取
+static inline int cache_open(struct cache *cache, const char *dir, size_t limit){
+    memset(cache, 0, sizeof(*cache));
+    cache->limit = limit;
+    const char *env;
+    if (dir != NULL){
+        snprintf(cache->dir, sizeof(cache->dir), "%s", dir);
+    }else if ((env = getenv("BF_CACHE_DIR")) != NULL && *env != '\0'){
+        snprintf(cache->dir, sizeof(cache->dir), "%s", env);
+    }else if ((env = getenv("XDG_CACHE_HOME")) != NULL && *env != '\0'){
+        snprintf(cache->dir, sizeof(cache->dir), "%s/bf", env);
+    }else if ((env = getenv("HOME")) != NULL && *env != '\0'){
+        snprintf(cache->dir, sizeof(cache->dir), "%s/.cache/bf", env);
+    }else{
+        fprintf(stderr, "cache: no cache directory (set BF_CACHE_DIR or use --cache-dir)\n");
+        return -1;
+    }
+    if (strlen(cache->dir) + 1 >= sizeof(cache->dir)){
+        fprintf(stderr, "cache: directory name too long\n");
+        return -1;
+    }
+    if (cache_mkdirs(cache->dir) != 0){
+        fprintf(stderr, "cache: can't create %s\n", cache->dir);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void cache_path(const struct cache *cache, struct cache_key key, const char *kind, char *path){
+    snprintf(path, PATH_MAX, "%s/%016llx%016llx.%s", cache->dir,
+             (unsigned long long)key.hi, (unsigned long long)key.lo, kind);
+}
+
+// 讀回項目的內容（呼叫端 free）；不存在或標頭、檢查碼不符時回傳 NULL 並記為未命中
+static inline void *cache_load(struct cache *cache, struct cache_key key, const char *kind, size_t *size){
+    char path[PATH_MAX];
+    cache_path(cache, key, kind, path);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        cache->misses++;
+        return NULL;
+    }
+    struct cache_header h;
+    uint8_t *data = NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || read(fd, &h, sizeof(h)) != (ssize_t)sizeof(h)
+        || memcmp(h.magic, BF_CACHE_MAGIC, sizeof(h.magic)) != 0 || h.version != BF_CACHE_VERSION
+        || h.key_hi != key.hi || h.key_lo != key.lo
+        || h.size != (uint64_t)st.st_size - sizeof(h)){
+        goto miss;
+    }
+    data = malloc(h.size ? (size_t)h.size : 1);
+    if (data == NULL){
+        err("memory allocation failed");
+    }
+    for (size_t done = 0; done < h.size; ){
+        ssize_t n = read(fd, data + done, (size_t)h.size - done);
+        if (n <= 0){
+            goto miss;
+        }
+        done += (size_t)n;
+    }
+    if (fnv1a_64(FNV1A_64_OFFSET, data, (size_t)h.size) != h.checksum){
+        goto miss;
+    }
+    // 更新 mtime 作為最後使用時間，淘汰時保留常用的項目
+    futimens(fd, NULL);
+    close(fd);
+    cache->hits++;
+    *size = (size_t)h.size;
+    return data;
+miss:
+    free(data);
+    close(fd);
+    cache->misses++;
+    return NULL;
+}
+
+struct cache_entry {
+    char name[NAME_MAX + 1];
+    struct timespec mtime;
+    off_t size;
+};
+
+static inline int cache_entry_compare(const void *a, const void *b){
+    const struct cache_entry *x = a, *y = b;
+    if (x->mtime.tv_sec != y->mtime.tv_sec){
+        return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    }
+    return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : x->mtime.tv_nsec > y->mtime.tv_nsec;
+}
+
+// 目錄總大小超過上限時，從最久沒用到的項目開始刪除（暫存檔與 stats 不列入）
+static inline void cache_evict(struct cache *cache){
+    DIR *dir = opendir(cache->dir);
+    if (dir == NULL){
+        return;
+    }
+    struct cache_entry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    unsigned long long total = 0;
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL){
+        struct stat st;
+        if (d->d_name[0] == '.' || strncmp(d->d_name, "tmp.", 4) == 0 || strcmp(d->d_name, "stats") == 0
+            || fstatat(dirfd(dir), d->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)){
+            continue;
+        }
+        if (count == capacity){
+            capacity = capacity ? capacity * 2 : 64;
+            entries = realloc(entries, sizeof(struct cache_entry) * capacity);
+            if (entries == NULL){
+                err("memory allocation failed");
+            }
+        }
+        snprintf(entries[count].name, sizeof(entries[count].name), "%s", d->d_name);
+        entries[count].mtime = st.st_mtim;
+        entries[count].size = st.st_size;
+        total += (unsigned long long)st.st_size;
+        count++;
+    }
+    if (total > cache->limit){
+        qsort(entries, count, sizeof(struct cache_entry), cache_entry_compare);
+        for (size_t i = 0; i < count && total > cache->limit; i++){
+            if (unlinkat(dirfd(dir), entries[i].name, 0) == 0){
+                total -= (unsigned long long)entries[i].size;
+                cache->evictions++;
+            }
+        }
+    }
+    closedir(dir);
+    free(entries);
+}
+
+// 寫入項目：先寫到暫存檔，完整寫完才 rename() 成正式名稱；失敗時放棄，不影響執行
+static inline void cache_store(struct cache *cache, struct cache_key key, const char *kind, const void *data, size_t size){
+    char tmp[PATH_MAX], path[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s/tmp.XXXXXX", cache->dir);
+    int fd = mkstemp(tmp);
+    if (fd < 0){
+        return;
+    }
+    struct cache_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BF_CACHE_MAGIC, sizeof(h.magic));
+    h.version = BF_CACHE_VERSION;
+    h.key_hi = key.hi;
+    h.key_lo = key.lo;
+    h.size = size;
+    h.checksum = fnv1a_64(FNV1A_64_OFFSET, data, size);
+    int ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h);
+    for (size_t done = 0; ok && done < size; ){
+        ssize_t n = write(fd, (const uint8_t *)data + done, size - done);
+        ok = n > 0;
+        done += ok ? (size_t)n : 0;
+    }
+    fchmod(fd, 0644);
+    if (close(fd) != 0 || !ok){
+        unlink(tmp);
+        return;
+    }
+    cache_path(cache, key, kind, path);
+    if (rename(tmp, path) != 0){
+        unlink(tmp);
+        return;
+    }
+    cache->stores++;
+    cache_evict(cache);
+}
+
+// 把本次的次數加進 stats 檔；report 不為 NULL 時同時印出本次與累計的次數
+static inline void cache_close(struct cache *cache, FILE *report){
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    unsigned long long total[4] = {0, 0, 0, 0};
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) == 0){
+        char buf[256];
+        ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+        buf[n > 0 ? n : 0] = '\0';
+        sscanf(buf, "hits %llu misses %llu stores %llu evictions %llu", &total[0], &total[1], &total[2], &total[3]);
+        total[0] += cache->hits;
+        total[1] += cache->misses;
+        total[2] += cache->stores;
+        total[3] += cache->evictions;
+        int len = snprintf(buf, sizeof(buf), "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\n",
+                           total[0], total[1], total[2], total[3]);
+        if (ftruncate(fd, 0) != 0 || pwrite(fd, buf, (size_t)len, 0) != len){
+            fprintf(stderr, "cache: can't update %s\n", path);
+        }
+    }
+    if (fd >= 0){
+        close(fd);
+    }
+    if (report != NULL){
+        fprintf(report, "cache: %llu hits, %llu misses, %llu stored, %llu evicted (total %llu hits, %llu misses) in %s\n",
+                cache->hits, cache->misses, cache->stores, cache->evictions, total[0], total[1], cache->dir);
+    }
+}
+
+#endif
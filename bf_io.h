@@ -0,0 +1,142 @@
+// 解譯器與 JIT 共用的 I/O 緩衝。
+// 輸出：`.` 只把字元放進緩衝區，緩衝區滿、`,` 需要從 stdin 讀取新資料之前，以及程式結束時才以 write(2) 一次寫出。
+// 緩衝大小為 1 時即為無緩衝（--unbuffered），每個字元立即寫出，適合互動使用。
+// 輸入：stdin 為一般檔案時整個 mmap 進來，`,` 只是指標遞增；否則以區塊 read(2) 填入緩衝區。
+// 讀到結尾時回傳 -1（與 getchar 的 EOF 相同）。
+#ifndef BF_IO_H
+#define BF_IO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util.h"
+
+#define BF_OUTPUT_BUFFER_DEFAULT (64 * 1024)
+#define BF_INPUT_BUFFER_SIZE (64 * 1024)
+
+struct output_buffer {
+    uint8_t *bytes;
+    size_t size;  // 緩衝區容量，1 = 無緩衝
+    size_t len;   // 目前尚未寫出的位元組數
+    int fd;       // 寫出的目標，預設為 stdout
+};
+
+static BF_THREAD_LOCAL struct output_buffer bf_out = {NULL, 0, 0, STDOUT_FILENO};
+
+// 寫出緩衝區內容；處理部分寫入與 EINTR，寫入失敗時丟棄剩餘內容
+static void output_flush(void){
+    size_t done = 0;
+    while (done < bf_out.len){
+        ssize_t n = write(bf_out.fd, bf_out.bytes + done, bf_out.len - done);
+        if (n < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        done += (size_t)n;
+    }
+    bf_out.len = 0;
+}
+
+// 配置緩衝區並註冊結束時的 flush；size 為 0 時視為 1（無緩衝）
+static inline void output_init(size_t size){
+    if (size == 0){
+        size = 1;
+    }
+    bf_out.bytes = malloc(size);
+    if (bf_out.bytes == NULL){
+        err("memory allocation failed");
+    }
+    bf_out.size = size;
+    bf_out.len = 0;
+    atexit(output_flush);
+}
+
+static inline void output_putc(uint8_t c){
+    bf_out.bytes[bf_out.len++] = c;
+    if (bf_out.len == bf_out.size){
+        output_flush();
+    }
+}
+
+struct input_buffer {
+    const uint8_t *cur;  // 下一個要讀的位元組
+    const uint8_t *end;  // 可讀範圍的結尾
+    int mapped;          // 1 = 輸入已 mmap（或沒有輸入），讀完即為 EOF
+    int fd;              // 讀取的來源，預設為 stdin
+    void *map;           // mmap 的區域，input_close() 時釋放
+    size_t map_size;
+    uint8_t block[BF_INPUT_BUFFER_SIZE];
+};
+
+static BF_THREAD_LOCAL struct input_buffer bf_in;
+
+// fd 是一般檔案時 mmap 整個檔案，從目前的檔案位置開始讀；失敗時退回區塊讀取。
+// fd 為 -1 表示沒有輸入，`,` 一律讀到 EOF
+static void input_open(int fd){
+    struct stat st;
+    bf_in.cur = bf_in.end = bf_in.block;
+    bf_in.mapped = fd < 0;
+    bf_in.fd = fd;
+    bf_in.map = NULL;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        return;
+    }
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    if (pos < 0 || pos >= st.st_size){
+        return;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED){
+        return;
+    }
+    bf_in.cur = (const uint8_t *)map + pos;
+    bf_in.end = (const uint8_t *)map + st.st_size;
+    bf_in.mapped = 1;
+    bf_in.map = map;
+    bf_in.map_size = (size_t)st.st_size;
+}
+
+static inline void input_init(void){
+    input_open(STDIN_FILENO);
+}
+
+// 釋放 input_open() 的 mmap；fd 由呼叫者關閉
+static inline void input_close(void){
+    if (bf_in.map != NULL){
+        munmap(bf_in.map, bf_in.map_size);
+        bf_in.map = NULL;
+    }
+}
+
+// 緩衝區讀完時再 read 一個區塊；tty 上 read 只會回傳已輸入的一行，不會等滿整個區塊
+static int input_refill(void){
+    if (bf_in.mapped){
+        return -1;
+    }
+    output_flush();  // 可能等待輸入前先送出提示文字
+    ssize_t n;
+    do {
+        n = read(bf_in.fd, bf_in.block, sizeof(bf_in.block));
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0){
+        return -1;
+    }
+    bf_in.cur = bf_in.block;
+    bf_in.end = bf_in.block + n;
+    return *bf_in.cur++;
+}
+
+static inline int input_getc(void){
+    if (bf_in.cur < bf_in.end){
+        return *bf_in.cur++;
+    }
+    return input_refill();
+}
+
+#endif
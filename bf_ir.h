@@ -0,0 +1,464 @@
+// 共用的最佳化前端：解譯器與三個編譯器後端都從這裡取得同一份 IR。
+// 原始碼先轉成一個指令一個 op 的 IR，再依序跑可設定的最佳化 pass，
+// 最後 link_jumps() 配對括號並加上 OP_END。各後端只需把 IR 翻譯成自己的形式。
+#ifndef BF_IR_H
+#define BF_IR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+// 存取儲存格的指令都帶 offset：作用在 ptr[offset]
+enum op_type {
+    OP_ADD,     // ptr[offset] += arg（'-' 以負數表示）
+    OP_MOVE,    // ptr += arg（'<' 以負數表示）
+    OP_OUT,     // '.'，輸出 ptr[offset]
+    OP_IN,      // ','，讀入 ptr[offset]
+    OP_JZ,      // '['：*ptr == 0 時跳到 arg（對應的 OP_JNZ）
+    OP_JNZ,     // ']'：*ptr != 0 時跳到 arg（對應的 OP_JZ）
+    OP_SCAN,    // scan loop，arg 為步長（正數向右，負數向左）
+    OP_MUL,     // 線性迴圈開頭，計數格為 ptr[offset]，arg 為後面 OP_MUL_ADD 的數量
+    OP_MUL_ADD, // ptr[offset] += 計數格 * arg
+    OP_CLEAR,   // ptr[offset] = 0（線性迴圈結尾，或 [-] 本身）
+    OP_END,     // 程式結尾哨兵，由 link_jumps() 加上
+};
+
+struct op {
+    enum op_type type;
+    int arg;
+    int offset;
+    int pos;    // 在原始碼中的位置，供除錯輸出使用
+};
+
+struct program {
+    struct op *ops;
+    int size;
+    int capacity;
+    int cell_bits;  // 儲存格寬度（8/16/32/64），決定加法與線性迴圈分析的模數
+};
+
+// 儲存格寬度是否合法（--cell-bits 只接受 8、16、32、64）
+static inline int valid_cell_bits(int bits){
+    return bits == 8 || bits == 16 || bits == 32 || bits == 64;
+}
+
+// 把 v 依儲存格寬度取模，以有號數表示（8 位元時 255 → -1），後端可直接輸出為立即值
+static inline int64_t cell_value(int64_t v, int bits){
+    if (bits == 64){
+        return v;
+    }
+    uint64_t u = (uint64_t)v & ((UINT64_C(1) << bits) - 1);
+    if (u >> (bits - 1)){
+        return (int64_t)(u - (UINT64_C(1) << bits));
+    }
+    return (int64_t)u;
+}
+
+static inline struct op *emit_op(struct program *prog, enum op_type type, int arg, int offset, int pos){
+    if (prog->size == prog->capacity){
+        prog->capacity = prog->capacity ? prog->capacity * 2 : 256;
+        prog->ops = realloc(prog->ops, sizeof(struct op) * prog->capacity);
+        if (prog->ops == NULL){
+            err("memory allocation failed");
+        }
+    }
+    struct op *op = &prog->ops[prog->size++];
+    op->type = type;
+    op->arg = arg;
+    op->offset = offset;
+    op->pos = pos;
+    return op;
+}
+
+static inline void free_program(struct program *prog){
+    free(prog->ops);
+    prog->ops = NULL;
+    prog->size = prog->capacity = 0;
+}
+
+// 將一段原始碼轉成 IR 接在 prog 之後，其他字元（註解、換行）直接略過；base 為這一段在檔案中的位置，
+// 原始碼可以分段傳入（bf_source.h 的分段讀取），不需要 '\0' 結尾。
+// merge 時連續的 + - 或 > < 在解析當下就合併（與 pass_merge 的結果相同，跨段也一樣），
+// 大型程式不必先為每個字元各配置一個 op
+static inline void ir_parse_chunk(struct program *prog, const char *text, size_t n, size_t base, int merge){
+    for (size_t i = 0; i < n; ++i){
+        int pos = (int)(base + i);
+        enum op_type type;
+        int arg;
+        switch (text[i]) {
+            case '>': type = OP_MOVE; arg = 1; break;
+            case '<': type = OP_MOVE; arg = -1; break;
+            case '+': type = OP_ADD; arg = 1; break;
+            case '-': type = OP_ADD; arg = -1; break;
+            case '.': emit_op(prog, OP_OUT, 0, 0, pos); continue;
+            case ',': emit_op(prog, OP_IN, 0, 0, pos); continue;
+            case '[': emit_op(prog, OP_JZ, 0, 0, pos); continue;
+            case ']': emit_op(prog, OP_JNZ, 0, 0, pos); continue;
+            default: continue;
+        }
+        struct op *prev = prog->size ? &prog->ops[prog->size - 1] : NULL;
+        if (merge && prev != NULL && prev->type == type){
+            prev->arg += arg;
+            prev->pos = pos;
+        }else{
+            emit_op(prog, type, arg, 0, pos);
+        }
+    }
+}
+
+// 指令合併：連續的 + - 或 > < 合併為一個帶計數的 op
+static inline void pass_merge(struct program *prog){
+    int n = 0;
+    for (int i = 0; i < prog->size; i++){
+        struct op op = prog->ops[i];
+        if (n > 0 && (op.type == OP_ADD || op.type == OP_MOVE)){
+            struct op *prev = &prog->ops[n - 1];
+            if (prev->type == op.type && prev->offset == op.offset){
+                prev->arg += op.arg;
+                prev->pos = op.pos;
+                continue;
+            }
+        }
+        prog->ops[n++] = op;
+    }
+    prog->size = n;
+}
+
+// 死代碼消除：移除相互抵消的指令（+-、><、合併後為 0 的計數），
+// 以及必定不會執行的迴圈（程式開頭或緊接在 ] 之後，此時當前格一定是 0）
+static inline void pass_cancel(struct program *prog){
+    int n = 0;
+    for (int i = 0; i < prog->size; i++){
+        struct op op = prog->ops[i];
+        if (op.type == OP_ADD || op.type == OP_MOVE){
+            if (n > 0 && prog->ops[n - 1].type == op.type && prog->ops[n - 1].offset == op.offset){
+                prog->ops[n - 1].arg += op.arg;
+                op = prog->ops[--n];
+            }
+            if ((op.type == OP_ADD && cell_value(op.arg, prog->cell_bits) == 0) || (op.type == OP_MOVE && op.arg == 0)){
+                continue;
+            }
+        }else if (op.type == OP_JZ && (n == 0 || prog->ops[n - 1].type == OP_JNZ)){
+            int depth = 1;
+            while (depth > 0 && ++i < prog->size){
+                if (prog->ops[i].type == OP_JZ){
+                    depth++;
+                }else if (prog->ops[i].type == OP_JNZ){
+                    depth--;
+                }
+            }
+            continue;
+        }
+        prog->ops[n++] = op;
+    }
+    prog->size = n;
+}
+
+// 奇數 a 在 mod 2^64 下的乘法反元素（Newton 迭代，每輪正確位數加倍），
+// 取低位即為 mod 2^8、2^16、2^32 的反元素
+static inline uint64_t inverse_mod2n(uint64_t a){
+    uint64_t x = a;  // a * a ≡ 1 (mod 8)，已有 3 位正確
+    for (int i = 0; i < 5; i++){
+        x *= 2 - a * x;
+    }
+    return x;
+}
+
+// 一般化的線性（仿射）迴圈分析：body 為迴圈內的 op（不含括號），只能有 OP_ADD / OP_MOVE、
+// 淨位移為 0，計數格（offset 0）可在任意位置被改變任意奇數量。
+// 這種迴圈恰好執行 n 次，n * d + v ≡ 0 (mod 2^bits)，即 n = v * inverse(-d)；
+// 所以每個其他格的增量只要把乘數乘上 inverse(-d)，執行期仍是 ptr[x] += v * mult。
+// 成功時把 (offset, 乘數) 以 OP_MUL_ADD 形式填入 terms（不含計數格，只保留非零項，乘數以有號數表示）並回傳項數，
+// 否則回傳 -1。計數格改變偶數量時迴圈可能永不結束，交給一般迴圈處理以保留原本語意；
+// 寬儲存格的乘數放不進 int 時也交給一般迴圈
+static inline int check_linear_loop(const struct op *body, int len, struct op *terms, int bits){
+    int offset = 0, count = 0, counter_delta = 0;
+    for (int i = 0; i < len; i++){
+        if (body[i].type == OP_MOVE){
+            offset += body[i].arg;
+        }else if (body[i].type == OP_ADD){
+            int at = offset + body[i].offset;
+            if (at == 0){
+                counter_delta += body[i].arg;
+                continue;
+            }
+            int j = 0;
+            while (j < count && terms[j].offset != at){
+                j++;
+            }
+            if (j == count){
+                terms[count].offset = at;
+                terms[count].arg = 0;
+                count++;
+            }
+            terms[j].arg += body[i].arg;
+        }else{
+            return -1;  // 巢狀迴圈或 I/O
+        }
+    }
+    if (offset != 0 || (counter_delta & 1) == 0){
+        return -1;
+    }
+
+    uint64_t k = inverse_mod2n(-(uint64_t)(int64_t)counter_delta);
+    int n = 0;
+    for (int j = 0; j < count; j++){
+        int64_t mult = cell_value((int64_t)((uint64_t)(int64_t)terms[j].arg * k), bits);
+        if (mult < INT32_MIN || mult > INT32_MAX){
+            return -1;
+        }
+        if (mult != 0){
+            terms[n].type = OP_MUL_ADD;
+            terms[n].offset = terms[j].offset;
+            terms[n].arg = (int)mult;
+            n++;
+        }
+    }
+    return n;
+}
+
+// Scan loop：迴圈內只有指標移動且淨位移不為 0（[>]、[<<]、[>>>] 等），回傳步長，否則回傳 0
+static inline int check_scan_loop(const struct op *body, int len){
+    int step = 0;
+    for (int i = 0; i < len; i++){
+        if (body[i].type != OP_MOVE){
+            return 0;
+        }
+        step += body[i].arg;
+    }
+    return step;
+}
+
+// 迴圈辨識：最內層迴圈若為 scan 迴圈改成 OP_SCAN，
+// 若為線性迴圈改成 OP_MUL + OP_MUL_ADD... + OP_CLEAR（沒有其他項時只剩 OP_CLEAR）
+static inline void pass_loops(struct program *prog){
+    int n = 0, last_open = -1;
+    struct op *terms = NULL;
+    int terms_cap = 0;
+    for (int i = 0; i < prog->size; i++){
+        struct op op = prog->ops[i];
+        if (op.type == OP_JZ){
+            last_open = n;
+        }else if (op.type == OP_JNZ && last_open >= 0){
+            // 上一個 [ 之後沒有別的 [，所以這是最內層迴圈
+            const struct op *body = &prog->ops[last_open + 1];
+            int len = n - last_open - 1;
+            int step = check_scan_loop(body, len);
+            if (step != 0){
+                prog->ops[last_open] = (struct op){OP_SCAN, step, 0, op.pos};
+                n = last_open + 1;
+                last_open = -1;
+                continue;
+            }
+            if (len > terms_cap){
+                terms_cap = len;
+                terms = realloc(terms, sizeof(struct op) * terms_cap);
+                if (terms == NULL){
+                    err("memory allocation failed");
+                }
+            }
+            int count = check_linear_loop(body, len, terms, prog->cell_bits);
+            if (count >= 0){
+                // 結果不會比原本迴圈長（每項至少對應一個 OP_ADD），可直接就地改寫
+                int base = last_open;
+                if (count > 0){
+                    prog->ops[base++] = (struct op){OP_MUL, count, 0, op.pos};
+                    for (int j = 0; j < count; j++){
+                        terms[j].pos = op.pos;
+                        prog->ops[base++] = terms[j];
+                    }
+                }
+                prog->ops[base++] = (struct op){OP_CLEAR, 0, 0, op.pos};
+                n = base;
+                last_open = -1;
+                continue;
+            }
+            last_open = -1;
+        }else if (op.type == OP_JNZ){
+            last_open = -1;
+        }
+        prog->ops[n++] = op;
+    }
+    prog->size = n;
+    free(terms);
+}
+
+// 位移折疊：基本區塊內的 OP_MOVE 不保留，只累積到後續指令的 offset，
+// 在迴圈邊界（[ ] 與 scan）前才以單一 OP_MOVE 補上淨位移
+static inline void pass_offsets(struct program *prog){
+    int offset = 0;
+    struct program out = {NULL, 0, 0, prog->cell_bits};
+    for (int i = 0; i < prog->size; i++){
+        struct op op = prog->ops[i];
+        switch (op.type) {
+            case OP_MOVE:
+                offset += op.arg;
+                continue;
+            case OP_JZ:
+            case OP_JNZ:
+            case OP_SCAN:
+                if (offset != 0){
+                    emit_op(&out, OP_MOVE, offset, 0, op.pos);
+                    offset = 0;
+                }
+                break;
+            default:
+                op.offset += offset;
+                break;
+        }
+        emit_op(&out, op.type, op.arg, op.offset, op.pos);
+    }
+    free(prog->ops);
+    *prog = out;
+}
+
+// 可設定的 pass 清單，optimize() 依表中順序執行 mask 選到的 pass
+enum {
+    PASS_MERGE   = 1 << 0,
+    PASS_CANCEL  = 1 << 1,
+    PASS_LOOPS   = 1 << 2,
+    PASS_OFFSETS = 1 << 3,
+    PASS_ALL     = PASS_MERGE | PASS_CANCEL | PASS_LOOPS | PASS_OFFSETS,
+};
+
+struct pass {
+    const char *name;
+    unsigned flag;
+    void (*run)(struct program *prog);
+};
+
+static const struct pass passes[] = {
+    {"merge",   PASS_MERGE,   pass_merge},    // 指令合併
+    {"cancel",  PASS_CANCEL,  pass_cancel},   // 抵消與死迴圈消除
+    {"loops",   PASS_LOOPS,   pass_loops},    // 清零 / 掃描 / 線性迴圈辨識
+    {"offsets", PASS_OFFSETS, pass_offsets},  // 位移折疊
+};
+
+// 解析以逗號分隔的 pass 名稱（如 "merge,loops"），也接受 "all" 與 "none"
+static inline unsigned parse_pass_list(const char *list){
+    unsigned mask = 0;
+    while (*list){
+        size_t len = strcspn(list, ",");
+        if (len == 3 && strncmp(list, "all", 3) == 0){
+            mask |= PASS_ALL;
+        }else if (!(len == 4 && strncmp(list, "none", 4) == 0)){
+            size_t j = 0;
+            while (j < sizeof(passes) / sizeof(passes[0]) &&
+                   !(strlen(passes[j].name) == len && strncmp(list, passes[j].name, len) == 0)){
+                j++;
+            }
+            if (j == sizeof(passes) / sizeof(passes[0])){
+                err("unknown optimization pass (use merge, cancel, loops, offsets, all or none)");
+            }
+            mask |= passes[j].flag;
+        }
+        list += len;
+        if (*list == ','){
+            list++;
+        }
+    }
+    return mask;
+}
+
+// 配對括號（OP_JZ / OP_JNZ 的 arg 互指對方位置）並在結尾加上 OP_END
+static inline void link_jumps(struct program *prog){
+    int *open = NULL;
+    int depth = 0, open_cap = 0;
+    for (int i = 0; i < prog->size; i++){
+        if (prog->ops[i].type == OP_JZ){
+            if (depth == open_cap){
+                open_cap = open_cap ? open_cap * 2 : 64;
+                open = realloc(open, sizeof(int) * open_cap);
+                if (open == NULL){
+                    err("memory allocation failed");
+                }
+            }
+            open[depth++] = i;
+        }else if (prog->ops[i].type == OP_JNZ){
+            if (depth == 0){
+                err("unmatched ']'");
+            }
+            int start = open[--depth];
+            prog->ops[start].arg = i;
+            prog->ops[i].arg = start;
+        }
+    }
+    if (depth != 0){
+        err("unmatched '['");
+    }
+    free(open);
+    int end_pos = prog->size ? prog->ops[prog->size - 1].pos + 1 : 0;
+    emit_op(prog, OP_END, 0, 0, end_pos);
+}
+
+static inline void optimize(struct program *prog, unsigned mask){
+    for (size_t i = 0; i < sizeof(passes) / sizeof(passes[0]); i++){
+        if (mask & passes[i].flag){
+            passes[i].run(prog);
+        }
+    }
+}
+
+// 解析之後的前端流程：最佳化、配對括號；cell_bits 為儲存格寬度
+static inline void compile_parsed(struct program *prog, unsigned mask, int cell_bits){
+    prog->cell_bits = cell_bits;
+    optimize(prog, mask);
+    link_jumps(prog);
+}
+
+// 前端完整流程：解析、最佳化、配對括號（整份原始碼已在記憶體中時使用）
+static inline struct program compile_ir(const char *const input, size_t size, unsigned mask, int cell_bits){
+    struct program prog = {NULL, 0, 0, cell_bits};
+    ir_parse_chunk(&prog, input, size, 0, (mask & PASS_MERGE) != 0);
+    compile_parsed(&prog, mask, cell_bits);
+    return prog;
+}
+
+// 單一 op 的指標移動、位移與掃描步長的上限（位元組），與紙帶前後保護區的大小（BF_TAPE_GUARD）相同：
+// 超過時可能一次越過保護區落在其他映射上，越界就不會被攔截
+#define IR_MAX_DISPLACEMENT (1 << 20)
+
+static inline int ir_displacement_ok(long long cells, int cell_bits){
+    return (cells < 0 ? -cells : cells) * (cell_bits / 8) < IR_MAX_DISPLACEMENT;
+}
+
+// 檢查從檔案讀回的 IR（.bfc、快取）：opcode 合法、結尾恰好一個 OP_END、
+// 每個跳躍目標都在範圍內、與對應的括號互指且正確巢狀（不交錯）、
+// 線性迴圈的 arg 個項目都是 OP_MUL_ADD 並以 OP_CLEAR 結束（OP_MUL_ADD 不出現在線性迴圈之外）、
+// 掃描步長不為 0，且指標移動、位移與掃描步長都小於保護區；合法時回傳 0
+static inline int ir_validate(const struct op *ops, int n, int cell_bits){
+    if (n < 1){
+        return -1;
+    }
+    // 尚未閉合的 [ 的索引；] 必須對應最內層的 [
+    int *open = malloc(sizeof(int) * (size_t)n);
+    if (open == NULL){
+        err("memory allocation failed");
+    }
+    int depth = 0;
+    int mul_end = -1;   // 目前線性迴圈最後一個 OP_MUL_ADD 的索引
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++){
+        const struct op *op = &ops[i];
+        if (op->type < OP_ADD || op->type > OP_END || (op->type == OP_END) != (i == n - 1)){
+            ok = 0;
+        }else if (!ir_displacement_ok(op->offset, cell_bits) || (op->type == OP_MUL_ADD) != (i <= mul_end)){
+            ok = 0;
+        }else if (op->type == OP_JZ){
+            ok = op->arg > i && op->arg < n && ops[op->arg].type == OP_JNZ && ops[op->arg].arg == i;
+            open[depth++] = i;
+        }else if (op->type == OP_JNZ){
+            ok = depth > 0 && open[--depth] == op->arg;
+        }else if (op->type == OP_MUL){
+            ok = op->arg >= 0 && op->arg <= n - i - 3 && ops[i + op->arg + 1].type == OP_CLEAR;
+            mul_end = i + op->arg;
+        }else if (op->type == OP_MOVE || op->type == OP_SCAN){
+            ok = (op->type != OP_SCAN || op->arg != 0) && ir_displacement_ok(op->arg, cell_bits);
+        }
+    }
+    free(open);
+    return ok && depth == 0 ? 0 : -1;
+}
+
+#endif
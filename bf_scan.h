@@ -0,0 +1,180 @@
+// 掃描迴圈（[>]、[<<]、[>>>>>>>>>] 等）的 SIMD 核心，解譯器與 JIT 共用。
+// 一次比較 16（SSE2）或 32（AVX2）格，再以步長遮罩只保留 p, p±step, p±2*step... 的位置；
+// 每個區塊都從步長位置開始載入，所以同一個遮罩可以一直使用。
+// AVX2 於執行期以 __builtin_cpu_supports 偵測，非 x86-64 或步長大於區塊寬度時使用純量版本。
+#ifndef BF_SCAN_H
+#define BF_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 從 p 開始向右找 p + k*step 中第一個 0，範圍限於 [p, end)，找不到回傳 NULL
+static inline uint8_t *scan_right_scalar(uint8_t *p, size_t step, const uint8_t *end){
+    size_t n = (size_t)(end - p);
+    for (size_t i = 0; i < n; i += step){
+        if (p[i] == 0){
+            return p + i;
+        }
+    }
+    return NULL;
+}
+
+// 從 p 開始向左找 p - k*step 中第一個 0，範圍限於 [begin, p]，找不到回傳 NULL
+static inline uint8_t *scan_left_scalar(uint8_t *p, size_t step, const uint8_t *begin){
+    size_t i = (size_t)(p - begin);
+    for (;;){
+        if (begin[i] == 0){
+            return (uint8_t *)begin + i;
+        }
+        if (i < step){
+            return NULL;
+        }
+        i -= step;
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BF_HAVE_SIMD_SCAN 1
+
+#include <immintrin.h>
+
+// 步長遮罩：位元 0, step, 2*step... (< width) 為 1
+static inline uint32_t stride_mask(size_t step, unsigned width){
+    uint32_t mask = 0;
+    for (size_t i = 0; i < width; i += step){
+        mask |= 1u << i;
+    }
+    return mask;
+}
+
+// 向左掃描用的遮罩：位元 width-1, width-1-step, ... 為 1
+static inline uint32_t stride_mask_left(size_t step, unsigned width){
+    uint32_t mask = 0;
+    for (size_t i = 0; i < width; i += step){
+        mask |= 1u << (width - 1 - i);
+    }
+    return mask;
+}
+
+// 一個區塊涵蓋的步長位置數乘上步長：下一個區塊的起點仍是步長位置
+static inline size_t stride_advance(size_t step, unsigned width){
+    return ((width - 1) / step + 1) * step;
+}
+
+static inline uint8_t *scan_right_sse2(uint8_t *p, size_t step, const uint8_t *end){
+    size_t n = (size_t)(end - p), i = 0;
+    if (step <= 16){
+        uint32_t mask = stride_mask(step, 16);
+        size_t advance = stride_advance(step, 16);
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= n){
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+            uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & mask;
+            if (hits){
+                return p + i + __builtin_ctz(hits);
+            }
+            i += advance;
+        }
+    }
+    return i < n ? scan_right_scalar(p + i, step, end) : NULL;
+}
+
+static inline uint8_t *scan_left_sse2(uint8_t *p, size_t step, const uint8_t *begin){
+    size_t i = (size_t)(p - begin);
+    if (step <= 16){
+        // 區塊為 [q-15, q]，步長位置在位元 15, 15-step, ...
+        uint32_t mask = stride_mask_left(step, 16);
+        size_t advance = stride_advance(step, 16);
+        const __m128i zero = _mm_setzero_si128();
+        while (i >= 15){
+            __m128i v = _mm_loadu_si128((const __m128i *)(begin + i - 15));
+            uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & mask;
+            if (hits){
+                return (uint8_t *)begin + i - 15 + (31 - __builtin_clz(hits));
+            }
+            if (i < advance){
+                return NULL;
+            }
+            i -= advance;
+        }
+    }
+    return scan_left_scalar((uint8_t *)begin + i, step, begin);
+}
+
+__attribute__((target("avx2")))
+static uint8_t *scan_right_avx2(uint8_t *p, size_t step, const uint8_t *end){
+    size_t n = (size_t)(end - p), i = 0;
+    if (step <= 32){
+        uint32_t mask = stride_mask(step, 32);
+        size_t advance = stride_advance(step, 32);
+        const __m256i zero = _mm256_setzero_si256();
+        while (i + 32 <= n){
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+            uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)) & mask;
+            if (hits){
+                return p + i + __builtin_ctz(hits);
+            }
+            i += advance;
+        }
+    }
+    return i < n ? scan_right_scalar(p + i, step, end) : NULL;
+}
+
+__attribute__((target("avx2")))
+static uint8_t *scan_left_avx2(uint8_t *p, size_t step, const uint8_t *begin){
+    size_t i = (size_t)(p - begin);
+    if (step <= 32){
+        // 區塊為 [q-31, q]，步長位置在位元 31, 31-step, ...
+        uint32_t mask = stride_mask_left(step, 32);
+        size_t advance = stride_advance(step, 32);
+        const __m256i zero = _mm256_setzero_si256();
+        while (i >= 31){
+            __m256i v = _mm256_loadu_si256((const __m256i *)(begin + i - 31));
+            uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)) & mask;
+            if (hits){
+                return (uint8_t *)begin + i - 31 + (31 - __builtin_clz(hits));
+            }
+            if (i < advance){
+                return NULL;
+            }
+            i -= advance;
+        }
+    }
+    return scan_left_scalar((uint8_t *)begin + i, step, begin);
+}
+
+// 0 = 尚未偵測，1 = SSE2，2 = AVX2。bf_batch 的多個執行緒可能同時第一次偵測，所以以 relaxed atomic 讀寫：
+// 每個執行緒算出的值都相同，重複偵測無害，x86-64 上這兩個操作仍是一般的 mov。
+// CPU 特徵在 libgcc 的建構函式中已偵測完成，這裡不再呼叫會寫入全域狀態的 __builtin_cpu_init()
+static int scan_isa = 0;
+
+static inline int scan_select_isa(void){
+    int isa = __atomic_load_n(&scan_isa, __ATOMIC_RELAXED);
+    if (isa == 0){
+        isa = __builtin_cpu_supports("avx2") ? 2 : 1;
+        __atomic_store_n(&scan_isa, isa, __ATOMIC_RELAXED);
+    }
+    return isa;
+}
+
+static inline uint8_t *scan_right(uint8_t *p, size_t step, const uint8_t *end){
+    return scan_select_isa() == 2 ? scan_right_avx2(p, step, end) : scan_right_sse2(p, step, end);
+}
+
+static inline uint8_t *scan_left(uint8_t *p, size_t step, const uint8_t *begin){
+    return scan_select_isa() == 2 ? scan_left_avx2(p, step, begin) : scan_left_sse2(p, step, begin);
+}
+
+#else
+
+static inline uint8_t *scan_right(uint8_t *p, size_t step, const uint8_t *end){
+    return scan_right_scalar(p, step, end);
+}
+
+static inline uint8_t *scan_left(uint8_t *p, size_t step, const uint8_t *begin){
+    return scan_left_scalar(p, step, begin);
+}
+
+#endif
+
+#endif
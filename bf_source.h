@@ -0,0 +1,139 @@
+// 原始碼載入器（取代 read_file）：一般檔案以唯讀 mmap 整個映射，不複製、也不需要 '\0' 結尾；
+// pipe、終端機與 "-"（stdin）則以固定大小的緩衝區分段讀取。呼叫端逐段取得內容直接交給 ir_parse_chunk()，
+// 解析、過濾在同一趟完成，記憶體中除了 IR 只有映射的頁面或一個 BF_SOURCE_CHUNK 大小的緩衝區。
+#ifndef BF_SOURCE_H
+#define BF_SOURCE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "bf_ir.h"
+
+#define BF_SOURCE_CHUNK (64 * 1024)
+
+struct source {
+    const char *text;   // 一般檔案的完整內容（映射）；pipe 時為 NULL，需以 source_next() 分段讀取
+    size_t size;        // text 的長度
+    int fd;
+    void *map;
+    char *buffer;       // 分段讀取的緩衝區，或 source_slurp() 讀入的完整內容
+    size_t offset;      // 分段讀取時已交給呼叫端的位元組數
+    int done;           // text 已整段交出
+};
+
+// 開啟原始碼，path 為 "-" 時讀取 stdin；失敗時回傳 -1
+static inline int source_open(struct source *src, const char *path){
+    memset(src, 0, sizeof(*src));
+    src->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (src->fd < 0){
+        return -1;
+    }
+    struct stat st;
+    if (fstat(src->fd, &st) == 0 && S_ISREG(st.st_mode)){
+        src->size = (size_t)st.st_size;
+        if (src->size == 0){
+            src->text = "";
+            return 0;
+        }
+        void *map = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+        if (map != MAP_FAILED){
+            madvise(map, src->size, MADV_SEQUENTIAL);
+            src->map = map;
+            src->text = map;
+            return 0;
+        }
+        src->size = 0;
+    }
+    src->buffer = malloc(BF_SOURCE_CHUNK);
+    if (src->buffer == NULL){
+        err("memory allocation failed");
+    }
+    return 0;
+}
+
+// 取得下一段內容與它在檔案中的位置；沒有更多內容時回傳 0。映射的檔案一次交出全部
+static inline int source_next(struct source *src, const char **chunk, size_t *n, size_t *base){
+    if (src->text != NULL){
+        if (src->done){
+            return 0;
+        }
+        *chunk = src->text;
+        *n = src->size;
+        *base = 0;
+        src->done = 1;
+        return 1;
+    }
+    for (;;){
+        ssize_t got = read(src->fd, src->buffer, BF_SOURCE_CHUNK);
+        if (got < 0 && errno == EINTR){
+            continue;
+        }
+        if (got <= 0){
+            return 0;
+        }
+        *chunk = src->buffer;
+        *n = (size_t)got;
+        *base = src->offset;
+        src->offset += (size_t)got;
+        return 1;
+    }
+}
+
+// 除錯模式與 --profile 需要以位置查詢原始碼：pipe 時把剩下的內容全部讀進記憶體，讓 text 可用
+static inline void source_slurp(struct source *src){
+    if (src->text != NULL){
+        return;
+    }
+    size_t capacity = BF_SOURCE_CHUNK, size = 0;
+    for (;;){
+        if (size == capacity){
+            capacity *= 2;
+            src->buffer = realloc(src->buffer, capacity);
+            if (src->buffer == NULL){
+                err("memory allocation failed");
+            }
+        }
+        ssize_t got = read(src->fd, src->buffer + size, capacity - size);
+        if (got < 0 && errno == EINTR){
+            continue;
+        }
+        if (got <= 0){
+            break;
+        }
+        size += (size_t)got;
+    }
+    src->text = src->buffer;
+    src->size = size;
+}
+
+static inline void source_close(struct source *src){
+    if (src->map != NULL){
+        munmap(src->map, src->size);
+    }
+    free(src->buffer);
+    if (src->fd > STDIN_FILENO){
+        close(src->fd);
+    }
+    memset(src, 0, sizeof(*src));
+    src->fd = -1;
+}
+
+// 一邊讀取一邊解析，接著執行最佳化與括號配對
+static inline struct program compile_source(struct source *src, unsigned mask, int cell_bits){
+    struct program prog = {NULL, 0, 0, cell_bits};
+    const char *chunk;
+    size_t n, base;
+    while (source_next(src, &chunk, &n, &base)){
+        ir_parse_chunk(&prog, chunk, n, base, (mask & PASS_MERGE) != 0);
+    }
+    compile_parsed(&prog, mask, cell_bits);
+    return prog;
+}
+
+#endif
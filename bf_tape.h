@@ -0,0 +1,138 @@
+// 解譯器與 JIT 共用的紙帶：以 mmap 配置，大小可由使用者指定（KB 到 GB）。
+// 紙帶前後各有 BF_TAPE_GUARD 位元組的 PROT_NONE 保護區，中間的頁面直到第一次寫入才真正配置，
+// 因此大紙帶在用到之前不佔實體記憶體。越界存取不需要每次移動都比較邊界，
+// 而是由 SIGSEGV handler 攔截並回報位置。紙帶大小向上取整到頁面大小，兩端的越界都能立即偵測。
+// 儲存格可為 1、2、4、8 位元組（--cell-bits），大小與回報的位置都以格為單位。
+#ifndef BF_TAPE_H
+#define BF_TAPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "util.h"
+#include "bf_io.h"
+
+#define BF_TAPE_DEFAULT 30000
+#define BF_TAPE_GUARD (1 << 20)
+
+// tape_reset() 在這個大小以下直接 memset，以上才用 madvise 丟棄頁面
+#define BF_TAPE_RESET_MEMSET (1 << 20)
+
+struct tape {
+    uint8_t *cells;     // 第 0 格
+    size_t size;        // 可用的格數（已取整到頁面大小）
+    size_t cell_bytes;  // 每格的位元組數
+    sigjmp_buf *recover;  // 不為 NULL 時越界改為 siglongjmp 回到這裡，而不是結束行程（bf_batch）
+    long fault_cell;      // 越界的格子位置，供 recover 之後回報
+};
+
+static BF_THREAD_LOCAL struct tape bf_tape = {NULL, 0, 1, NULL, 0};
+
+// 把有號整數寫成十進位（async-signal-safe，不使用 printf）
+static size_t tape_format_long(char *buf, long v){
+    char digits[24];
+    size_t n = 0, len = 0;
+    unsigned long u = v < 0 ? -(unsigned long)v : (unsigned long)v;
+    do {
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0){
+        buf[len++] = '-';
+    }
+    while (n){
+        buf[len++] = digits[--n];
+    }
+    return len;
+}
+
+// 紙帶越界：回報位置後結束；其他位址的 SIGSEGV 交回預設處理
+static void tape_segv_handler(int sig, siginfo_t *info, void *context){
+    (void)context;
+    const uint8_t *addr = (const uint8_t *)info->si_addr;
+    size_t bytes = bf_tape.size * bf_tape.cell_bytes;
+    if (bf_tape.cells == NULL || addr < bf_tape.cells - BF_TAPE_GUARD || addr >= bf_tape.cells + bytes + BF_TAPE_GUARD){
+        signal(sig, SIG_DFL);
+        return;
+    }
+    // 位元組位移換算成格數，負值向下取整（第 -1 格的任何位元組都回報 -1）
+    long offset = (long)(addr - bf_tape.cells);
+    long width = (long)bf_tape.cell_bytes;
+    long cell = offset >= 0 ? offset / width : -((-offset + width - 1) / width);
+    if (bf_tape.recover != NULL){
+        bf_tape.fault_cell = cell;
+        siglongjmp(*bf_tape.recover, 1);
+    }
+    char msg[128];
+    size_t len = 0;
+    static const char prefix[] = "tape overflow: cell ";
+    static const char middle[] = " is outside the tape [0, ";
+    memcpy(msg + len, prefix, sizeof(prefix) - 1);
+    len += sizeof(prefix) - 1;
+    len += tape_format_long(msg + len, cell);
+    memcpy(msg + len, middle, sizeof(middle) - 1);
+    len += sizeof(middle) - 1;
+    len += tape_format_long(msg + len, (long)bf_tape.size);
+    msg[len++] = ')';
+    msg[len++] = '\n';
+    output_flush();  // 先送出越界前的輸出
+    if (write(STDERR_FILENO, msg, len) < 0){
+        // 已經要結束，無法再回報
+    }
+    _exit(1);
+}
+
+// 配置 size 格、每格 cell_bytes 位元組的紙帶（向上取整到頁面大小）並安裝 SIGSEGV handler
+static uint8_t *tape_alloc(size_t size, size_t cell_bytes){
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > ((size_t)-1 - page) / cell_bytes){
+        err("unable to allocate the tape");
+    }
+    size = (size * cell_bytes + page - 1) / page * page;
+    if (size == 0){
+        size = page;
+    }
+    uint8_t *base = mmap(NULL, size + 2 * (size_t)BF_TAPE_GUARD, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED){
+        err("unable to allocate the tape");
+    }
+    uint8_t *cells = base + BF_TAPE_GUARD;
+    if (mprotect(cells, size, PROT_READ | PROT_WRITE) != 0){
+        err("unable to allocate the tape");
+    }
+    bf_tape.cells = cells;
+    bf_tape.size = size / cell_bytes;
+    bf_tape.cell_bytes = cell_bytes;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = tape_segv_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, NULL);
+    return cells;
+}
+
+// 把紙帶清回全 0 以便重複使用：小紙帶直接 memset；
+// 大紙帶以 MADV_DONTNEED 丟棄已配置的頁面，下次寫入時才重新配置為 0
+static inline void tape_reset(void){
+    size_t bytes = bf_tape.size * bf_tape.cell_bytes;
+    if (bytes <= BF_TAPE_RESET_MEMSET){
+        memset(bf_tape.cells, 0, bytes);
+    }else{
+        madvise(bf_tape.cells, bytes, MADV_DONTNEED);
+    }
+}
+
+static void tape_free(void){
+    munmap(bf_tape.cells - BF_TAPE_GUARD, bf_tape.size * bf_tape.cell_bytes + 2 * (size_t)BF_TAPE_GUARD);
+    bf_tape.cells = NULL;
+    bf_tape.size = 0;
+}
+
+#endif
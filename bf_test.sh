@@ -17,8 +17,9 @@ gcc -I. -o  compiler_x86_64 compiler_x86_source/compiler_x86_64.c
 gcc -nostdlib -no-pie -o mandelbrot mandelbrot.s
 time ./mandelbrot
 
-test compiler_llvm
-gcc -I. -o  compiler_llvm llvm/llvm.c
+# test compiler_llvm（使用 LLVM C API，編譯與連結參數取自 llvm-config，與 llvm/Makefile 相同）
+gcc -I. $(llvm-config --cflags) -o compiler_llvm llvm/llvm.c $(llvm-config --ldflags --libs)
 ./compiler_llvm mandelbrot.bf > mandelbrot.ll
-clang -o mandelbrot mandelbrot.ll
-time ./mandelbrot
\ No newline at end of file
+clang -o mandelbrot mandelbrot.ll || { llc -filetype=obj -relocation-model=pic -o mandelbrot.o mandelbrot.ll && gcc -o mandelbrot mandelbrot.o; }
+time ./mandelbrot
+time ./compiler_llvm --jit mandelbrot.bf
\ No newline at end of file
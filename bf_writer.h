@@ -0,0 +1,148 @@
+// 編譯器的輸出緩衝：產生的組語先放進 1 MiB 的區塊緩衝區，滿了或結束時才以 write(2) 一次寫出。
+// out_printf() 只支援編譯器用到的格式（%d %ld %lld %zu %x %s %c %%），不經過 stdio 的鎖與 locale，
+// 數百萬行的輸出時，格式化與寫出的成本都與輸出大小成正比。
+#ifndef BF_WRITER_H
+#define BF_WRITER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "util.h"
+
+#define BF_WRITER_SIZE (1 << 20)
+
+struct writer {
+    char bytes[BF_WRITER_SIZE];
+    size_t len;
+    int fd;
+};
+
+static struct writer out = {{0}, 0, STDOUT_FILENO};
+
+// 寫出緩衝區內容；處理部分寫入與 EINTR，寫入失敗（例如磁碟已滿）時結束
+static void out_flush(void){
+    size_t done = 0;
+    while (done < out.len){
+        ssize_t n = write(out.fd, out.bytes + done, out.len - done);
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            err("write failed");
+        }
+        done += (size_t)n;
+    }
+    out.len = 0;
+}
+
+static inline void out_bytes(const void *bytes, size_t n){
+    if (out.len + n > sizeof(out.bytes)){
+        out_flush();
+        if (n > sizeof(out.bytes)){
+            // 比緩衝區還大的內容直接寫出
+            for (size_t done = 0; done < n; ){
+                ssize_t w = write(out.fd, (const char *)bytes + done, n - done);
+                if (w < 0 && errno == EINTR){
+                    continue;
+                }
+                if (w <= 0){
+                    err("write failed");
+                }
+                done += (size_t)w;
+            }
+            return;
+        }
+    }
+    memcpy(out.bytes + out.len, bytes, n);
+    out.len += n;
+}
+
+// 與 puts() 相同：字串後面加上換行
+static inline void out_puts(const char *s){
+    out_bytes(s, strlen(s));
+    out_bytes("\n", 1);
+}
+
+// 把整數寫成十進位（或十六進位），回傳字元數
+static inline size_t out_format_int(char *buf, unsigned long long u, int negative, unsigned base){
+    char digits[24];
+    size_t n = 0, len = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[u % base];
+        u /= base;
+    } while (u != 0);
+    if (negative){
+        buf[len++] = '-';
+    }
+    while (n > 0){
+        buf[len++] = digits[--n];
+    }
+    return len;
+}
+
+static void out_printf(const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    const char *p = fmt;
+    while (*p != '\0'){
+        const char *literal = p;
+        while (*p != '\0' && *p != '%'){
+            p++;
+        }
+        out_bytes(literal, (size_t)(p - literal));
+        if (*p == '\0'){
+            break;
+        }
+        p++;
+        char buf[24];
+        long long v;
+        switch (*p++) {
+            case '%':
+                out_bytes("%", 1);
+                break;
+            case 'c':
+                buf[0] = (char)va_arg(ap, int);
+                out_bytes(buf, 1);
+                break;
+            case 's':
+                {
+                    const char *s = va_arg(ap, const char *);
+                    out_bytes(s, strlen(s));
+                }
+                break;
+            case 'd':
+                v = va_arg(ap, int);
+                out_bytes(buf, out_format_int(buf, v < 0 ? -(unsigned long long)v : (unsigned long long)v, v < 0, 10));
+                break;
+            case 'x':
+                out_bytes(buf, out_format_int(buf, va_arg(ap, unsigned), 0, 16));
+                break;
+            case 'z':
+                if (*p++ != 'u'){
+                    err("out_printf: unsupported format");
+                }
+                out_bytes(buf, out_format_int(buf, va_arg(ap, size_t), 0, 10));
+                break;
+            case 'l':
+                if (*p == 'l'){
+                    p++;
+                    v = va_arg(ap, long long);
+                }else{
+                    v = va_arg(ap, long);
+                }
+                if (*p++ != 'd'){
+                    err("out_printf: unsupported format");
+                }
+                out_bytes(buf, out_format_int(buf, v < 0 ? -(unsigned long long)v : (unsigned long long)v, v < 0, 10));
+                break;
+            default:
+                err("out_printf: unsupported format");
+        }
+    }
+    va_end(ap);
+}
+
+#endif
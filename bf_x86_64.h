@@ -0,0 +1,111 @@
+// x86-64 機器碼編碼：行程內 JIT（interpreter/jit_x86_64.h）與 compiler_x86_64 --emit-elf 共用的
+// 可成長機器碼緩衝區，以及以 %r12 為數據指標、依儲存格寬度加上前綴的指令編碼。
+// 只產生位元組，不依賴執行的平台。
+#ifndef BF_X86_64_H
+#define BF_X86_64_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+// JIT 呼叫 C 函式的 relocation（--emit-elf 另有自己的 fixup 表，不使用）
+struct jit_reloc {
+    uint32_t at;        // movabsq 立即值在機器碼中的位置
+    uint32_t symbol;    // enum jit_symbol
+};
+
+struct code_buffer {
+    uint8_t *bytes;
+    size_t size;
+    size_t capacity;
+    struct jit_reloc *relocs;
+    size_t reloc_count;
+    size_t reloc_capacity;
+};
+
+static inline void emit_bytes(struct code_buffer *code, const void *bytes, size_t n){
+    if (code->size + n > code->capacity){
+        code->capacity = code->capacity ? code->capacity * 2 : 4096;
+        while (code->size + n > code->capacity){
+            code->capacity *= 2;
+        }
+        code->bytes = realloc(code->bytes, code->capacity);
+        if (code->bytes == NULL){
+            err("memory allocation failed");
+        }
+    }
+    memcpy(code->bytes + code->size, bytes, n);
+    code->size += n;
+}
+
+static inline void emit_u8(struct code_buffer *code, uint8_t b){
+    emit_bytes(code, &b, 1);
+}
+
+static inline void emit_i32(struct code_buffer *code, int32_t v){
+    emit_bytes(code, &v, 4);
+}
+
+static inline void emit_u64(struct code_buffer *code, uint64_t v){
+    emit_bytes(code, &v, 8);
+}
+
+// 回填位於 at 的 rel32，使其跳到 target
+static inline void patch_rel32(struct code_buffer *code, size_t at, size_t target){
+    int32_t rel = (int32_t)(target - (at + 4));
+    memcpy(code->bytes + at, &rel, 4);
+}
+
+// ModRM + SIB + 位移，定址 disp(%r12)；%r12 作為 base 一定要帶 SIB (0x24)
+static inline void emit_r12_operand(struct code_buffer *code, int reg, int disp){
+    if (disp == 0){
+        emit_u8(code, (uint8_t)(0x04 | (reg << 3)));
+        emit_u8(code, 0x24);
+    }else if (disp >= -128 && disp <= 127){
+        emit_u8(code, (uint8_t)(0x44 | (reg << 3)));
+        emit_u8(code, 0x24);
+        emit_u8(code, (uint8_t)disp);
+    }else{
+        emit_u8(code, (uint8_t)(0x84 | (reg << 3)));
+        emit_u8(code, 0x24);
+        emit_i32(code, disp);
+    }
+}
+
+// 作用在 disp(%r12) 儲存格上的指令：8 位元用 op8，其他寬度用 op，
+// 16 位元加上運算元大小前綴 0x66，64 位元的 REX 加上 W（0x41 → 0x49）；reg 為 %r8–%r15 時 REX 另加上 R
+static inline void emit_cell_op(struct code_buffer *code, int bytes, uint8_t op8, uint8_t op, int reg, int disp){
+    if (bytes == 2){
+        emit_u8(code, 0x66);
+    }
+    emit_u8(code, (uint8_t)((bytes == 8 ? 0x49 : 0x41) | (reg >= 8 ? 0x04 : 0)));
+    emit_u8(code, bytes == 1 ? op8 : op);
+    emit_r12_operand(code, reg & 7, disp * bytes);
+}
+
+// 儲存格寬度的立即值：8、16 位元照寬度編碼，32、64 位元為 imm32（64 位元時由 CPU 符號延伸）
+static inline void emit_cell_imm(struct code_buffer *code, int bytes, int64_t v){
+    if (bytes == 1){
+        emit_u8(code, (uint8_t)v);
+    }else if (bytes == 2){
+        uint16_t w = (uint16_t)v;
+        emit_bytes(code, &w, 2);
+    }else{
+        emit_i32(code, (int32_t)v);
+    }
+}
+
+// cmp $0, (%r12)
+static inline void emit_cmp_cell_zero(struct code_buffer *code, int bytes){
+    emit_cell_op(code, bytes, 0x80, 0x83, 7, 0);
+    emit_u8(code, 0);
+}
+
+// addq $delta, %r12
+static inline void emit_move_r12(struct code_buffer *code, int delta){
+    emit_bytes(code, "\x49\x81\xc4", 3);
+    emit_i32(code, delta);
+}
+
+#endif
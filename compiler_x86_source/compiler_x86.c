@@ -2,286 +2,465 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../util.h"
+#include "../bf_ir.h"
+#include "../bf_source.h"
+#include "../bf_writer.h"
 
-// 死代碼消除優化：移除相互抵消的指令
-// 返回優化後的新字符串（需要調用者 free）
-char* eliminate_dead_code(const char *text_body) {
-    size_t len = strlen(text_body);
-    char *optimized = malloc(len + 1);
-    if (optimized == NULL) {
-        err("Memory allocation failed");
+// 位移折疊後，儲存格以 disp(%ecx) 定址存取
+static const char *cell(int offset) {
+    static char operand[32];
+    if (offset == 0) {
+        return "(%ecx)";
     }
-    
-    size_t write_pos = 0;
-    
-    for (size_t i = 0; i < len; i++) {
-        char current = text_body[i];
-        
-        // 只處理 Brainfuck 有效指令
-        if (current != '+' && current != '-' && 
-            current != '>' && current != '<' && 
-            current != '.' && current != ',' && 
-            current != '[' && current != ']') {
-            continue; // 跳過非 Brainfuck 指令（註解等）
-        }
-        
-        // 檢查是否可以與前一個指令抵消
-        if (write_pos > 0) {
-            char prev = optimized[write_pos - 1];
-            
-            // 檢測相互抵消的指令對
-            if ((prev == '+' && current == '-') || 
-                (prev == '-' && current == '+') ||
-                (prev == '>' && current == '<') || 
-                (prev == '<' && current == '>')) {
-                // 抵消：移除前一個指令，不添加當前指令
-                write_pos--;
-                continue;
-            }
-        }
-        
-        // 添加當前指令
-        optimized[write_pos++] = current;
-    }
-    
-    optimized[write_pos] = '\0';
-    return optimized;
+    size_t n = out_format_int(operand, offset < 0 ? -(unsigned long long)offset : (unsigned long long)offset, offset < 0, 10);
+    memcpy(operand + n, "(%ecx)", 7);
+    return operand;
 }
 
-// 檢測並展開簡單迴圈
-// 返回值：如果可以展開，返回跳過的字符數；否則返回 0
-int try_unroll_loop_x86(const char *text_body, unsigned long start_pos) {
-    if (text_body[start_pos] != '[') return 0;
-    
-    unsigned long pos = start_pos + 1;
-    unsigned long loop_start = pos;
-    int depth = 1;
-    
-    // 找到對應的 ]
-    while (depth > 0 && text_body[pos] != '\0') {
-        if (text_body[pos] == '[') depth++;
-        else if (text_body[pos] == ']') depth--;
-        pos++;
-    }
-    
-    if (depth != 0) return 0; // 沒有找到匹配的 ]
-    
-    unsigned long loop_end = pos - 1;
-    unsigned long loop_len = loop_end - loop_start;
-    
-    // 檢查是否為 [-], [+], [>], [<] 等簡單模式
-    if (loop_len == 1) {
-        char op = text_body[loop_start];
-        
-        // [-] 或 [+] - 清零迴圈
-        if (op == '-' || op == '+') {
-            puts("    movb $0, (%ecx)");
-            return pos - start_pos; // 返回跳過的字符數
-        }
-        
-        // [>] 或 [<] - 掃描迴圈
-        if (op == '>') {
-            printf("loop_scan_right_%lu:\n", start_pos);
-            puts("    cmpb $0, (%ecx)");
-            printf("    je loop_scan_right_%lu_end\n", start_pos);
-            puts("    incl %ecx");
-            printf("    jmp loop_scan_right_%lu\n", start_pos);
-            printf("loop_scan_right_%lu_end:\n", start_pos);
-            return pos - start_pos;
-        }
-        
-        if (op == '<') {
-            printf("loop_scan_left_%lu:\n", start_pos);
-            puts("    cmpb $0, (%ecx)");
-            printf("    je loop_scan_left_%lu_end\n", start_pos);
-            puts("    decl %ecx");
-            printf("    jmp loop_scan_left_%lu\n", start_pos);
-            printf("loop_scan_left_%lu_end:\n", start_pos);
-            return pos - start_pos;
-        }
-    }
-    
-    // 檢查連續的 > 或 <（如 [>>>], [<<<]）
-    if (loop_len > 1) {
-        char first = text_body[loop_start];
-        int can_unroll = 1;
-        
-        for (unsigned long i = loop_start; i < loop_end; i++) {
-            if (text_body[i] != first) {
-                can_unroll = 0;
-                break;
-            }
-        }
-        
-        if (can_unroll && (first == '>' || first == '<')) {
-            int step = loop_len;
-            
-            if (first == '>') {
-                printf("loop_scan_right_%lu:\n", start_pos);
-                puts("    cmpb $0, (%ecx)");
-                printf("    je loop_scan_right_%lu_end\n", start_pos);
-                printf("    addl $%d, %%ecx\n", step);
-                printf("    jmp loop_scan_right_%lu\n", start_pos);
-                printf("loop_scan_right_%lu_end:\n", start_pos);
-            } else {
-                printf("loop_scan_left_%lu:\n", start_pos);
-                puts("    cmpb $0, (%ecx)");
-                printf("    je loop_scan_left_%lu_end\n", start_pos);
-                printf("    subl $%d, %%ecx\n", step);
-                printf("    jmp loop_scan_left_%lu\n", start_pos);
-                printf("loop_scan_left_%lu_end:\n", start_pos);
-            }
-            return pos - start_pos;
+// 輸出緩衝大小的預設值；0 表示無緩衝（--unbuffered），每個 `.` 一次 sys_write
+#define OUTPUT_BUFFER_DEFAULT (64 * 1024)
+// 輸入區塊大小：stdin 不是一般檔案時一次 sys_read 讀入的位元組數
+#define INPUT_BUFFER_SIZE (64 * 1024)
+
+// 紙帶大小的預設值（格數），實際配置時向上取整到頁面大小
+#define TAPE_SIZE_DEFAULT 30000
+#define PAGE_SIZE 4096
+// 紙帶前後 PROT_NONE 保護區的大小
+#define TAPE_GUARD (1 << 20)
+
+// 程式是否含有 `,`；沒有時不產生輸入緩衝的程式碼
+static int uses_input(const struct program *prog) {
+    for (int i = 0; i < prog->size; i++) {
+        if (prog->ops[i].type == OP_IN) {
+            return 1;
         }
     }
-    
-    return 0; // 無法展開
+    return 0;
 }
 
-void compile(const char * const text_body){
-    int num_brackets=0;
-    int matching_brackets=0;
-    struct stack stack={.size=0,.items={0}};
-
+// 將 IR（已由 bf_ir.h 做完指令合併、死代碼消除、迴圈辨識、位移折疊）翻譯為 x86-32 組語
+void compile(const struct program *prog, int output_buffer, size_t tape_size){
     // 使用系統調用，不依賴 C 庫
     // 暫存器分配優化：
     // %ecx = 數據指標（指向當前記憶體位置）
     // %esi = 常數 1（用於 sys_write, stdout, 長度）
     // %edi = 常數 0（用於 stdin）
+    // %eax / %edx = 線性迴圈的計數值與乘積
+    // %ebp = 輸出緩衝的寫入位置（有緩衝時）
+    // input_pos / input_end = 輸入游標與可讀範圍結尾（有 `,` 時，暫存器不足所以放在記憶體）
+    // 紙帶：mmap2 一塊 PROT_NONE 區域，只把中間 tape_size 格改為可讀寫，前後各留 TAPE_GUARD 的保護區；
+    // 頁面在第一次寫入時才配置，初始全為 0。越界存取由 segv_handler 回報位置，不需要逐次比較邊界
+    tape_size = (tape_size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    out_printf(".section .note.GNU-stack,\"\",%%progbits\n"
+           ".section .bss\n"
+           "tape_base: .skip 4\n"
+           "segv_cell: .skip 4\n"
+           "segv_digits: .skip 12\n"
+           ".section .data\n"
+           "segv_action:\n"                  // 核心的 struct sigaction
+           "    .long segv_handler\n"
+           "    .long 4\n"                   // SA_SIGINFO
+           "    .long 0\n"
+           "    .long 0, 0\n"
+           "segv_msg: .ascii \"tape overflow: cell \"\n"
+           "segv_msg_end:\n"
+           "segv_suffix: .ascii \" is outside the tape [0, %zu)\\n\"\n"
+           "segv_suffix_end:\n"
+           "tape_error: .ascii \"unable to allocate the tape\\n\"\n"
+           "tape_error_end:\n", tape_size);
+    out_printf(".section .text\n"
+           ".global _start\n"
+           "_start:\n"
+           "    movl $192, %%eax\n"            // sys_mmap2(NULL, total, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0)
+           "    xorl %%ebx, %%ebx\n"
+           "    movl $%zu, %%ecx\n"
+           "    xorl %%edx, %%edx\n"
+           "    movl $0x4022, %%esi\n"
+           "    movl $-1, %%edi\n"
+           "    xorl %%ebp, %%ebp\n"
+           "    int $0x80\n"
+           "    cmpl $-4096, %%eax\n"
+           "    ja tape_alloc_failed\n"
+           "    leal %d(%%eax), %%ebx\n"
+           "    movl %%ebx, tape_base\n"
+           "    movl $125, %%eax\n"            // sys_mprotect(tape_base, tape_size, PROT_READ|PROT_WRITE)
+           "    movl $%zu, %%ecx\n"
+           "    movl $3, %%edx\n"
+           "    int $0x80\n"
+           "    testl %%eax, %%eax\n"
+           "    jne tape_alloc_failed\n"
+           "    movl $174, %%eax\n"            // sys_rt_sigaction(SIGSEGV, &segv_action, NULL, 8)
+           "    movl $11, %%ebx\n"
+           "    movl $segv_action, %%ecx\n"
+           "    xorl %%edx, %%edx\n"
+           "    movl $8, %%esi\n"
+           "    int $0x80\n",
+           tape_size + 2 * (size_t)TAPE_GUARD, TAPE_GUARD, tape_size);
     const char * const prologue=
-        ".section .note.GNU-stack,\"\",%progbits\n"
-        ".section .data\n"
-        "memory: .skip 30000\n"          // 靜態分配記憶體
-        ".section .text\n"
-        ".global _start\n"
-        "_start:\n"
-        "    leal memory, %ecx\n"        // ecx 指向記憶體起始
+        "    movl tape_base, %ecx\n"     // ecx 指向第 0 格
         "    movl $1, %esi\n"            // esi = 1（常數暫存器）
         "    movl $0, %edi\n";           // edi = 0（常數暫存器）
-    puts(prologue);
+    out_puts(prologue);
+    if (output_buffer > 0) {
+        // 輸出緩衝：`.` 只寫進 outbuf，滿了、`,` 之前與結束時才呼叫 flush_output
+        out_printf(".section .bss\n"
+               "outbuf: .skip %d\n"
+               "outbuf_end:\n"
+               ".section .text\n", output_buffer);
+        out_puts("    movl $outbuf, %ebp");
+    }
+    int input = uses_input(prog);
+    if (input) {
+        // 輸入：stdin 為一般檔案時 mmap 整個檔案，`,` 只是遞增 input_pos；
+        // 否則（pipe、tty）由 fill_input 以 sys_read 一次讀入一個區塊
+        out_printf(".section .bss\n"
+               "inbuf: .skip %d\n"
+               "input_pos: .skip 4\n"
+               "input_end: .skip 4\n"
+               "input_mapped: .skip 1\n"
+               "statbuf: .skip 64\n"
+               ".section .text\n", INPUT_BUFFER_SIZE);
+        const char * const input_setup=
+            "    pushal\n"                      // mmap2 需要用到全部六個參數暫存器
+            "    movl $108, %eax\n"             // sys_fstat(0, &statbuf)
+            "    xorl %ebx, %ebx\n"
+            "    movl $statbuf, %ecx\n"
+            "    int $0x80\n"
+            "    testl %eax, %eax\n"
+            "    jne input_setup_block\n"
+            "    movzwl statbuf+8, %eax\n"      // st_mode
+            "    andl $0xf000, %eax\n"
+            "    cmpl $0x8000, %eax\n"          // S_ISREG
+            "    jne input_setup_block\n"
+            "    movl $19, %eax\n"              // sys_lseek(0, 0, SEEK_CUR)：目前的檔案位置
+            "    xorl %ebx, %ebx\n"
+            "    xorl %ecx, %ecx\n"
+            "    movl $1, %edx\n"
+            "    int $0x80\n"
+            "    cmpl statbuf+20, %eax\n"       // 位置錯誤（負值）或已讀完都改用區塊讀取
+            "    jae input_setup_block\n"
+            "    movl %eax, input_pos\n"
+            "    movl $192, %eax\n"             // sys_mmap2(NULL, size, PROT_READ, MAP_PRIVATE, 0, 0)
+            "    xorl %ebx, %ebx\n"
+            "    movl statbuf+20, %ecx\n"
+            "    movl $1, %edx\n"
+            "    movl $2, %esi\n"
+            "    xorl %edi, %edi\n"
+            "    xorl %ebp, %ebp\n"
+            "    int $0x80\n"
+            "    cmpl $-4096, %eax\n"
+            "    ja input_setup_block\n"
+            "    addl %eax, input_pos\n"
+            "    addl statbuf+20, %eax\n"
+            "    movl %eax, input_end\n"
+            "    movb $1, input_mapped\n"
+            "    jmp input_setup_done\n"
+            "input_setup_block:\n"
+            "    movl $inbuf, input_pos\n"
+            "    movl $inbuf, input_end\n"
+            "input_setup_done:\n"
+            "    popal";
+        out_puts(input_setup);
+    }
 
-    for(unsigned long i=0;text_body[i]!='\0';++i){
-        // 指令合併優化：計算連續相同指令的數量
-        int count = 1;
-        char current = text_body[i];
-        
-        // 只對 +, -, >, < 進行合併優化
-        if (current == '+' || current == '-' || current == '>' || current == '<') {
-            while (text_body[i+1] == current) {
-                count++;
-                i++;
-            }
-        }
-        
-        switch (current){
-            case '>':
-                if (count == 1) {
-                    puts("    incl %ecx");
-                } else {
-                    printf("    addl $%d, %%ecx\n", count);
+    for (int i = 0; i < prog->size; i++) {
+        const struct op *op = &prog->ops[i];
+        switch (op->type) {
+            case OP_ADD:
+                {
+                    // 以 8 位元計算，負數改寫成減法
+                    int k = (int)cell_value(op->arg, 8);
+                    if (k == 1) {
+                        out_printf("    incb %s\n", cell(op->offset));
+                    } else if (k == -1) {
+                        out_printf("    decb %s\n", cell(op->offset));
+                    } else if (k > 0) {
+                        out_printf("    addb $%d, %s\n", k, cell(op->offset));
+                    } else {
+                        out_printf("    subb $%d, %s\n", -k, cell(op->offset));
+                    }
                 }
                 break;
-            case '<':
-                if (count == 1) {
-                    puts("    decl %ecx");
+            case OP_MOVE:
+                if (op->arg == 1) {
+                    out_puts("    incl %ecx");
+                } else if (op->arg == -1) {
+                    out_puts("    decl %ecx");
+                } else if (op->arg > 0) {
+                    out_printf("    addl $%d, %%ecx\n", op->arg);
                 } else {
-                    printf("    subl $%d, %%ecx\n", count);
+                    out_printf("    subl $%d, %%ecx\n", -op->arg);
                 }
                 break;
-            case '+':
-                if (count == 1) {
-                    puts("    incb (%ecx)");
-                } else {
-                    printf("    addb $%d, (%%ecx)\n", count);
+            case OP_OUT:
+                if (output_buffer > 0) {
+                    out_printf("    movb %s, %%al\n", cell(op->offset));
+                    out_puts("    movb %al, (%ebp)");
+                    out_puts("    incl %ebp");
+                    out_puts("    cmpl $outbuf_end, %ebp");
+                    out_printf("    jne out_%d_done\n", i);
+                    out_puts("    call flush_output");
+                    out_printf("out_%d_done:\n", i);
+                    break;
                 }
+                // 使用 sys_write 系統調用
+                // 利用暫存器分配優化：esi = 1（stdout, 長度）
+                out_puts("    movl $4, %eax");      // sys_write
+                out_puts("    movl %esi, %ebx");    // stdout = 1（從 esi）
+                out_puts("    pushl %ecx");         // 保存 ecx（數據指標）
+                if (op->offset != 0) {
+                    out_printf("    leal %s, %%ecx\n", cell(op->offset)); // 數據指針加上位移
+                }
+                out_puts("    movl %esi, %edx");    // 長度 = 1（從 esi）
+                out_puts("    int $0x80");
+                out_puts("    popl %ecx");          // 恢復 ecx
                 break;
-            case '-':
-                if (count == 1) {
-                    puts("    decb (%ecx)");
-                } else {
-                    printf("    subb $%d, (%%ecx)\n", count);
+            case OP_IN:
+                // 從輸入緩衝取一個位元組；讀完時呼叫 fill_input，EOF 時儲存格保持不變
+                out_puts("    movl input_pos, %edx");
+                out_puts("    cmpl input_end, %edx");
+                out_printf("    jb in_%d_load\n", i);
+                if (output_buffer > 0) {
+                    out_puts("    call flush_output");   // 可能等待輸入前先送出提示文字
                 }
+                out_puts("    call fill_input");
+                out_puts("    testl %eax, %eax");
+                out_printf("    jle in_%d_done\n", i);
+                out_puts("    movl input_pos, %edx");
+                out_printf("in_%d_load:\n", i);
+                out_puts("    movb (%edx), %al");
+                out_puts("    incl %edx");
+                out_puts("    movl %edx, input_pos");
+                out_printf("    movb %%al, %s\n", cell(op->offset));
+                out_printf("in_%d_done:\n", i);
                 break;
-            case '.':
-                // 使用 sys_write 系統調用
-                // 利用暫存器分配優化：esi = 1（stdout, 長度）
-                puts("    movl $4, %eax");      // sys_write
-                puts("    movl %esi, %ebx");    // stdout = 1（從 esi）
-                puts("    pushl %ecx");         // 保存 ecx（數據指標）
-                puts("    movl %ecx, %edx");    // 暫存數據指針
-                puts("    movl %edx, %ecx");    // 數據指針（int 0x80 的 ecx 參數）
-                puts("    movl %esi, %edx");    // 長度 = 1（從 esi）
-                puts("    int $0x80");
-                puts("    popl %ecx");          // 恢復 ecx
+            case OP_JZ:
+                // 以 [ 在 IR 中的位置作為迴圈編號
+                out_puts("    cmpb $0, (%ecx)");
+                out_printf("    je bracket_%d_end\n", i);
+                out_printf("bracket_%d_start:\n", i);
                 break;
-            case ',':
-                // 使用 sys_read 系統調用
-                // 利用暫存器分配優化：edi = 0（stdin），esi = 1（長度）
-                puts("    movl $3, %eax");      // sys_read
-                puts("    movl %edi, %ebx");    // stdin = 0（從 edi）
-                puts("    pushl %ecx");         // 保存 ecx（數據指標）
-                puts("    movl %ecx, %edx");    // 暫存數據指針
-                puts("    movl %edx, %ecx");    // 數據指針（int 0x80 的 ecx 參數）
-                puts("    movl %esi, %edx");    // 長度 = 1（從 esi）
-                puts("    int $0x80");
-                puts("    popl %ecx");          // 恢復 ecx
+            case OP_JNZ:
+                out_puts("    cmpb $0, (%ecx)");
+                out_printf("    jne bracket_%d_start\n", op->arg);
+                out_printf("bracket_%d_end:\n", op->arg);
                 break;
-            case '[':
+            case OP_SCAN:
                 {
-                    // 嘗試迴圈展開優化
-                    int skipped = try_unroll_loop_x86(text_body, i);
-                    if (skipped > 0) {
-                        // 迴圈已展開，跳過整個迴圈
-                        i += skipped - 1; // -1 因為 for 迴圈會 ++i
-                        break;
-                    }
-                    
-                    // 無法展開，使用正常迴圈生成
-                    if (stack_push(&stack,num_brackets)==0){
-                        puts  ("    cmpb $0, (%ecx)");
-                        printf("    je bracket_%d_end\n", num_brackets);
-                        printf("bracket_%d_start:\n", num_brackets++);
+                    // [>]、[<<] 等掃描迴圈
+                    const char *dir = op->arg > 0 ? "right" : "left";
+                    out_printf("loop_scan_%s_%d:\n", dir, i);
+                    out_puts("    cmpb $0, (%ecx)");
+                    out_printf("    je loop_scan_%s_%d_end\n", dir, i);
+                    if (op->arg == 1) {
+                        out_puts("    incl %ecx");
+                    } else if (op->arg == -1) {
+                        out_puts("    decl %ecx");
+                    } else if (op->arg > 0) {
+                        out_printf("    addl $%d, %%ecx\n", op->arg);
                     } else {
-                        err("out of stack space");
+                        out_printf("    subl $%d, %%ecx\n", -op->arg);
                     }
+                    out_printf("    jmp loop_scan_%s_%d\n", dir, i);
+                    out_printf("loop_scan_%s_%d_end:\n", dir, i);
                 }
                 break;
-            case ']':
-                if (stack_pop(&stack,&matching_brackets)==0){
-                    puts  ("    cmpb $0, (%ecx)");
-                    printf("    jne bracket_%d_start\n", matching_brackets);
-                    printf("bracket_%d_end:\n", matching_brackets);
-                } else {
-                    err("stack underflow, unmatched");
+            case OP_MUL:
+                // 線性迴圈：計數格為 0 時跳過，避免以偏移量存取到紙帶外
+                out_printf("    movzbl %s, %%eax\n", cell(op->offset));
+                out_puts("    testl %eax, %eax");
+                out_printf("    je mul_%d_end\n", i);
+                for (int j = 1; j <= op->arg; j++) {
+                    const struct op *term = &op[j];
+                    if (term->arg == 1) {
+                        out_printf("    addb %%al, %s\n", cell(term->offset));
+                    } else if (term->arg == -1) {
+                        out_printf("    subb %%al, %s\n", cell(term->offset));
+                    } else {
+                        out_printf("    imull $%d, %%eax, %%edx\n", term->arg);
+                        out_printf("    addb %%dl, %s\n", cell(term->offset));
+                    }
                 }
+                out_printf("    movb $0, %s\n", cell(op->offset));
+                out_printf("mul_%d_end:\n", i);
+                i += op->arg + 1;  // 已處理後面的 OP_MUL_ADD 與 OP_CLEAR
+                break;
+            case OP_MUL_ADD:
+                break;
+            case OP_CLEAR:
+                out_printf("    movb $0, %s\n", cell(op->offset));
+                break;
+            case OP_END:
                 break;
         }
     }
 
+    if (output_buffer > 0) {
+        out_puts("    call flush_output");
+    }
     // 使用 sys_exit 退出
     const char * const epilogue=
         "    movl $1, %eax\n"      // sys_exit
         "    xorl %ebx, %ebx\n"    // 退出碼 = 0
         "    int $0x80\n";
-    puts(epilogue);
+    out_puts(epilogue);
+
+    // 紙帶越界：先送出已緩衝的輸出，再以 "tape overflow: cell N ..." 回報位置並以狀態 1 結束
+    // 4(%esp) = 訊號編號，8(%esp) = siginfo（si_addr 在位移 12），12(%esp) = ucontext（中斷時的 %ebp 在位移 44）
+    out_puts("segv_handler:");
+    out_puts("    movl 8(%esp), %eax");
+    out_puts("    movl 12(%eax), %eax");
+    out_puts("    subl tape_base, %eax");      // 越界的格子位置
+    out_puts("    movl %eax, segv_cell");
+    out_puts("    movl $1, %esi");             // handler 內不能假設常數暫存器仍有效
+    out_puts("    movl $0, %edi");
+    if (output_buffer > 0) {
+        out_puts("    movl 12(%esp), %eax");
+        out_puts("    movl 44(%eax), %ebp");
+        out_puts("    call flush_output");
+    }
+    const char * const segv_report=
+        "    movl $4, %eax\n"                    // sys_write(2, segv_msg)
+        "    movl $2, %ebx\n"
+        "    movl $segv_msg, %ecx\n"
+        "    movl $(segv_msg_end - segv_msg), %edx\n"
+        "    int $0x80\n"
+        "    movl $segv_digits+12, %ecx\n"       // 由個位數往前寫十進位數字
+        "    movl segv_cell, %eax\n"
+        "    testl %eax, %eax\n"
+        "    jns segv_positive\n"
+        "    negl %eax\n"
+        "segv_positive:\n"
+        "    movl $10, %ebx\n"
+        "segv_digit:\n"
+        "    xorl %edx, %edx\n"
+        "    divl %ebx\n"
+        "    addb $48, %dl\n"
+        "    decl %ecx\n"
+        "    movb %dl, (%ecx)\n"
+        "    testl %eax, %eax\n"
+        "    jne segv_digit\n"
+        "    cmpl $0, segv_cell\n"
+        "    jge segv_print\n"
+        "    decl %ecx\n"
+        "    movb $45, (%ecx)\n"                 // '-'
+        "segv_print:\n"
+        "    movl $segv_digits+12, %edx\n"
+        "    subl %ecx, %edx\n"
+        "    movl $4, %eax\n"
+        "    movl $2, %ebx\n"
+        "    int $0x80\n"
+        "    movl $4, %eax\n"                    // sys_write(2, segv_suffix)
+        "    movl $2, %ebx\n"
+        "    movl $segv_suffix, %ecx\n"
+        "    movl $(segv_suffix_end - segv_suffix), %edx\n"
+        "    int $0x80\n"
+        "    movl $1, %eax\n"                    // sys_exit(1)
+        "    movl $1, %ebx\n"
+        "    int $0x80\n"
+        "tape_alloc_failed:\n"
+        "    movl $4, %eax\n"                    // sys_write(2, tape_error)
+        "    movl $2, %ebx\n"
+        "    movl $tape_error, %ecx\n"
+        "    movl $(tape_error_end - tape_error), %edx\n"
+        "    int $0x80\n"
+        "    movl $1, %eax\n"                    // sys_exit(1)
+        "    movl $1, %ebx\n"
+        "    int $0x80\n";
+    out_puts(segv_report);
+
+    if (output_buffer > 0) {
+        // 寫出 [outbuf, %ebp)，處理部分寫入；寫入失敗時丟棄剩餘內容
+        // 保留 %ecx（數據指標），會覆寫 %eax、%ebx、%edx
+        const char * const flush_output=
+            "flush_output:\n"
+            "    pushl %ecx\n"
+            "    movl $outbuf, %ecx\n"
+            "    movl %ebp, %edx\n"
+            "    subl %ecx, %edx\n"           // 長度 = 寫入位置 - 起點
+            "flush_output_loop:\n"
+            "    testl %edx, %edx\n"
+            "    jle flush_output_done\n"
+            "    movl $4, %eax\n"             // sys_write
+            "    movl %esi, %ebx\n"           // stdout = 1（從 esi）
+            "    int $0x80\n"
+            "    testl %eax, %eax\n"
+            "    jle flush_output_done\n"
+            "    addl %eax, %ecx\n"
+            "    subl %eax, %edx\n"
+            "    jmp flush_output_loop\n"
+            "flush_output_done:\n"
+            "    movl $outbuf, %ebp\n"
+            "    popl %ecx\n"
+            "    ret\n";
+        out_puts(flush_output);
+    }
+
+    if (input) {
+        // 重新填入輸入緩衝，回傳讀到的位元組數（<= 0 為 EOF 或錯誤）；mmap 的 stdin 讀完即為 EOF
+        // 保留 %ecx（數據指標），會覆寫 %eax、%ebx、%edx
+        out_printf("fill_input:\n"
+               "    cmpb $0, input_mapped\n"
+               "    jne fill_input_eof\n"
+               "    pushl %%ecx\n"
+               "    movl $3, %%eax\n"             // sys_read
+               "    movl %%edi, %%ebx\n"          // stdin = 0（從 edi）
+               "    movl $inbuf, %%ecx\n"
+               "    movl $%d, %%edx\n"
+               "    int $0x80\n"
+               "    popl %%ecx\n"
+               "    testl %%eax, %%eax\n"
+               "    jle fill_input_done\n"
+               "    movl $inbuf, input_pos\n"
+               "    leal inbuf(%%eax), %%edx\n"
+               "    movl %%edx, input_end\n"
+               "fill_input_done:\n"
+               "    ret\n"
+               "fill_input_eof:\n"
+               "    xorl %%eax, %%eax\n"
+               "    ret\n", INPUT_BUFFER_SIZE);
+    }
 }
 
 int main(int argc,char *argv[]){
-    if (argc!=2){
-        err("Usage: compiler_x86 inputfile");
+    unsigned passes_mask = PASS_ALL;
+    int output_buffer = OUTPUT_BUFFER_DEFAULT;
+    size_t tape_size = TAPE_SIZE_DEFAULT;
+    const char *filepath = NULL;
+    for (int i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc){
+            passes_mask = parse_pass_list(argv[++i]);
+        }else if (strcmp(argv[i], "--unbuffered") == 0){
+            output_buffer = 0;
+        }else if (strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc){
+            output_buffer = atoi(argv[++i]);
+            if (output_buffer < 0) {
+                output_buffer = 0;
+            }
+        }else if (strcmp(argv[i], "--tape-size") == 0 && i + 1 < argc){
+            tape_size = parse_size(argv[++i]);
+        }else if (filepath == NULL){
+            filepath = argv[i];
+        }else{
+            filepath = NULL;
+            break;
+        }
+    }
+    if (filepath == NULL){
+        err("Usage: compiler_x86 [--passes LIST] [--unbuffered] [--output-buffer N] [--tape-size N] inputfile");
     }
-    char *text_body=read_file(argv[1]);
-    if (text_body==NULL){
+    struct source src;
+    if (source_open(&src, filepath) != 0){
         err("Unable to read program text file");
     }
 
-    // 死代碼消除優化
-    char *optimized_body = eliminate_dead_code(text_body);
-    free(text_body);
+    // x86-32 後端只產生 8 位元儲存格的程式碼
+    struct program prog = compile_source(&src, passes_mask, 8);
+    source_close(&src);
 
-    compile(optimized_body);
+    compile(&prog, output_buffer, tape_size);
+    out_flush();
 
-    free(optimized_body);
+    free_program(&prog);
     return 0;
 }
-
@@ -2,280 +2,830 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../util.h"
+#include "../bf_ir.h"
+#include "../bf_source.h"
+#include "../bf_writer.h"
+#include "../bf_cache.h"
 
-// 死代碼消除優化：移除相互抵消的指令
-// 返回優化後的新字符串（需要調用者 free）
-char* eliminate_dead_code(const char *text_body) {
-    size_t len = strlen(text_body);
-    char *optimized = malloc(len + 1);
-    if (optimized == NULL) {
-        err("Memory allocation failed");
+// 每格的位元組數（--cell-bits / 8），決定指令的運算元大小與位移的比例
+static int cell_bytes = 1;
+
+// 位移折疊後，儲存格以 disp(%r12) 定址存取，disp = offset * 每格位元組數
+static const char *cell(int offset) {
+    static char operand[32];
+    if (offset == 0) {
+        return "(%r12)";
+    }
+    int disp = offset * cell_bytes;
+    size_t n = out_format_int(operand, disp < 0 ? -(unsigned long long)disp : (unsigned long long)disp, disp < 0, 10);
+    memcpy(operand + n, "(%r12)", 7);
+    return operand;
+}
+
+// 儲存格寬度對應的指令後綴與暫存器名稱
+static char sfx(void) {
+    switch (cell_bytes) {
+        case 2: return 'w';
+        case 4: return 'l';
+        case 8: return 'q';
+        default: return 'b';
+    }
+}
+
+static const char *reg_a(void) {
+    switch (cell_bytes) {
+        case 2: return "%ax";
+        case 4: return "%eax";
+        case 8: return "%rax";
+        default: return "%al";
     }
-    
-    size_t write_pos = 0;
-    
-    for (size_t i = 0; i < len; i++) {
-        char current = text_body[i];
-        
-        // 只處理 Brainfuck 有效指令
-        if (current != '+' && current != '-' && 
-            current != '>' && current != '<' && 
-            current != '.' && current != ',' && 
-            current != '[' && current != ']') {
-            continue; // 跳過非 Brainfuck 指令（註解等）
+}
+
+static const char *reg_c(void) {
+    switch (cell_bytes) {
+        case 2: return "%cx";
+        case 4: return "%ecx";
+        case 8: return "%rcx";
+        default: return "%cl";
+    }
+}
+
+// 輸出緩衝大小的預設值；0 表示無緩衝（--unbuffered），每個 `.` 一次 sys_write
+#define OUTPUT_BUFFER_DEFAULT (64 * 1024)
+// 輸入區塊大小：stdin 不是一般檔案時一次 sys_read 讀入的位元組數
+#define INPUT_BUFFER_SIZE (64 * 1024)
+
+// 紙帶大小的預設值（格數），實際配置時向上取整到頁面大小
+#define TAPE_SIZE_DEFAULT 30000
+#define PAGE_SIZE 4096
+// 紙帶前後 PROT_NONE 保護區的大小
+#define TAPE_GUARD (1 << 20)
+
+// 程式是否含有 `,`；沒有時不產生輸入緩衝的程式碼
+static int uses_input(const struct program *prog) {
+    for (int i = 0; i < prog->size; i++) {
+        if (prog->ops[i].type == OP_IN) {
+            return 1;
         }
-        
-        // 檢查是否可以與前一個指令抵消
-        if (write_pos > 0) {
-            char prev = optimized[write_pos - 1];
-            
-            // 檢測相互抵消的指令對
-            if ((prev == '+' && current == '-') || 
-                (prev == '-' && current == '+') ||
-                (prev == '>' && current == '<') || 
-                (prev == '<' && current == '>')) {
-                // 抵消：移除前一個指令，不添加當前指令
-                write_pos--;
-                continue;
-            }
+    }
+    return 0;
+}
+
+// 儲存格快取：基本區塊內（兩個迴圈邊界之間）還會再用到的儲存格放進 %r8–%r10，
+// 第一次使用時載入，之後的 + - . 都在暫存器上進行，只在指標移動、迴圈邊界、掃描、線性迴圈、`,`
+// 或暫存器不夠被換出時寫回。載入發生在原本第一次存取的位置，越界仍在同一處被保護頁攔截。
+// 另外追蹤旗標：最後一個改變旗標的指令是目前儲存格的加減時，[ 與 ] 直接沿用 ZF，省略 cmp；
+// 加減的是 [ ] 之前指標要移到的儲存格時，指標移動改用不影響旗標的 lea。
+// compile() 與 elf_image() 逐個 op 呼叫 cache_plan()，兩者產生相同的指令。
+#define CACHE_REGS 3
+// 往後看幾個 op 判斷儲存格是否會再被使用（避免沒有迴圈的巨大區塊變成平方時間）
+#define CACHE_LOOKAHEAD 32
+
+struct cell_cache {
+    int used[CACHE_REGS];
+    int offset[CACHE_REGS];
+    int dirty[CACHE_REGS];
+    int last_use[CACHE_REGS];
+    int zf_valid;           // ZF 反映位移 zf_offset 的儲存格是否為 0
+    int zf_offset;
+    int buffered;           // 有輸出緩衝時 . 直接讀暫存器；無緩衝的 sys_write 需要記憶體中的值
+};
+
+struct cell_plan {
+    int stores;                         // op 之前要寫回記憶體的暫存器數
+    int store_reg[CACHE_REGS];
+    int store_offset[CACHE_REGS];
+    int reg;                            // ADD / CLEAR / OUT 使用的快取暫存器，-1 表示直接存取記憶體
+    int load;                           // 剛放進暫存器：ADD / OUT 先載入，CLEAR 先寫入記憶體再把暫存器設為 0
+    int test;                           // JZ / JNZ 需要 cmp
+    int lea;                            // MOVE 以 lea 移動指標，保留 ZF
+};
+
+// 快取暫存器 reg 在 bytes 位元組寬度下的名稱
+static const char *cache_reg_name(int reg, int bytes) {
+    static const char * const names[4][CACHE_REGS] = {
+        {"%r8b", "%r9b", "%r10b"},
+        {"%r8w", "%r9w", "%r10w"},
+        {"%r8d", "%r9d", "%r10d"},
+        {"%r8", "%r9", "%r10"},
+    };
+    return names[__builtin_ctz(bytes)][reg];
+}
+
+// 把儲存格載入快取暫存器；8、16 位元以零延伸載入整個 32 位元暫存器，避免部分暫存器的相依
+static void cache_fill(int reg, int offset) {
+    switch (cell_bytes) {
+        case 1: out_printf("    movzbl %s, %s\n", cell(offset), cache_reg_name(reg, 4)); break;
+        case 2: out_printf("    movzwl %s, %s\n", cell(offset), cache_reg_name(reg, 4)); break;
+        case 4: out_printf("    movl %s, %s\n", cell(offset), cache_reg_name(reg, 4)); break;
+        default: out_printf("    movq %s, %s\n", cell(offset), cache_reg_name(reg, 8)); break;
+    }
+}
+
+// 儲存格在 i 之後、區塊結束前是否還會被 + - . 或 [-] 使用
+static int cache_reused(const struct program *prog, int i, int offset) {
+    int end = i + CACHE_LOOKAHEAD < prog->size ? i + CACHE_LOOKAHEAD : prog->size;
+    for (int j = i + 1; j < end; j++) {
+        const struct op *op = &prog->ops[j];
+        switch (op->type) {
+            case OP_ADD:
+            case OP_CLEAR:
+            case OP_OUT:
+                if (op->offset == offset) {
+                    return 1;
+                }
+                break;
+            case OP_IN:
+                if (op->offset == offset) {
+                    return 0;
+                }
+                break;
+            default:
+                return 0;
         }
-        
-        // 添加當前指令
-        optimized[write_pos++] = current;
     }
-    
-    optimized[write_pos] = '\0';
-    return optimized;
+    return 0;
 }
 
-// 檢測並展開簡單迴圈（x86-64 版本）
-// 返回值：如果可以展開，返回跳過的字符數；否則返回 0
-int try_unroll_loop_x86_64(const char *text_body, unsigned long start_pos) {
-    if (text_body[start_pos] != '[') return 0;
-    
-    unsigned long pos = start_pos + 1;
-    unsigned long loop_start = pos;
-    int depth = 1;
-    
-    // 找到對應的 ]
-    while (depth > 0 && text_body[pos] != '\0') {
-        if (text_body[pos] == '[') depth++;
-        else if (text_body[pos] == ']') depth--;
-        pos++;
+static void cache_spill(struct cell_cache *c, struct cell_plan *p, int r) {
+    if (c->dirty[r]) {
+        p->store_reg[p->stores] = r;
+        p->store_offset[p->stores] = c->offset[r];
+        p->stores++;
+        c->dirty[r] = 0;
     }
-    
-    if (depth != 0) return 0; // 沒有找到匹配的 ]
-    
-    unsigned long loop_end = pos - 1;
-    unsigned long loop_len = loop_end - loop_start;
-    
-    // 檢查是否為 [-], [+], [>], [<] 等簡單模式
-    if (loop_len == 1) {
-        char op = text_body[loop_start];
-        
-        // [-] 或 [+] - 清零迴圈
-        if (op == '-' || op == '+') {
-            puts("    movb $0, (%r12)");
-            return pos - start_pos; // 返回跳過的字符數
+}
+
+static int cache_find(const struct cell_cache *c, int offset) {
+    for (int r = 0; r < CACHE_REGS; r++) {
+        if (c->used[r] && c->offset[r] == offset) {
+            return r;
         }
-        
-        // [>] 或 [<] - 掃描迴圈
-        if (op == '>') {
-            printf("loop_scan_right_%lu:\n", start_pos);
-            puts("    cmpb $0, (%r12)");
-            printf("    je loop_scan_right_%lu_end\n", start_pos);
-            puts("    incq %r12");
-            printf("    jmp loop_scan_right_%lu\n", start_pos);
-            printf("loop_scan_right_%lu_end:\n", start_pos);
-            return pos - start_pos;
+    }
+    return -1;
+}
+
+// 取得空的暫存器，沒有時換出最久沒用到的
+static int cache_alloc(struct cell_cache *c, struct cell_plan *p, int i, int offset) {
+    int victim = 0;
+    for (int r = 0; r < CACHE_REGS; r++) {
+        if (!c->used[r]) {
+            victim = r;
+            break;
         }
-        
-        if (op == '<') {
-            printf("loop_scan_left_%lu:\n", start_pos);
-            puts("    cmpb $0, (%r12)");
-            printf("    je loop_scan_left_%lu_end\n", start_pos);
-            puts("    decq %r12");
-            printf("    jmp loop_scan_left_%lu\n", start_pos);
-            printf("loop_scan_left_%lu_end:\n", start_pos);
-            return pos - start_pos;
+        if (c->last_use[r] < c->last_use[victim]) {
+            victim = r;
         }
     }
-    
-    // 檢查連續的 > 或 <（如 [>>>], [<<<]）
-    if (loop_len > 1) {
-        char first = text_body[loop_start];
-        int can_unroll = 1;
-        
-        for (unsigned long i = loop_start; i < loop_end; i++) {
-            if (text_body[i] != first) {
-                can_unroll = 0;
-                break;
+    if (c->used[victim]) {
+        cache_spill(c, p, victim);
+    }
+    c->used[victim] = 1;
+    c->offset[victim] = offset;
+    c->dirty[victim] = 0;
+    c->last_use[victim] = i;
+    p->load = 1;
+    return victim;
+}
+
+// 決定 op i 之前要寫回哪些暫存器、op 本身用暫存器還是記憶體，並更新快取與旗標的狀態
+static void cache_plan(struct cell_cache *c, const struct program *prog, int i, struct cell_plan *p) {
+    const struct op *op = &prog->ops[i];
+    memset(p, 0, sizeof(*p));
+    p->reg = -1;
+    int r;
+    switch (op->type) {
+        case OP_ADD:
+        case OP_CLEAR:
+            r = cache_find(c, op->offset);
+            if (r < 0 && cache_reused(prog, i, op->offset)) {
+                r = cache_alloc(c, p, i, op->offset);
             }
-        }
-        
-        if (can_unroll && (first == '>' || first == '<')) {
-            int step = loop_len;
-            
-            if (first == '>') {
-                printf("loop_scan_right_%lu:\n", start_pos);
-                puts("    cmpb $0, (%r12)");
-                printf("    je loop_scan_right_%lu_end\n", start_pos);
-                printf("    addq $%d, %%r12\n", step);
-                printf("    jmp loop_scan_right_%lu\n", start_pos);
-                printf("loop_scan_right_%lu_end:\n", start_pos);
+            if (r >= 0) {
+                c->dirty[r] = op->type == OP_ADD || !p->load;
+                c->last_use[r] = i;
+                p->reg = r;
+            }
+            // add / sub / inc / dec 設定 ZF；[-] 改變儲存格的值但不更新旗標
+            if (op->type == OP_ADD) {
+                c->zf_valid = 1;
+                c->zf_offset = op->offset;
+            } else if (op->offset == c->zf_offset) {
+                c->zf_valid = 0;
+            }
+            break;
+        case OP_OUT:
+            r = cache_find(c, op->offset);
+            if (c->buffered) {
+                if (r < 0 && cache_reused(prog, i, op->offset)) {
+                    r = cache_alloc(c, p, i, op->offset);
+                }
+                if (r >= 0) {
+                    c->last_use[r] = i;
+                    p->reg = r;
+                }
+            } else if (r >= 0) {
+                cache_spill(c, p, r);
+            }
+            c->zf_valid = 0;
+            break;
+        case OP_IN:
+            // EOF 時儲存格保持不變，記憶體中必須是最新的值
+            r = cache_find(c, op->offset);
+            if (r >= 0) {
+                cache_spill(c, p, r);
+                c->used[r] = 0;
+            }
+            c->zf_valid = 0;
+            break;
+        default:
+            // 區塊結束：全部寫回並清空
+            for (r = 0; r < CACHE_REGS; r++) {
+                if (c->used[r]) {
+                    cache_spill(c, p, r);
+                    c->used[r] = 0;
+                }
+            }
+            if (op->type == OP_JZ || op->type == OP_JNZ) {
+                // 兩個括號之後（包含跳躍目標）ZF 都反映目前儲存格是否為 0
+                p->test = !c->zf_valid || c->zf_offset != 0;
+                c->zf_valid = 1;
+                c->zf_offset = 0;
+            } else if (op->type == OP_MOVE && c->zf_valid && c->zf_offset == op->arg && i + 1 < prog->size &&
+                       (prog->ops[i + 1].type == OP_JZ || prog->ops[i + 1].type == OP_JNZ)) {
+                p->lea = 1;
+                c->zf_offset = 0;
             } else {
-                printf("loop_scan_left_%lu:\n", start_pos);
-                puts("    cmpb $0, (%r12)");
-                printf("    je loop_scan_left_%lu_end\n", start_pos);
-                printf("    subq $%d, %%r12\n", step);
-                printf("    jmp loop_scan_left_%lu\n", start_pos);
-                printf("loop_scan_left_%lu_end:\n", start_pos);
+                c->zf_valid = 0;
             }
-            return pos - start_pos;
-        }
+            break;
     }
-    
-    return 0; // 無法展開
 }
 
-void compile(const char * const text_body){
-    int num_brackets=0;
-    int matching_brackets=0;
-    struct stack stack={.size=0,.items={0}};
+#include "elf_x86_64.h"
 
+// 將 IR（已由 bf_ir.h 做完指令合併、死代碼消除、迴圈辨識、位移折疊）翻譯為 x86-64 組語
+void compile(const struct program *prog, int output_buffer, size_t tape_size){
+    cell_bytes = prog->cell_bits / 8;
     // 使用 64 位元系統調用，不依賴 C 庫
     // 暫存器分配優化：
     // %r12 = 數據指標（指向當前記憶體位置）
     // %r13 = 常數 1（用於 sys_write, stdout, 長度）
     // %r14 = 常數 0（用於 sys_read, stdin）
+    // %eax / %ecx = 線性迴圈的計數值與乘積（64 位元儲存格為 %rax / %rcx）
+    // %xmm0 / %xmm1 = 掃描迴圈的比較區塊與全 0 向量（8 位元儲存格）
+    // %r15 / %rbx = 輸出緩衝的寫入位置與結尾（有緩衝時）
+    // %rbp = 輸入游標，input_end 為可讀範圍結尾（有 `,` 時）
     const char * const prologue=
         ".section .note.GNU-stack,\"\",%progbits\n"
-        ".section .data\n"
-        "memory: .skip 30000\n"          // 靜態分配記憶體
         ".section .text\n"
         ".global _start\n"
         "_start:\n"
-        "    leaq memory(%rip), %r12\n"  // r12 指向記憶體起始（使用 RIP-relative 尋址）
         "    movq $1, %r13\n"            // r13 = 1（常數暫存器）
         "    movq $0, %r14\n";           // r14 = 0（常數暫存器）
-    puts(prologue);
+    out_puts(prologue);
 
-    for(unsigned long i=0;text_body[i]!='\0';++i){
-        // 指令合併優化：計算連續相同指令的數量
-        int count = 1;
-        char current = text_body[i];
-        
-        // 只對 +, -, >, < 進行合併優化
-        if (current == '+' || current == '-' || current == '>' || current == '<') {
-            while (text_body[i+1] == current) {
-                count++;
-                i++;
-            }
+    // 紙帶：mmap 一塊 PROT_NONE 區域，只把中間 tape_size 格改為可讀寫，前後各留 TAPE_GUARD 的保護區；
+    // 頁面在第一次寫入時才配置，初始全為 0。越界存取由 segv_handler 回報位置，不需要逐次比較邊界
+    // 以下 tape_size 為位元組數，訊息中的紙帶大小換算回格數
+    tape_size = (tape_size * cell_bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    out_printf(".section .bss\n"
+           "tape_base: .skip 8\n"
+           "scan_lo: .skip 8\n"              // SSE2 向左掃描可整塊載入的最低位置（紙帶起點 + 15）
+           "scan_hi: .skip 8\n"              // SSE2 向右掃描可整塊載入的最高位置（紙帶結尾 - 16）
+           "segv_digits: .skip 24\n"
+           ".section .data\n"
+           "segv_action:\n"                  // 核心的 struct sigaction
+           "    .quad segv_handler\n"
+           "    .quad 0x04000004\n"          // SA_SIGINFO | SA_RESTORER
+           "    .quad segv_restorer\n"
+           "    .quad 0\n"
+           "segv_msg: .ascii \"tape overflow: cell \"\n"
+           "segv_msg_end:\n"
+           "segv_suffix: .ascii \" is outside the tape [0, %zu)\\n\"\n"
+           "segv_suffix_end:\n"
+           "tape_error: .ascii \"unable to allocate the tape\\n\"\n"
+           "tape_error_end:\n"
+           ".section .text\n", tape_size / cell_bytes);
+    out_printf("    movq $9, %%rax\n"              // sys_mmap(NULL, total, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0)
+           "    xorl %%edi, %%edi\n"
+           "    movabsq $%zu, %%rsi\n"
+           "    xorl %%edx, %%edx\n"
+           "    movq $0x4022, %%r10\n"
+           "    movq $-1, %%r8\n"
+           "    xorl %%r9d, %%r9d\n"
+           "    syscall\n"
+           "    cmpq $-4096, %%rax\n"
+           "    ja tape_alloc_failed\n"
+           "    leaq %d(%%rax), %%r12\n"        // r12 指向第 0 格
+           "    movq $10, %%rax\n"             // sys_mprotect(r12, tape_size, PROT_READ|PROT_WRITE)
+           "    movq %%r12, %%rdi\n"
+           "    movabsq $%zu, %%rsi\n"
+           "    movq $3, %%rdx\n"
+           "    syscall\n"
+           "    testq %%rax, %%rax\n"
+           "    jne tape_alloc_failed\n"
+           "    movq %%r12, tape_base(%%rip)\n"
+           "    leaq 15(%%r12), %%rax\n"
+           "    movq %%rax, scan_lo(%%rip)\n"
+           "    movabsq $%zu, %%rax\n"
+           "    addq %%r12, %%rax\n"
+           "    movq %%rax, scan_hi(%%rip)\n"
+           "    movq $13, %%rax\n"             // sys_rt_sigaction(SIGSEGV, &segv_action, NULL, 8)
+           "    movq $11, %%rdi\n"
+           "    leaq segv_action(%%rip), %%rsi\n"
+           "    xorl %%edx, %%edx\n"
+           "    movq $8, %%r10\n"
+           "    syscall\n",
+           tape_size + 2 * (size_t)TAPE_GUARD, TAPE_GUARD, tape_size, tape_size - 16);
+    if (output_buffer > 0) {
+        // 輸出緩衝：`.` 只寫進 outbuf，滿了、`,` 之前與結束時才呼叫 flush_output
+        out_printf(".section .bss\n"
+               "outbuf: .skip %d\n"
+               "outbuf_end:\n"
+               ".section .text\n", output_buffer);
+        out_puts("    leaq outbuf(%rip), %r15");
+        out_puts("    leaq outbuf_end(%rip), %rbx");
+    }
+    int input = uses_input(prog);
+    if (input) {
+        // 輸入：stdin 為一般檔案時 mmap 整個檔案，`,` 只是遞增 %rbp；
+        // 否則（pipe、tty）由 fill_input 以 sys_read 一次讀入一個區塊
+        out_printf(".section .bss\n"
+               "inbuf: .skip %d\n"
+               "input_end: .skip 8\n"
+               "input_mapped: .skip 1\n"
+               "statbuf: .skip 144\n"
+               ".section .text\n", INPUT_BUFFER_SIZE);
+        const char * const input_setup=
+            "    movq $5, %rax\n"               // sys_fstat(0, &statbuf)
+            "    movq %r14, %rdi\n"
+            "    leaq statbuf(%rip), %rsi\n"
+            "    syscall\n"
+            "    testq %rax, %rax\n"
+            "    jne input_setup_block\n"
+            "    movl statbuf+24(%rip), %eax\n" // st_mode
+            "    andl $0xf000, %eax\n"
+            "    cmpl $0x8000, %eax\n"          // S_ISREG
+            "    jne input_setup_block\n"
+            "    movq $8, %rax\n"               // sys_lseek(0, 0, SEEK_CUR)：目前的檔案位置
+            "    movq %r14, %rdi\n"
+            "    movq %r14, %rsi\n"
+            "    movq %r13, %rdx\n"
+            "    syscall\n"
+            "    movq %rax, %rbp\n"
+            "    movq statbuf+48(%rip), %rsi\n" // st_size
+            "    cmpq %rsi, %rbp\n"             // 位置錯誤（負值）或已讀完都改用區塊讀取
+            "    jae input_setup_block\n"
+            "    movq $9, %rax\n"               // sys_mmap(NULL, size, PROT_READ, MAP_PRIVATE, 0, 0)
+            "    xorl %edi, %edi\n"
+            "    movq %r13, %rdx\n"
+            "    movq $2, %r10\n"
+            "    movq %r14, %r8\n"
+            "    movq %r14, %r9\n"
+            "    syscall\n"
+            "    cmpq $-4096, %rax\n"
+            "    ja input_setup_block\n"
+            "    addq %rax, %rsi\n"
+            "    movq %rsi, input_end(%rip)\n"
+            "    addq %rax, %rbp\n"
+            "    movb $1, input_mapped(%rip)\n"
+            "    jmp input_setup_done\n"
+            "input_setup_block:\n"
+            "    leaq inbuf(%rip), %rbp\n"
+            "    movq %rbp, input_end(%rip)\n"
+            "input_setup_done:";
+        out_puts(input_setup);
+    }
+
+    struct cell_cache cache = {{0}, {0}, {0}, {0}, 0, 0, output_buffer > 0};
+    for (int i = 0; i < prog->size; i++) {
+        const struct op *op = &prog->ops[i];
+        struct cell_plan plan;
+        cache_plan(&cache, prog, i, &plan);
+        for (int s = 0; s < plan.stores; s++) {
+            out_printf("    mov%c %s, %s\n", sfx(), cache_reg_name(plan.store_reg[s], cell_bytes), cell(plan.store_offset[s]));
         }
-        
-        switch (current){
-            case '>':
-                if (count == 1) {
-                    puts("    incq %r12");
-                } else {
-                    printf("    addq $%d, %%r12\n", count);
+        switch (op->type) {
+            case OP_ADD:
+                {
+                    // 以儲存格寬度取模，負數改寫成減法；快取中的儲存格直接在暫存器上運算
+                    long long k = cell_value(op->arg, prog->cell_bits);
+                    if (plan.load) {
+                        cache_fill(plan.reg, op->offset);
+                    }
+                    const char *target = plan.reg >= 0 ? cache_reg_name(plan.reg, cell_bytes) : cell(op->offset);
+                    if (k == 1) {
+                        out_printf("    inc%c %s\n", sfx(), target);
+                    } else if (k == -1) {
+                        out_printf("    dec%c %s\n", sfx(), target);
+                    } else if (k > 0) {
+                        out_printf("    add%c $%lld, %s\n", sfx(), k, target);
+                    } else {
+                        out_printf("    sub%c $%lld, %s\n", sfx(), -k, target);
+                    }
                 }
                 break;
-            case '<':
-                if (count == 1) {
-                    puts("    decq %r12");
-                } else {
-                    printf("    subq $%d, %%r12\n", count);
+            case OP_MOVE:
+                {
+                    int delta = op->arg * cell_bytes;
+                    if (plan.lea) {
+                        out_printf("    leaq %d(%%r12), %%r12\n", delta);
+                    } else if (delta == 1) {
+                        out_puts("    incq %r12");
+                    } else if (delta == -1) {
+                        out_puts("    decq %r12");
+                    } else if (delta > 0) {
+                        out_printf("    addq $%d, %%r12\n", delta);
+                    } else {
+                        out_printf("    subq $%d, %%r12\n", -delta);
+                    }
                 }
                 break;
-            case '+':
-                if (count == 1) {
-                    puts("    incb (%r12)");
-                } else {
-                    printf("    addb $%d, (%%r12)\n", count);
+            case OP_OUT:
+                if (output_buffer > 0) {
+                    if (plan.reg < 0) {
+                        out_printf("    movb %s, %%al\n", cell(op->offset));
+                    } else {
+                        if (plan.load) {
+                            cache_fill(plan.reg, op->offset);
+                        }
+                        out_printf("    movl %s, %%eax\n", cache_reg_name(plan.reg, 4));
+                    }
+                    out_puts("    movb %al, (%r15)");
+                    out_puts("    incq %r15");
+                    out_puts("    cmpq %rbx, %r15");
+                    out_printf("    jne out_%d_done\n", i);
+                    out_puts("    call flush_output");
+                    out_printf("out_%d_done:\n", i);
+                    break;
                 }
+                // 使用 sys_write 系統調用 (64-bit)
+                // 利用暫存器分配優化：r13 = 1（sys_write, stdout, 長度）
+                out_puts("    movq %r13, %rax");     // sys_write = 1（從 r13）
+                out_puts("    movq %r13, %rdi");     // stdout = 1（從 r13）
+                out_printf("    leaq %s, %%rsi\n", cell(op->offset)); // 指向字元
+                out_puts("    movq %r13, %rdx");     // 長度 = 1（從 r13）
+                out_puts("    syscall");
                 break;
-            case '-':
-                if (count == 1) {
-                    puts("    decb (%r12)");
-                } else {
-                    printf("    subb $%d, (%%r12)\n", count);
+            case OP_IN:
+                // 從輸入緩衝取一個位元組；讀完時呼叫 fill_input，EOF 時儲存格保持不變
+                out_puts("    cmpq input_end(%rip), %rbp");
+                out_printf("    jb in_%d_load\n", i);
+                if (output_buffer > 0) {
+                    out_puts("    call flush_output");   // 可能等待輸入前先送出提示文字
                 }
+                out_puts("    call fill_input");
+                out_puts("    testq %rax, %rax");
+                out_printf("    jle in_%d_done\n", i);
+                out_printf("in_%d_load:\n", i);
+                out_puts("    movzbl (%rbp), %eax");
+                out_puts("    incq %rbp");
+                out_printf("    mov%c %s, %s\n", sfx(), reg_a(), cell(op->offset));
+                out_printf("in_%d_done:\n", i);
                 break;
-            case '.':
-                // 使用 sys_write 系統調用 (64-bit)
-                // 利用暫存器分配優化：r13 = 1（sys_write, stdout, 長度）
-                puts("    movq %r13, %rax");     // sys_write = 1（從 r13）
-                puts("    movq %r13, %rdi");     // stdout = 1（從 r13）
-                puts("    movq %r12, %rsi");     // 指向字元
-                puts("    movq %r13, %rdx");     // 長度 = 1（從 r13）
-                puts("    syscall");
+            case OP_JZ:
+                // 以 [ 在 IR 中的位置作為迴圈編號；前一個加減已設定 ZF 時不再 cmp
+                if (plan.test) {
+                    out_printf("    cmp%c $0, (%%r12)\n", sfx());
+                }
+                out_printf("    je bracket_%d_end\n", i);
+                out_printf("bracket_%d_start:\n", i);
                 break;
-            case ',':
-                // 使用 sys_read 系統調用 (64-bit)
-                // 利用暫存器分配優化：r14 = 0（sys_read, stdin），r13 = 1（長度）
-                puts("    movq %r14, %rax");     // sys_read = 0（從 r14）
-                puts("    movq %r14, %rdi");     // stdin = 0（從 r14）
-                puts("    movq %r12, %rsi");     // 指向字元
-                puts("    movq %r13, %rdx");     // 長度 = 1（從 r13）
-                puts("    syscall");
+            case OP_JNZ:
+                if (plan.test) {
+                    out_printf("    cmp%c $0, (%%r12)\n", sfx());
+                }
+                out_printf("    jne bracket_%d_start\n", op->arg);
+                out_printf("bracket_%d_end:\n", op->arg);
                 break;
-            case '[':
-                {
-                    // 嘗試迴圈展開優化
-                    int skipped = try_unroll_loop_x86_64(text_body, i);
-                    if (skipped > 0) {
-                        // 迴圈已展開，跳過整個迴圈
-                        i += skipped - 1; // -1 因為 for 迴圈會 ++i
-                        break;
+            case OP_SCAN:
+                if (cell_bytes == 1 && op->arg >= -16 && op->arg <= 16) {
+                    // [>]、[<<] 等掃描迴圈：SSE2 一次比較 16 格，遮罩只保留步長位置
+                    // 向右時區塊為 [p, p+15]，向左時為 [p-15, p]，每次前進整數個步長
+                    int step = op->arg > 0 ? op->arg : -op->arg;
+                    int advance = (15 / step + 1) * step;
+                    unsigned mask = 0;
+                    for (int k = 0; k < 16; k += step) {
+                        mask |= 1u << (op->arg > 0 ? k : 15 - k);
                     }
-                    
-                    // 無法展開，使用正常迴圈生成
-                    if (stack_push(&stack,num_brackets)==0){
-                        puts  ("    cmpb $0, (%r12)");
-                        printf("    je bracket_%d_end\n", num_brackets);
-                        printf("bracket_%d_start:\n", num_brackets++);
+                    const char *dir = op->arg > 0 ? "right" : "left";
+                    out_puts("    cmpb $0, (%r12)");
+                    out_printf("    je loop_scan_%s_%d_end\n", dir, i);
+                    out_puts("    pxor %xmm1, %xmm1");
+                    out_printf("loop_scan_%s_%d:\n", dir, i);
+                    // 區塊會超出紙帶時改為逐格掃描，避免整塊載入碰到保護頁
+                    if (op->arg > 0) {
+                        out_puts("    cmpq scan_hi(%rip), %r12");
+                        out_printf("    ja loop_scan_%s_%d_tail\n", dir, i);
                     } else {
-                        err("out of stack space");
+                        out_puts("    cmpq scan_lo(%rip), %r12");
+                        out_printf("    jb loop_scan_%s_%d_tail\n", dir, i);
                     }
+                    out_printf("    movdqu %s, %%xmm0\n", op->arg > 0 ? "(%r12)" : "-15(%r12)");
+                    out_puts("    pcmpeqb %xmm1, %xmm0");
+                    out_puts("    pmovmskb %xmm0, %eax");
+                    out_printf("    andl $0x%x, %%eax\n", mask);
+                    out_printf("    jnz loop_scan_%s_%d_found\n", dir, i);
+                    out_printf("    %s $%d, %%r12\n", op->arg > 0 ? "addq" : "subq", advance);
+                    out_printf("    jmp loop_scan_%s_%d\n", dir, i);
+                    out_printf("loop_scan_%s_%d_found:\n", dir, i);
+                    if (op->arg > 0) {
+                        out_puts("    bsfl %eax, %eax");
+                        out_puts("    addq %rax, %r12");
+                    } else {
+                        out_puts("    bsrl %eax, %eax");
+                        out_puts("    leaq -15(%r12,%rax), %r12");
+                    }
+                    out_printf("    jmp loop_scan_%s_%d_end\n", dir, i);
+                    out_printf("loop_scan_%s_%d_tail:\n", dir, i);
+                    out_puts("    cmpb $0, (%r12)");
+                    out_printf("    je loop_scan_%s_%d_end\n", dir, i);
+                    out_printf("    %s $%d, %%r12\n", op->arg > 0 ? "addq" : "subq", step);
+                    out_printf("    jmp loop_scan_%s_%d_tail\n", dir, i);
+                    out_printf("loop_scan_%s_%d_end:\n", dir, i);
+                } else {
+                    // 步長超過一個 SSE2 區塊或儲存格大於 8 位元，逐格掃描
+                    const char *dir = op->arg > 0 ? "right" : "left";
+                    out_printf("loop_scan_%s_%d:\n", dir, i);
+                    out_printf("    cmp%c $0, (%%r12)\n", sfx());
+                    out_printf("    je loop_scan_%s_%d_end\n", dir, i);
+                    if (op->arg > 0) {
+                        out_printf("    addq $%d, %%r12\n", op->arg * cell_bytes);
+                    } else {
+                        out_printf("    subq $%d, %%r12\n", -op->arg * cell_bytes);
+                    }
+                    out_printf("    jmp loop_scan_%s_%d\n", dir, i);
+                    out_printf("loop_scan_%s_%d_end:\n", dir, i);
                 }
                 break;
-            case ']':
-                if (stack_pop(&stack,&matching_brackets)==0){
-                    puts  ("    cmpb $0, (%r12)");
-                    printf("    jne bracket_%d_start\n", matching_brackets);
-                    printf("bracket_%d_end:\n", matching_brackets);
+            case OP_MUL:
+                // 線性迴圈：計數格為 0 時跳過，避免以偏移量存取到紙帶外
+                if (cell_bytes == 8) {
+                    out_printf("    movq %s, %%rax\n", cell(op->offset));
+                    out_puts("    testq %rax, %rax");
                 } else {
-                    err("stack underflow, unmatched");
+                    out_printf("    %s %s, %%eax\n", cell_bytes == 1 ? "movzbl" : cell_bytes == 2 ? "movzwl" : "movl", cell(op->offset));
+                    out_puts("    testl %eax, %eax");
+                }
+                out_printf("    je mul_%d_end\n", i);
+                for (int j = 1; j <= op->arg; j++) {
+                    const struct op *term = &op[j];
+                    if (term->arg == 1) {
+                        out_printf("    add%c %s, %s\n", sfx(), reg_a(), cell(term->offset));
+                    } else if (term->arg == -1) {
+                        out_printf("    sub%c %s, %s\n", sfx(), reg_a(), cell(term->offset));
+                    } else {
+                        if (cell_bytes == 8) {
+                            out_printf("    imulq $%d, %%rax, %%rcx\n", term->arg);
+                        } else {
+                            out_printf("    imull $%d, %%eax, %%ecx\n", term->arg);
+                        }
+                        out_printf("    add%c %s, %s\n", sfx(), reg_c(), cell(term->offset));
+                    }
                 }
+                out_printf("    mov%c $0, %s\n", sfx(), cell(op->offset));
+                out_printf("mul_%d_end:\n", i);
+                i += op->arg + 1;  // 已處理後面的 OP_MUL_ADD 與 OP_CLEAR
+                break;
+            case OP_MUL_ADD:
+                break;
+            case OP_CLEAR:
+                // 剛放進快取時也寫入記憶體，越界仍在原本的位置被攔截
+                if (plan.reg < 0 || plan.load) {
+                    out_printf("    mov%c $0, %s\n", sfx(), cell(op->offset));
+                }
+                if (plan.reg >= 0) {
+                    out_printf("    movl $0, %s\n", cache_reg_name(plan.reg, 4));
+                }
+                break;
+            case OP_END:
                 break;
         }
     }
 
+    if (output_buffer > 0) {
+        out_puts("    call flush_output");
+    }
     // 使用 sys_exit 退出 (64-bit)
     const char * const epilogue=
         "    movq $60, %rax\n"     // sys_exit (64-bit)
         "    xorq %rdi, %rdi\n"    // 退出碼 = 0
         "    syscall\n";
-    puts(epilogue);
+    out_puts(epilogue);
+
+    // 紙帶越界：先送出已緩衝的輸出，再以 "tape overflow: cell N ..." 回報位置並以狀態 1 結束
+    // %rsi = siginfo（si_addr 在位移 16），%rdx = ucontext（中斷時的 %r15 在位移 96）
+    out_puts("segv_handler:");
+    out_puts("    movq 16(%rsi), %r12");
+    out_puts("    subq tape_base(%rip), %r12");     // 越界的位元組位移
+    if (cell_bytes > 1) {
+        out_printf("    sarq $%d, %%r12\n", __builtin_ctz(cell_bytes));  // 換算成格數，負值向下取整
+    }
+    if (output_buffer > 0) {
+        out_puts("    movq 96(%rdx), %r15");
+        out_puts("    call flush_output");
+    }
+    const char * const segv_report=
+        "    movq $1, %rax\n"                    // sys_write(2, segv_msg)
+        "    movq $2, %rdi\n"
+        "    leaq segv_msg(%rip), %rsi\n"
+        "    movq $(segv_msg_end - segv_msg), %rdx\n"
+        "    syscall\n"
+        "    leaq segv_digits+24(%rip), %rsi\n"  // 由個位數往前寫十進位數字
+        "    movq %r12, %rax\n"
+        "    testq %rax, %rax\n"
+        "    jns segv_positive\n"
+        "    negq %rax\n"
+        "segv_positive:\n"
+        "    movq $10, %rcx\n"
+        "segv_digit:\n"
+        "    xorl %edx, %edx\n"
+        "    divq %rcx\n"
+        "    addb $48, %dl\n"
+        "    decq %rsi\n"
+        "    movb %dl, (%rsi)\n"
+        "    testq %rax, %rax\n"
+        "    jne segv_digit\n"
+        "    testq %r12, %r12\n"
+        "    jns segv_print\n"
+        "    decq %rsi\n"
+        "    movb $45, (%rsi)\n"                 // '-'
+        "segv_print:\n"
+        "    leaq segv_digits+24(%rip), %rdx\n"
+        "    subq %rsi, %rdx\n"
+        "    movq $1, %rax\n"
+        "    movq $2, %rdi\n"
+        "    syscall\n"
+        "    movq $1, %rax\n"                    // sys_write(2, segv_suffix)
+        "    movq $2, %rdi\n"
+        "    leaq segv_suffix(%rip), %rsi\n"
+        "    movq $(segv_suffix_end - segv_suffix), %rdx\n"
+        "    syscall\n"
+        "    movq $60, %rax\n"                   // sys_exit(1)
+        "    movq $1, %rdi\n"
+        "    syscall\n"
+        "segv_restorer:\n"                       // handler 不會返回，但 x86-64 核心要求 SA_RESTORER
+        "    movq $15, %rax\n"                   // sys_rt_sigreturn
+        "    syscall\n"
+        "tape_alloc_failed:\n"
+        "    movq $1, %rax\n"                    // sys_write(2, tape_error)
+        "    movq $2, %rdi\n"
+        "    leaq tape_error(%rip), %rsi\n"
+        "    movq $(tape_error_end - tape_error), %rdx\n"
+        "    syscall\n"
+        "    movq $60, %rax\n"                   // sys_exit(1)
+        "    movq $1, %rdi\n"
+        "    syscall\n";
+    out_puts(segv_report);
+
+    if (output_buffer > 0) {
+        // 寫出 [outbuf, %r15)，處理部分寫入；寫入失敗時丟棄剩餘內容
+        // 會覆寫 %rax、%rcx、%rdx、%rsi、%rdi、%r11
+        const char * const flush_output=
+            "flush_output:\n"
+            "    leaq outbuf(%rip), %rsi\n"
+            "    movq %r15, %rdx\n"
+            "    subq %rsi, %rdx\n"           // 長度 = 寫入位置 - 起點
+            "flush_output_loop:\n"
+            "    testq %rdx, %rdx\n"
+            "    jle flush_output_done\n"
+            "    movq %r13, %rax\n"           // sys_write = 1（從 r13）
+            "    movq %r13, %rdi\n"           // stdout = 1（從 r13）
+            "    syscall\n"
+            "    testq %rax, %rax\n"
+            "    jle flush_output_done\n"
+            "    addq %rax, %rsi\n"
+            "    subq %rax, %rdx\n"
+            "    jmp flush_output_loop\n"
+            "flush_output_done:\n"
+            "    leaq outbuf(%rip), %r15\n"
+            "    ret\n";
+        out_puts(flush_output);
+    }
+
+    if (input) {
+        // 重新填入輸入緩衝，回傳讀到的位元組數（<= 0 為 EOF 或錯誤）；mmap 的 stdin 讀完即為 EOF
+        // 會覆寫 %rax、%rcx、%rdx、%rsi、%rdi、%r11
+        out_printf("fill_input:\n"
+               "    cmpb $0, input_mapped(%%rip)\n"
+               "    jne fill_input_eof\n"
+               "    movq %%r14, %%rax\n"           // sys_read = 0（從 r14）
+               "    movq %%r14, %%rdi\n"           // stdin = 0（從 r14）
+               "    leaq inbuf(%%rip), %%rsi\n"
+               "    movq $%d, %%rdx\n"
+               "    syscall\n"
+               "    testq %%rax, %%rax\n"
+               "    jle fill_input_done\n"
+               "    leaq inbuf(%%rip), %%rbp\n"
+               "    leaq (%%rbp,%%rax), %%rdx\n"
+               "    movq %%rdx, input_end(%%rip)\n"
+               "fill_input_done:\n"
+               "    ret\n"
+               "fill_input_eof:\n"
+               "    xorl %%eax, %%eax\n"
+               "    ret\n", INPUT_BUFFER_SIZE);
+    }
 }
 
 int main(int argc,char *argv[]){
-    if (argc!=2){
-        err("Usage: compiler_x86_64 inputfile");
+    unsigned passes_mask = PASS_ALL;
+    int output_buffer = OUTPUT_BUFFER_DEFAULT;
+    size_t tape_size = TAPE_SIZE_DEFAULT;
+    int cell_bits = 8;
+    const char *filepath = NULL;
+    const char *elf_path = NULL;
+    int use_cache = 0;
+    int cache_stats = 0;
+    const char *cache_dir = NULL;
+    size_t cache_size = BF_CACHE_SIZE_DEFAULT;
+    for (int i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc){
+            passes_mask = parse_pass_list(argv[++i]);
+        }else if (strcmp(argv[i], "--unbuffered") == 0){
+            output_buffer = 0;
+        }else if (strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc){
+            output_buffer = atoi(argv[++i]);
+            if (output_buffer < 0) {
+                output_buffer = 0;
+            }
+        }else if (strcmp(argv[i], "--tape-size") == 0 && i + 1 < argc){
+            tape_size = parse_size(argv[++i]);
+        }else if (strcmp(argv[i], "--cell-bits") == 0 && i + 1 < argc){
+            cell_bits = atoi(argv[++i]);
+            if (!valid_cell_bits(cell_bits)) {
+                err("--cell-bits must be 8, 16, 32 or 64");
+            }
+        }else if (strcmp(argv[i], "--emit-elf") == 0 && i + 1 < argc){
+            elf_path = argv[++i];
+        }else if (strcmp(argv[i], "--cache") == 0){
+            use_cache = 1;
+        }else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc){
+            use_cache = 1;
+            cache_dir = argv[++i];
+        }else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc){
+            use_cache = 1;
+            cache_size = parse_size(argv[++i]);
+        }else if (strcmp(argv[i], "--cache-stats") == 0){
+            use_cache = 1;
+            cache_stats = 1;
+        }else if (filepath == NULL){
+            filepath = argv[i];
+        }else{
+            filepath = NULL;
+            break;
+        }
+    }
+    if (filepath == NULL){
+        err("Usage: compiler_x86_64 [--passes LIST] [--unbuffered] [--output-buffer N] [--tape-size N] [--cell-bits 8|16|32|64] [--emit-elf FILE] [--cache] [--cache-dir DIR] [--cache-size N] [--cache-stats] inputfile");
     }
-    char *text_body=read_file(argv[1]);
-    if (text_body==NULL){
+    struct source src;
+    if (source_open(&src, filepath) != 0){
         err("Unable to read program text file");
     }
 
-    // 死代碼消除優化
-    char *optimized_body = eliminate_dead_code(text_body);
-    free(text_body);
+    // --emit-elf 的結果是完整的可執行檔，可以放進編譯快取（--cache）：鍵包含影響產生內容的選項與建置時間，
+    // 命中時直接寫出快取的檔案，跳過整個前端與編碼。組語輸出還要經過組譯器，不使用快取；pipe 進來的程式也不使用
+    struct cache cache;
+    struct cache *cachep = NULL;
+    struct cache_key key = {0, 0};
+    if (use_cache && elf_path != NULL && src.text != NULL && cache_open(&cache, cache_dir, cache_size) == 0){
+        char options[160];
+        snprintf(options, sizeof(options), "passes=%x cell_bits=%d tape_size=%zu output_buffer=%d build=%s %s",
+                 passes_mask, cell_bits, tape_size, output_buffer, __DATE__, __TIME__);
+        cachep = &cache;
+        key = cache_key(src.text, src.size, "x86_64_elf", options);
+        size_t size;
+        void *file = cache_load(cachep, key, "elf", &size);
+        if (file != NULL){
+            source_close(&src);
+            elf_write(elf_path, file, size);
+            free(file);
+            cache_close(cachep, cache_stats ? stderr : NULL);
+            return 0;
+        }
+    }
+
+    struct program prog = compile_source(&src, passes_mask, cell_bits);
+    source_close(&src);
 
-    compile(optimized_body);
+    // --emit-elf：直接寫出可執行檔；否則輸出組語到 stdout
+    if (elf_path != NULL){
+        size_t size;
+        void *file = elf_image(&prog, output_buffer, tape_size, &size);
+        elf_write(elf_path, file, size);
+        if (cachep != NULL){
+            cache_store(cachep, key, "elf", file, size);
+        }
+        free(file);
+    }else{
+        compile(&prog, output_buffer, tape_size);
+        out_flush();
+    }
+    if (cachep != NULL){
+        cache_close(cachep, cache_stats ? stderr : NULL);
+    }
 
-    free(optimized_body);
+    free_program(&prog);
     return 0;
 }
-
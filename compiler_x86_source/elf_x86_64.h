@@ -0,0 +1,703 @@
+// 直接產生 ELF64 可執行檔（compiler_x86_64 --emit-elf FILE）：與 compile() 相同的指令選擇與執行期常式，
+// 但由編譯器自己編碼成機器碼（bf_x86_64.h），不需要 as / ld，也不需要另外啟動兩個行程。
+// 檔案只有 ELF 標頭與三個 program header，沒有 section header 與符號表：
+//   PT_LOAD（R+X）：從檔案開頭映射，包含標頭、機器碼與唯讀資料（sigaction、錯誤訊息）
+//   PT_LOAD（RW）：.bss，p_filesz 為 0，由核心配置清零的頁面；放 tape_base、掃描界線、輸出/輸入緩衝等狀態
+//   PT_GNU_STACK：不可執行的堆疊
+// 紙帶與組語版本相同，執行時以 mmap 配置並在前後留 PROT_NONE 保護區，不佔檔案空間。
+// 機器碼中參照 .bss 與後面才出現的常式（flush_output、fill_input 等）的 rel32 先佔位並記錄成 fixup，
+// 機器碼長度確定、.bss 位址排定後再一次回填；每個 op 內部的跳躍則與 JIT 相同，直接以 patch_rel32() 回填。
+#ifndef ELF_X86_64_H
+#define ELF_X86_64_H
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "../bf_x86_64.h"
+
+#define ELF_BASE 0x400000
+#define ELF_HEADERS_SIZE (sizeof(Elf64_Ehdr) + 3 * sizeof(Elf64_Phdr))
+
+// rel32 參照的目標：前半在機器碼中（值為機器碼內的位置），後半在 .bss 中（值為 .bss 內的位移）
+enum elf_symbol {
+    ELF_FLUSH_OUTPUT,
+    ELF_FILL_INPUT,
+    ELF_TAPE_ALLOC_FAILED,
+    ELF_SEGV_ACTION,
+    ELF_SEGV_MSG,
+    ELF_SEGV_SUFFIX,
+    ELF_TAPE_ERROR,
+    ELF_TEXT_SYMBOLS,
+    ELF_TAPE_BASE = ELF_TEXT_SYMBOLS,
+    ELF_SCAN_LO,
+    ELF_SCAN_HI,
+    ELF_SEGV_DIGITS,
+    ELF_INPUT_END,
+    ELF_INPUT_MAPPED,
+    ELF_STATBUF,
+    ELF_OUTBUF,
+    ELF_OUTBUF_END,
+    ELF_INBUF,
+    ELF_SYMBOL_COUNT,
+};
+
+struct elf_fixup {
+    size_t at;          // rel32 在機器碼中的位置
+    int symbol;         // enum elf_symbol
+    int addend;         // 目標位址的位移（statbuf+24 等）減去 rel32 之後還有的立即值位元組數
+};
+
+struct elf_image {
+    struct code_buffer code;
+    size_t symbols[ELF_SYMBOL_COUNT];
+    size_t bss_size;
+    struct elf_fixup *fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+};
+
+// 在目前位置記下機器碼內的符號
+static void elf_label(struct elf_image *img, enum elf_symbol symbol){
+    img->symbols[symbol] = img->code.size;
+}
+
+// rel32 佔位並記錄 fixup；trailing 為 rel32 之後同一指令還有的立即值位元組數
+static void elf_ref(struct elf_image *img, enum elf_symbol symbol, int offset, int trailing){
+    if (img->fixup_count == img->fixup_capacity){
+        img->fixup_capacity = img->fixup_capacity ? img->fixup_capacity * 2 : 64;
+        img->fixups = realloc(img->fixups, sizeof(struct elf_fixup) * img->fixup_capacity);
+        if (img->fixups == NULL){
+            err("memory allocation failed");
+        }
+    }
+    img->fixups[img->fixup_count++] = (struct elf_fixup){img->code.size, symbol, offset - trailing};
+    emit_i32(&img->code, 0);
+}
+
+// RIP 相對定址的指令：prefix 為 REX 與 opcode，reg 為 ModRM 的 reg 欄位（0-7）
+static void elf_rip(struct elf_image *img, const char *prefix, size_t n, int reg, enum elf_symbol symbol, int offset, int trailing){
+    emit_bytes(&img->code, prefix, n);
+    emit_u8(&img->code, (uint8_t)(0x05 | (reg << 3)));
+    elf_ref(img, symbol, offset, trailing);
+}
+
+// jcc / jmp / call rel32 到機器碼中的符號
+static void elf_jump(struct elf_image *img, const char *opcode, size_t n, enum elf_symbol symbol){
+    emit_bytes(&img->code, opcode, n);
+    elf_ref(img, symbol, 0, 0);
+}
+
+// jcc / jmp rel32 佔位，回傳 rel32 的位置，之後以 patch_rel32() 回填
+static size_t elf_forward(struct elf_image *img, const char *opcode, size_t n){
+    emit_bytes(&img->code, opcode, n);
+    size_t at = img->code.size;
+    emit_i32(&img->code, 0);
+    return at;
+}
+
+// jcc / jmp rel32 往回跳到已知位置
+static void elf_backward(struct elf_image *img, const char *opcode, size_t n, size_t target){
+    emit_bytes(&img->code, opcode, n);
+    emit_i32(&img->code, 0);
+    patch_rel32(&img->code, img->code.size - 4, target);
+}
+
+// movq $imm32, %reg（符號延伸）
+static void elf_mov_imm(struct elf_image *img, int reg, int32_t imm){
+    emit_u8(&img->code, reg >= 8 ? 0x49 : 0x48);
+    emit_u8(&img->code, 0xc7);
+    emit_u8(&img->code, (uint8_t)(0xc0 | (reg & 7)));
+    emit_i32(&img->code, imm);
+}
+
+// movabsq $imm64, %reg
+static void elf_mov_imm64(struct elf_image *img, int reg, uint64_t imm){
+    emit_u8(&img->code, reg >= 8 ? 0x49 : 0x48);
+    emit_u8(&img->code, (uint8_t)(0xb8 | (reg & 7)));
+    emit_u64(&img->code, imm);
+}
+
+// sys_write(2, msg, len)
+static void elf_write_stderr(struct elf_image *img, enum elf_symbol msg, size_t len){
+    elf_mov_imm(img, 0, 1);                                     // movq $1, %rax
+    elf_mov_imm(img, 7, 2);                                     // movq $2, %rdi
+    elf_rip(img, "\x48\x8d", 2, 6, msg, 0, 0);                  // leaq msg(%rip), %rsi
+    elf_mov_imm(img, 2, (int32_t)len);                          // movq $len, %rdx
+    emit_bytes(&img->code, "\x0f\x05", 2);                      // syscall
+}
+
+// sys_exit(1)
+static void elf_exit_1(struct elf_image *img){
+    elf_mov_imm(img, 0, 60);                                    // movq $60, %rax
+    elf_mov_imm(img, 7, 1);                                     // movq $1, %rdi
+    emit_bytes(&img->code, "\x0f\x05", 2);                      // syscall
+}
+
+// sub / add $imm32, %r12
+static void elf_move_r12(struct elf_image *img, int delta){
+    if (delta == 1){
+        emit_bytes(&img->code, "\x49\xff\xc4", 3);              // incq %r12
+    }else if (delta == -1){
+        emit_bytes(&img->code, "\x49\xff\xcc", 3);              // decq %r12
+    }else if (delta > 0){
+        emit_move_r12(&img->code, delta);                       // addq $delta, %r12
+    }else{
+        emit_bytes(&img->code, "\x49\x81\xec", 3);              // subq $-delta, %r12
+        emit_i32(&img->code, -delta);
+    }
+}
+
+// movzbl / movzwl / movl / movq disp(%r12), %rN（快取暫存器 %r8–%r10）
+static void elf_cache_fill(struct code_buffer *code, int bytes, int reg, int offset){
+    switch (bytes) {
+        case 1: emit_bytes(code, "\x45\x0f\xb6", 3); break;
+        case 2: emit_bytes(code, "\x45\x0f\xb7", 3); break;
+        case 4: emit_bytes(code, "\x45\x8b", 2); break;
+        default: emit_bytes(code, "\x4d\x8b", 2); break;
+    }
+    emit_r12_operand(code, reg, offset * bytes);
+}
+
+// 對快取暫存器做 inc / dec / add / sub：opcode8 / opcode 為 1 位元組與較寬的 opcode，field 為 ModRM 的 /digit
+static void elf_cache_arith(struct code_buffer *code, int bytes, uint8_t opcode8, uint8_t opcode, int field, int reg){
+    if (bytes == 2){
+        emit_u8(code, 0x66);
+    }
+    emit_u8(code, bytes == 8 ? 0x49 : 0x41);
+    emit_u8(code, bytes == 1 ? opcode8 : opcode);
+    emit_u8(code, (uint8_t)(0xc0 | field << 3 | reg));
+}
+
+static const char SEGV_MSG[] = "tape overflow: cell ";
+static const char TAPE_ERROR[] = "unable to allocate the tape\n";
+
+// 將 IR 編碼為完整的 ELF 可執行檔，回傳 malloc 的檔案內容與長度
+static void *elf_image(const struct program *prog, int output_buffer, size_t tape_size, size_t *size){
+    struct elf_image img;
+    memset(&img, 0, sizeof(img));
+    struct code_buffer *code = &img.code;
+    const int bytes = prog->cell_bits / 8;
+    tape_size = (tape_size * bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    int input = uses_input(prog);
+
+    // .bss 配置：狀態變數與緩衝區各自對齊 16 位元組，outbuf_end 緊接在 output_buffer 個位元組之後
+    size_t bss = 0;
+    const struct { enum elf_symbol symbol; size_t size; } bss_layout[] = {
+        {ELF_TAPE_BASE, 8}, {ELF_SCAN_LO, 8}, {ELF_SCAN_HI, 8}, {ELF_SEGV_DIGITS, 24},
+        {ELF_INPUT_END, 8}, {ELF_INPUT_MAPPED, 1}, {ELF_STATBUF, 144},
+        {ELF_INBUF, input ? INPUT_BUFFER_SIZE : 0}, {ELF_OUTBUF, (size_t)output_buffer},
+    };
+    for (size_t k = 0; k < sizeof(bss_layout) / sizeof(bss_layout[0]); k++){
+        img.symbols[bss_layout[k].symbol] = bss;
+        bss += (bss_layout[k].size + 15) & ~(size_t)15;
+    }
+    img.symbols[ELF_OUTBUF_END] = img.symbols[ELF_OUTBUF] + (size_t)output_buffer;
+    img.bss_size = bss;
+
+    // _start：%r13 = 1、%r14 = 0 的常數暫存器，其餘暫存器的用途與 compile() 相同
+    elf_mov_imm(&img, 13, 1);                                   // movq $1, %r13
+    elf_mov_imm(&img, 14, 0);                                   // movq $0, %r14
+
+    // 紙帶：mmap PROT_NONE 的整塊區域，再把中間的 tape_size 改為可讀寫
+    elf_mov_imm(&img, 0, 9);                                    // movq $9, %rax
+    emit_bytes(code, "\x31\xff", 2);                            // xorl %edi, %edi
+    elf_mov_imm64(&img, 6, tape_size + 2 * (size_t)TAPE_GUARD); // movabsq $total, %rsi
+    emit_bytes(code, "\x31\xd2", 2);                            // xorl %edx, %edx
+    elf_mov_imm(&img, 10, 0x4022);                              // movq $0x4022, %r10
+    elf_mov_imm(&img, 8, -1);                                   // movq $-1, %r8
+    emit_bytes(code, "\x45\x31\xc9", 3);                        // xorl %r9d, %r9d
+    emit_bytes(code, "\x0f\x05", 2);                            // syscall
+    emit_bytes(code, "\x48\x3d", 2);                            // cmpq $-4096, %rax
+    emit_i32(code, -4096);
+    elf_jump(&img, "\x0f\x87", 2, ELF_TAPE_ALLOC_FAILED);       // ja tape_alloc_failed
+    emit_bytes(code, "\x4c\x8d\xa0", 3);                        // leaq TAPE_GUARD(%rax), %r12
+    emit_i32(code, TAPE_GUARD);
+    elf_mov_imm(&img, 0, 10);                                   // movq $10, %rax
+    emit_bytes(code, "\x4c\x89\xe7", 3);                        // movq %r12, %rdi
+    elf_mov_imm64(&img, 6, tape_size);                          // movabsq $tape_size, %rsi
+    elf_mov_imm(&img, 2, 3);                                    // movq $3, %rdx
+    emit_bytes(code, "\x0f\x05", 2);                            // syscall
+    emit_bytes(code, "\x48\x85\xc0", 3);                        // testq %rax, %rax
+    elf_jump(&img, "\x0f\x85", 2, ELF_TAPE_ALLOC_FAILED);       // jne tape_alloc_failed
+    elf_rip(&img, "\x4c\x89", 2, 4, ELF_TAPE_BASE, 0, 0);       // movq %r12, tape_base(%rip)
+    emit_bytes(code, "\x49\x8d\x44\x24\x0f", 5);                // leaq 15(%r12), %rax
+    elf_rip(&img, "\x48\x89", 2, 0, ELF_SCAN_LO, 0, 0);         // movq %rax, scan_lo(%rip)
+    elf_mov_imm64(&img, 0, tape_size - 16);                     // movabsq $(tape_size - 16), %rax
+    emit_bytes(code, "\x4c\x01\xe0", 3);                        // addq %r12, %rax
+    elf_rip(&img, "\x48\x89", 2, 0, ELF_SCAN_HI, 0, 0);         // movq %rax, scan_hi(%rip)
+    elf_mov_imm(&img, 0, 13);                                   // movq $13, %rax
+    elf_mov_imm(&img, 7, 11);                                   // movq $11, %rdi
+    elf_rip(&img, "\x48\x8d", 2, 6, ELF_SEGV_ACTION, 0, 0);     // leaq segv_action(%rip), %rsi
+    emit_bytes(code, "\x31\xd2", 2);                            // xorl %edx, %edx
+    elf_mov_imm(&img, 10, 8);                                   // movq $8, %r10
+    emit_bytes(code, "\x0f\x05", 2);                            // syscall
+
+    if (output_buffer > 0){
+        elf_rip(&img, "\x4c\x8d", 2, 7, ELF_OUTBUF, 0, 0);      // leaq outbuf(%rip), %r15
+        elf_rip(&img, "\x48\x8d", 2, 3, ELF_OUTBUF_END, 0, 0);  // leaq outbuf_end(%rip), %rbx
+    }
+    if (input){
+        // stdin 為一般檔案時 mmap 整個檔案，否則以 fill_input 分段讀取
+        elf_mov_imm(&img, 0, 5);                                // movq $5, %rax
+        emit_bytes(code, "\x4c\x89\xf7", 3);                    // movq %r14, %rdi
+        elf_rip(&img, "\x48\x8d", 2, 6, ELF_STATBUF, 0, 0);     // leaq statbuf(%rip), %rsi
+        emit_bytes(code, "\x0f\x05", 2);                        // syscall
+        emit_bytes(code, "\x48\x85\xc0", 3);                    // testq %rax, %rax
+        size_t block[3];
+        block[0] = elf_forward(&img, "\x0f\x85", 2);            // jne input_setup_block
+        elf_rip(&img, "\x8b", 1, 0, ELF_STATBUF, 24, 0);        // movl statbuf+24(%rip), %eax
+        emit_u8(code, 0x25);                                    // andl $0xf000, %eax
+        emit_i32(code, 0xf000);
+        emit_u8(code, 0x3d);                                    // cmpl $0x8000, %eax
+        emit_i32(code, 0x8000);
+        block[1] = elf_forward(&img, "\x0f\x85", 2);            // jne input_setup_block
+        elf_mov_imm(&img, 0, 8);                                // movq $8, %rax
+        emit_bytes(code, "\x4c\x89\xf7", 3);                    // movq %r14, %rdi
+        emit_bytes(code, "\x4c\x89\xf6", 3);                    // movq %r14, %rsi
+        emit_bytes(code, "\x4c\x89\xea", 3);                    // movq %r13, %rdx
+        emit_bytes(code, "\x0f\x05", 2);                        // syscall
+        emit_bytes(code, "\x48\x89\xc5", 3);                    // movq %rax, %rbp
+        elf_rip(&img, "\x48\x8b", 2, 6, ELF_STATBUF, 48, 0);    // movq statbuf+48(%rip), %rsi
+        emit_bytes(code, "\x48\x39\xf5", 3);                    // cmpq %rsi, %rbp
+        block[2] = elf_forward(&img, "\x0f\x83", 2);            // jae input_setup_block
+        elf_mov_imm(&img, 0, 9);                                // movq $9, %rax
+        emit_bytes(code, "\x31\xff", 2);                        // xorl %edi, %edi
+        emit_bytes(code, "\x4c\x89\xea", 3);                    // movq %r13, %rdx
+        elf_mov_imm(&img, 10, 2);                               // movq $2, %r10
+        emit_bytes(code, "\x4d\x89\xf0", 3);                    // movq %r14, %r8
+        emit_bytes(code, "\x4d\x89\xf1", 3);                    // movq %r14, %r9
+        emit_bytes(code, "\x0f\x05", 2);                        // syscall
+        emit_bytes(code, "\x48\x3d", 2);                        // cmpq $-4096, %rax
+        emit_i32(code, -4096);
+        size_t mapped_failed = elf_forward(&img, "\x0f\x87", 2);  // ja input_setup_block
+        emit_bytes(code, "\x48\x01\xc6", 3);                    // addq %rax, %rsi
+        elf_rip(&img, "\x48\x89", 2, 6, ELF_INPUT_END, 0, 0);   // movq %rsi, input_end(%rip)
+        emit_bytes(code, "\x48\x01\xc5", 3);                    // addq %rax, %rbp
+        elf_rip(&img, "\xc6", 1, 0, ELF_INPUT_MAPPED, 0, 1);    // movb $1, input_mapped(%rip)
+        emit_u8(code, 1);
+        size_t done = elf_forward(&img, "\xe9", 1);             // jmp input_setup_done
+        for (int k = 0; k < 3; k++){
+            patch_rel32(code, block[k], code->size);
+        }
+        patch_rel32(code, mapped_failed, code->size);
+        elf_rip(&img, "\x48\x8d", 2, 5, ELF_INBUF, 0, 0);       // leaq inbuf(%rip), %rbp
+        elf_rip(&img, "\x48\x89", 2, 5, ELF_INPUT_END, 0, 0);   // movq %rbp, input_end(%rip)
+        patch_rel32(code, done, code->size);
+    }
+
+    // 每個 [ 的 je rel32 位置，] 時回填
+    size_t *patch = malloc(sizeof(size_t) * (prog->size + 1));
+    if (patch == NULL){
+        err("memory allocation failed");
+    }
+    struct cell_cache cache = {{0}, {0}, {0}, {0}, 0, 0, output_buffer > 0};
+    for (int i = 0; i < prog->size; i++){
+        const struct op *op = &prog->ops[i];
+        struct cell_plan plan;
+        cache_plan(&cache, prog, i, &plan);
+        for (int s = 0; s < plan.stores; s++){
+            emit_cell_op(code, bytes, 0x88, 0x89, 8 + plan.store_reg[s], plan.store_offset[s]);  // mov %rN, disp(%r12)
+        }
+        switch (op->type) {
+            case OP_ADD:
+                {
+                    long long k = cell_value(op->arg, prog->cell_bits);
+                    if (plan.reg >= 0){
+                        if (plan.load){
+                            elf_cache_fill(code, bytes, plan.reg, op->offset);
+                        }
+                        if (k == 1 || k == -1){
+                            elf_cache_arith(code, bytes, 0xfe, 0xff, k == 1 ? 0 : 1, plan.reg);  // inc / dec %rN
+                        }else{
+                            elf_cache_arith(code, bytes, 0x80, 0x81, k > 0 ? 0 : 5, plan.reg);  // add / sub $k, %rN
+                            emit_cell_imm(code, bytes, k > 0 ? k : -k);
+                        }
+                    }else if (k == 1 || k == -1){
+                        emit_cell_op(code, bytes, 0xfe, 0xff, k == 1 ? 0 : 1, op->offset);  // inc / dec disp(%r12)
+                    }else if (k > 0){
+                        emit_cell_op(code, bytes, 0x80, 0x81, 0, op->offset);  // add $k, disp(%r12)
+                        emit_cell_imm(code, bytes, k);
+                    }else{
+                        emit_cell_op(code, bytes, 0x80, 0x81, 5, op->offset);  // sub $-k, disp(%r12)
+                        emit_cell_imm(code, bytes, -k);
+                    }
+                }
+                break;
+            case OP_MOVE:
+                if (plan.lea){
+                    emit_bytes(code, "\x4d\x8d", 2);                    // leaq disp(%r12), %r12
+                    emit_r12_operand(code, 4, op->arg * bytes);
+                }else{
+                    elf_move_r12(&img, op->arg * bytes);
+                }
+                break;
+            case OP_OUT:
+                if (output_buffer > 0){
+                    if (plan.reg < 0){
+                        emit_bytes(code, "\x41\x8a", 2);                // movb disp(%r12), %al
+                        emit_r12_operand(code, 0, op->offset * bytes);
+                    }else{
+                        if (plan.load){
+                            elf_cache_fill(code, bytes, plan.reg, op->offset);
+                        }
+                        emit_u8(code, 0x44);                            // movl %rNd, %eax
+                        emit_u8(code, 0x89);
+                        emit_u8(code, (uint8_t)(0xc0 | plan.reg << 3));
+                    }
+                    emit_bytes(code, "\x41\x88\x07", 3);                // movb %al, (%r15)
+                    emit_bytes(code, "\x49\xff\xc7", 3);                // incq %r15
+                    emit_bytes(code, "\x49\x39\xdf", 3);                // cmpq %rbx, %r15
+                    emit_bytes(code, "\x0f\x85\x05\x00\x00\x00", 6);    // jne 越過下一個 call
+                    elf_jump(&img, "\xe8", 1, ELF_FLUSH_OUTPUT);        // call flush_output
+                    break;
+                }
+                emit_bytes(code, "\x4c\x89\xe8", 3);                    // movq %r13, %rax
+                emit_bytes(code, "\x4c\x89\xef", 3);                    // movq %r13, %rdi
+                emit_bytes(code, "\x49\x8d", 2);                        // leaq disp(%r12), %rsi
+                emit_r12_operand(code, 6, op->offset * bytes);
+                emit_bytes(code, "\x4c\x89\xea", 3);                    // movq %r13, %rdx
+                emit_bytes(code, "\x0f\x05", 2);                        // syscall
+                break;
+            case OP_IN:
+                {
+                    elf_rip(&img, "\x48\x3b", 2, 5, ELF_INPUT_END, 0, 0);  // cmpq input_end(%rip), %rbp
+                    size_t load = elf_forward(&img, "\x0f\x82", 2);        // jb in_load
+                    if (output_buffer > 0){
+                        elf_jump(&img, "\xe8", 1, ELF_FLUSH_OUTPUT);       // call flush_output
+                    }
+                    elf_jump(&img, "\xe8", 1, ELF_FILL_INPUT);             // call fill_input
+                    emit_bytes(code, "\x48\x85\xc0", 3);                   // testq %rax, %rax
+                    size_t eof = elf_forward(&img, "\x0f\x8e", 2);         // jle in_done
+                    patch_rel32(code, load, code->size);
+                    emit_bytes(code, "\x0f\xb6\x45\x00", 4);               // movzbl (%rbp), %eax
+                    emit_bytes(code, "\x48\xff\xc5", 3);                   // incq %rbp
+                    emit_cell_op(code, bytes, 0x88, 0x89, 0, op->offset);  // mov %al/%ax/%eax/%rax, disp(%r12)
+                    patch_rel32(code, eof, code->size);
+                }
+                break;
+            case OP_JZ:
+                if (plan.test){
+                    emit_cmp_cell_zero(code, bytes);
+                }
+                patch[i] = elf_forward(&img, "\x0f\x84", 2);               // je → 對應 ] 之後
+                break;
+            case OP_JNZ:
+                if (plan.test){
+                    emit_cmp_cell_zero(code, bytes);
+                }
+                elf_backward(&img, "\x0f\x85", 2, patch[op->arg] + 4);     // jne → 迴圈體開頭
+                patch_rel32(code, patch[op->arg], code->size);
+                break;
+            case OP_SCAN:
+                if (bytes == 1 && op->arg >= -16 && op->arg <= 16){
+                    // SSE2 掃描，與 compile() 相同：一次比較 16 格，區塊會超出紙帶時改為逐格
+                    int step = op->arg > 0 ? op->arg : -op->arg;
+                    int advance = (15 / step + 1) * step;
+                    unsigned mask = 0;
+                    for (int k = 0; k < 16; k += step){
+                        mask |= 1u << (op->arg > 0 ? k : 15 - k);
+                    }
+                    emit_cmp_cell_zero(code, 1);
+                    size_t skip = elf_forward(&img, "\x0f\x84", 2);        // je end
+                    emit_bytes(code, "\x66\x0f\xef\xc9", 4);               // pxor %xmm1, %xmm1
+                    size_t loop = code->size;
+                    size_t tail_at;
+                    if (op->arg > 0){
+                        elf_rip(&img, "\x4c\x3b", 2, 4, ELF_SCAN_HI, 0, 0);  // cmpq scan_hi(%rip), %r12
+                        tail_at = elf_forward(&img, "\x0f\x87", 2);          // ja tail
+                        emit_bytes(code, "\xf3\x41\x0f\x6f\x04\x24", 6);     // movdqu (%r12), %xmm0
+                    }else{
+                        elf_rip(&img, "\x4c\x3b", 2, 4, ELF_SCAN_LO, 0, 0);  // cmpq scan_lo(%rip), %r12
+                        tail_at = elf_forward(&img, "\x0f\x82", 2);          // jb tail
+                        emit_bytes(code, "\xf3\x41\x0f\x6f\x44\x24\xf1", 7); // movdqu -15(%r12), %xmm0
+                    }
+                    emit_bytes(code, "\x66\x0f\x74\xc1", 4);               // pcmpeqb %xmm1, %xmm0
+                    emit_bytes(code, "\x66\x0f\xd7\xc0", 4);               // pmovmskb %xmm0, %eax
+                    emit_u8(code, 0x25);                                   // andl $mask, %eax
+                    emit_i32(code, (int32_t)mask);
+                    size_t found = elf_forward(&img, "\x0f\x85", 2);       // jnz found
+                    elf_move_r12(&img, op->arg > 0 ? advance : -advance);
+                    elf_backward(&img, "\xe9", 1, loop);                   // jmp loop
+                    patch_rel32(code, found, code->size);
+                    if (op->arg > 0){
+                        emit_bytes(code, "\x0f\xbc\xc0", 3);               // bsfl %eax, %eax
+                        emit_bytes(code, "\x49\x01\xc4", 3);               // addq %rax, %r12
+                    }else{
+                        emit_bytes(code, "\x0f\xbd\xc0", 3);               // bsrl %eax, %eax
+                        emit_bytes(code, "\x4d\x8d\x64\x04\xf1", 5);       // leaq -15(%r12,%rax), %r12
+                    }
+                    size_t end = elf_forward(&img, "\xe9", 1);             // jmp end
+                    patch_rel32(code, tail_at, code->size);
+                    size_t tail = code->size;
+                    emit_cmp_cell_zero(code, 1);
+                    size_t tail_end = elf_forward(&img, "\x0f\x84", 2);    // je end
+                    elf_move_r12(&img, op->arg > 0 ? step : -step);
+                    elf_backward(&img, "\xe9", 1, tail);                   // jmp tail
+                    patch_rel32(code, skip, code->size);
+                    patch_rel32(code, end, code->size);
+                    patch_rel32(code, tail_end, code->size);
+                }else{
+                    // 逐格掃描
+                    size_t loop = code->size;
+                    emit_cmp_cell_zero(code, bytes);
+                    size_t end = elf_forward(&img, "\x0f\x84", 2);         // je end
+                    elf_move_r12(&img, op->arg * bytes);
+                    elf_backward(&img, "\xe9", 1, loop);                   // jmp loop
+                    patch_rel32(code, end, code->size);
+                }
+                break;
+            case OP_MUL:
+                {
+                    // 線性迴圈：計數格為 0 時跳過
+                    if (bytes == 1 || bytes == 2){
+                        emit_bytes(code, bytes == 1 ? "\x41\x0f\xb6" : "\x41\x0f\xb7", 3);  // movzbl / movzwl disp(%r12), %eax
+                        emit_r12_operand(code, 0, op->offset * bytes);
+                    }else{
+                        emit_u8(code, bytes == 8 ? 0x49 : 0x41);                           // movl / movq disp(%r12), %eax (%rax)
+                        emit_u8(code, 0x8b);
+                        emit_r12_operand(code, 0, op->offset * bytes);
+                    }
+                    if (bytes == 8){
+                        emit_bytes(code, "\x48\x85\xc0", 3);               // testq %rax, %rax
+                    }else{
+                        emit_bytes(code, "\x85\xc0", 2);                   // testl %eax, %eax
+                    }
+                    size_t skip = elf_forward(&img, "\x0f\x84", 2);        // je mul_end
+                    for (int j = 1; j <= op->arg; j++){
+                        const struct op *term = &op[j];
+                        if (term->arg == 1){
+                            emit_cell_op(code, bytes, 0x00, 0x01, 0, term->offset);  // add %al, disp(%r12)
+                        }else if (term->arg == -1){
+                            emit_cell_op(code, bytes, 0x28, 0x29, 0, term->offset);  // sub %al, disp(%r12)
+                        }else{
+                            if (bytes == 8){
+                                emit_u8(code, 0x48);                       // imulq $m, %rax, %rcx
+                            }
+                            emit_bytes(code, "\x69\xc8", 2);               // imull $m, %eax, %ecx
+                            emit_i32(code, term->arg);
+                            emit_cell_op(code, bytes, 0x00, 0x01, 1, term->offset);  // add %cl, disp(%r12)
+                        }
+                    }
+                    emit_cell_op(code, bytes, 0xc6, 0xc7, 0, op->offset);  // mov $0, disp(%r12)
+                    emit_cell_imm(code, bytes, 0);
+                    patch_rel32(code, skip, code->size);
+                    i += op->arg + 1;  // 已處理後面的 OP_MUL_ADD 與 OP_CLEAR
+                }
+                break;
+            case OP_MUL_ADD:
+                break;
+            case OP_CLEAR:
+                if (plan.reg < 0 || plan.load){
+                    emit_cell_op(code, bytes, 0xc6, 0xc7, 0, op->offset);  // mov $0, disp(%r12)
+                    emit_cell_imm(code, bytes, 0);
+                }
+                if (plan.reg >= 0){
+                    emit_u8(code, 0x41);                                // movl $0, %rNd
+                    emit_u8(code, (uint8_t)(0xb8 + plan.reg));
+                    emit_i32(code, 0);
+                }
+                break;
+            case OP_END:
+                break;
+        }
+    }
+    free(patch);
+
+    if (output_buffer > 0){
+        elf_jump(&img, "\xe8", 1, ELF_FLUSH_OUTPUT);                // call flush_output
+    }
+    elf_mov_imm(&img, 0, 60);                                       // movq $60, %rax
+    emit_bytes(code, "\x48\x31\xff", 3);                            // xorq %rdi, %rdi
+    emit_bytes(code, "\x0f\x05", 2);                                // syscall
+
+    // 紙帶越界：%rsi = siginfo（si_addr 在位移 16），%rdx = ucontext（中斷時的 %r15 在位移 96）
+    size_t segv_handler = code->size;
+    emit_bytes(code, "\x4c\x8b\x66\x10", 4);                        // movq 16(%rsi), %r12
+    elf_rip(&img, "\x4c\x2b", 2, 4, ELF_TAPE_BASE, 0, 0);           // subq tape_base(%rip), %r12
+    if (bytes > 1){
+        emit_bytes(code, "\x49\xc1\xfc", 3);                        // sarq $log2(bytes), %r12
+        emit_u8(code, (uint8_t)__builtin_ctz(bytes));
+    }
+    if (output_buffer > 0){
+        emit_bytes(code, "\x4c\x8b\x7a\x60", 4);                    // movq 96(%rdx), %r15
+        elf_jump(&img, "\xe8", 1, ELF_FLUSH_OUTPUT);                // call flush_output
+    }
+    elf_write_stderr(&img, ELF_SEGV_MSG, sizeof(SEGV_MSG) - 1);
+    elf_rip(&img, "\x48\x8d", 2, 6, ELF_SEGV_DIGITS, 24, 0);        // leaq segv_digits+24(%rip), %rsi
+    emit_bytes(code, "\x4c\x89\xe0", 3);                            // movq %r12, %rax
+    emit_bytes(code, "\x48\x85\xc0", 3);                            // testq %rax, %rax
+    size_t positive = elf_forward(&img, "\x0f\x89", 2);             // jns segv_positive
+    emit_bytes(code, "\x48\xf7\xd8", 3);                            // negq %rax
+    patch_rel32(code, positive, code->size);
+    elf_mov_imm(&img, 1, 10);                                       // movq $10, %rcx
+    size_t digit = code->size;
+    emit_bytes(code, "\x31\xd2", 2);                                // xorl %edx, %edx
+    emit_bytes(code, "\x48\xf7\xf1", 3);                            // divq %rcx
+    emit_bytes(code, "\x80\xc2\x30", 3);                            // addb $48, %dl
+    emit_bytes(code, "\x48\xff\xce", 3);                            // decq %rsi
+    emit_bytes(code, "\x88\x16", 2);                                // movb %dl, (%rsi)
+    emit_bytes(code, "\x48\x85\xc0", 3);                            // testq %rax, %rax
+    elf_backward(&img, "\x0f\x85", 2, digit);                       // jne segv_digit
+    emit_bytes(code, "\x4d\x85\xe4", 3);                            // testq %r12, %r12
+    size_t print = elf_forward(&img, "\x0f\x89", 2);                // jns segv_print
+    emit_bytes(code, "\x48\xff\xce", 3);                            // decq %rsi
+    emit_bytes(code, "\xc6\x06\x2d", 3);                            // movb $45, (%rsi)
+    patch_rel32(code, print, code->size);
+    elf_rip(&img, "\x48\x8d", 2, 2, ELF_SEGV_DIGITS, 24, 0);        // leaq segv_digits+24(%rip), %rdx
+    emit_bytes(code, "\x48\x29\xf2", 3);                            // subq %rsi, %rdx
+    elf_mov_imm(&img, 0, 1);                                        // movq $1, %rax
+    elf_mov_imm(&img, 7, 2);                                        // movq $2, %rdi
+    emit_bytes(code, "\x0f\x05", 2);                                // syscall
+
+    // 結尾訊息含紙帶大小，與 compile() 的 segv_suffix 相同
+    char suffix[96];
+    int suffix_len = snprintf(suffix, sizeof(suffix), " is outside the tape [0, %zu)\n", tape_size / bytes);
+    elf_write_stderr(&img, ELF_SEGV_SUFFIX, (size_t)suffix_len);
+    elf_exit_1(&img);
+    size_t segv_restorer = code->size;
+    elf_mov_imm(&img, 0, 15);                                       // movq $15, %rax（sys_rt_sigreturn）
+    emit_bytes(code, "\x0f\x05", 2);                                // syscall
+    elf_label(&img, ELF_TAPE_ALLOC_FAILED);
+    elf_write_stderr(&img, ELF_TAPE_ERROR, sizeof(TAPE_ERROR) - 1);
+    elf_exit_1(&img);
+
+    if (output_buffer > 0){
+        // 寫出 [outbuf, %r15)，處理部分寫入；寫入失敗時丟棄剩餘內容
+        elf_label(&img, ELF_FLUSH_OUTPUT);
+        elf_rip(&img, "\x48\x8d", 2, 6, ELF_OUTBUF, 0, 0);          // leaq outbuf(%rip), %rsi
+        emit_bytes(code, "\x4c\x89\xfa", 3);                        // movq %r15, %rdx
+        emit_bytes(code, "\x48\x29\xf2", 3);                        // subq %rsi, %rdx
+        size_t loop = code->size;
+        emit_bytes(code, "\x48\x85\xd2", 3);                        // testq %rdx, %rdx
+        size_t done1 = elf_forward(&img, "\x0f\x8e", 2);            // jle flush_output_done
+        emit_bytes(code, "\x4c\x89\xe8", 3);                        // movq %r13, %rax
+        emit_bytes(code, "\x4c\x89\xef", 3);                        // movq %r13, %rdi
+        emit_bytes(code, "\x0f\x05", 2);                            // syscall
+        emit_bytes(code, "\x48\x85\xc0", 3);                        // testq %rax, %rax
+        size_t done2 = elf_forward(&img, "\x0f\x8e", 2);            // jle flush_output_done
+        emit_bytes(code, "\x48\x01\xc6", 3);                        // addq %rax, %rsi
+        emit_bytes(code, "\x48\x29\xc2", 3);                        // subq %rax, %rdx
+        elf_backward(&img, "\xe9", 1, loop);                        // jmp flush_output_loop
+        patch_rel32(code, done1, code->size);
+        patch_rel32(code, done2, code->size);
+        elf_rip(&img, "\x4c\x8d", 2, 7, ELF_OUTBUF, 0, 0);          // leaq outbuf(%rip), %r15
+        emit_u8(code, 0xc3);                                        // ret
+    }
+
+    if (input){
+        // 重新填入輸入緩衝，回傳讀到的位元組數（<= 0 為 EOF 或錯誤）
+        elf_label(&img, ELF_FILL_INPUT);
+        elf_rip(&img, "\x80", 1, 7, ELF_INPUT_MAPPED, 0, 1);        // cmpb $0, input_mapped(%rip)
+        emit_u8(code, 0);
+        size_t eof = elf_forward(&img, "\x0f\x85", 2);              // jne fill_input_eof
+        emit_bytes(code, "\x4c\x89\xf0", 3);                        // movq %r14, %rax
+        emit_bytes(code, "\x4c\x89\xf7", 3);                        // movq %r14, %rdi
+        elf_rip(&img, "\x48\x8d", 2, 6, ELF_INBUF, 0, 0);           // leaq inbuf(%rip), %rsi
+        elf_mov_imm(&img, 2, INPUT_BUFFER_SIZE);                    // movq $INPUT_BUFFER_SIZE, %rdx
+        emit_bytes(code, "\x0f\x05", 2);                            // syscall
+        emit_bytes(code, "\x48\x85\xc0", 3);                        // testq %rax, %rax
+        size_t done = elf_forward(&img, "\x0f\x8e", 2);             // jle fill_input_done
+        elf_rip(&img, "\x48\x8d", 2, 5, ELF_INBUF, 0, 0);           // leaq inbuf(%rip), %rbp
+        emit_bytes(code, "\x48\x8d\x54\x05\x00", 5);                // leaq (%rbp,%rax), %rdx
+        elf_rip(&img, "\x48\x89", 2, 2, ELF_INPUT_END, 0, 0);       // movq %rdx, input_end(%rip)
+        patch_rel32(code, done, code->size);
+        emit_u8(code, 0xc3);                                        // ret
+        patch_rel32(code, eof, code->size);
+        emit_bytes(code, "\x31\xc0", 2);                            // xorl %eax, %eax
+        emit_u8(code, 0xc3);                                        // ret
+    }
+
+    // 唯讀資料：核心的 struct sigaction（handler、SA_SIGINFO | SA_RESTORER、restorer、mask）與錯誤訊息
+    while (code->size % 8 != 0){
+        emit_u8(code, 0);
+    }
+    const uint64_t text = ELF_BASE + ELF_HEADERS_SIZE;
+    elf_label(&img, ELF_SEGV_ACTION);
+    emit_u64(code, text + segv_handler);
+    emit_u64(code, 0x04000004);
+    emit_u64(code, text + segv_restorer);
+    emit_u64(code, 0);
+    elf_label(&img, ELF_SEGV_MSG);
+    emit_bytes(code, SEGV_MSG, sizeof(SEGV_MSG) - 1);
+    elf_label(&img, ELF_SEGV_SUFFIX);
+    emit_bytes(code, suffix, (size_t)suffix_len);
+    elf_label(&img, ELF_TAPE_ERROR);
+    emit_bytes(code, TAPE_ERROR, sizeof(TAPE_ERROR) - 1);
+
+    // .bss 放在機器碼之後的下一頁；回填所有 rel32
+    const uint64_t file_size = ELF_HEADERS_SIZE + code->size;
+    const uint64_t bss_base = (ELF_BASE + file_size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    for (size_t k = 0; k < img.fixup_count; k++){
+        const struct elf_fixup *f = &img.fixups[k];
+        uint64_t target = f->symbol < ELF_TEXT_SYMBOLS ? text + img.symbols[f->symbol] : bss_base + img.symbols[f->symbol];
+        int64_t rel = (int64_t)(target + f->addend) - (int64_t)(text + f->at + 4);
+        if (rel < INT32_MIN || rel > INT32_MAX){
+            err("program too large for a single ELF image");
+        }
+        int32_t rel32 = (int32_t)rel;
+        memcpy(code->bytes + f->at, &rel32, 4);
+    }
+
+    Elf64_Ehdr eh;
+    memset(&eh, 0, sizeof(eh));
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS64;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh.e_type = ET_EXEC;
+    eh.e_machine = EM_X86_64;
+    eh.e_version = EV_CURRENT;
+    eh.e_entry = text;
+    eh.e_phoff = sizeof(Elf64_Ehdr);
+    eh.e_ehsize = sizeof(Elf64_Ehdr);
+    eh.e_phentsize = sizeof(Elf64_Phdr);
+    eh.e_phnum = 3;
+
+    Elf64_Phdr ph[3];
+    memset(ph, 0, sizeof(ph));
+    ph[0].p_type = PT_LOAD;
+    ph[0].p_flags = PF_R | PF_X;
+    ph[0].p_offset = 0;
+    ph[0].p_vaddr = ph[0].p_paddr = ELF_BASE;
+    ph[0].p_filesz = ph[0].p_memsz = file_size;
+    ph[0].p_align = PAGE_SIZE;
+    ph[1].p_type = PT_LOAD;
+    ph[1].p_flags = PF_R | PF_W;
+    ph[1].p_offset = 0;
+    ph[1].p_vaddr = ph[1].p_paddr = bss_base;
+    ph[1].p_memsz = img.bss_size;
+    ph[1].p_align = PAGE_SIZE;
+    ph[2].p_type = PT_GNU_STACK;
+    ph[2].p_flags = PF_R | PF_W;
+    ph[2].p_align = 16;
+
+    *size = ELF_HEADERS_SIZE + code->size;
+    uint8_t *file = malloc(*size);
+    if (file == NULL){
+        err("memory allocation failed");
+    }
+    memcpy(file, &eh, sizeof(eh));
+    memcpy(file + sizeof(eh), ph, sizeof(ph));
+    memcpy(file + ELF_HEADERS_SIZE, code->bytes, code->size);
+    free(code->bytes);
+    free(img.fixups);
+    return file;
+}
+
+// 把可執行檔內容寫到 path（權限 0755）
+static void elf_write(const char *path, const void *file, size_t size){
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if (fd < 0 || fchmod(fd, 0755) != 0){
+        err("can't write ELF file");
+    }
+    out.fd = fd;
+    out_bytes(file, size);
+    out_flush();
+    if (close(fd) != 0){
+        err("can't write ELF file");
+    }
+    out.fd = STDOUT_FILENO;
+}
+
+#endif
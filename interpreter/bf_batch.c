@@ -0,0 +1,415 @@
+// 批次執行（bf_batch）：從 manifest 讀入大量 (程式, 輸入) 工作，在同一個行程內以多個執行緒執行，
+// 省去每個工作各自啟動 interpreter 行程與重新解析程式的成本。
+//
+// manifest 每行一個工作（空行與 # 開頭的行略過）：
+//   program.bf [input|-] [output]
+// input 省略或為 - 時沒有輸入（`,` 讀到 EOF）；output 省略時寫到 --output-dir 下的 <工作編號>.out。
+//
+// - 同一個程式只讀取並編譯一次（compile_ir，--jit 時再編譯成機器碼），所有執行緒唯讀共用
+// - 每個執行緒在開始時配置自己的紙帶與輸出緩衝，之後每個工作只把紙帶清回 0 重複使用
+//   （bf_io.h / bf_tape.h 的狀態在這裡是 _Thread_local）
+// - 排程是 work stealing：工作先平均切給各執行緒的 deque，自己從尾端取，
+//   做完了就從其他執行緒的 deque 前端偷，工作長短不一時也能讓所有核心保持忙碌
+// - 紙帶越界只讓該工作失敗（SIGSEGV handler siglongjmp 回到執行緒），其他工作照常執行
+//
+// 用法：bf_batch [--threads N] [--output-dir DIR] [--jit] [--passes LIST] [--cell-bits 8|16|32|64]
+//                [--tape-size N] [--output-buffer N] manifest
+#define _GNU_SOURCE
+#define BF_THREAD_LOCAL _Thread_local
+#define BF_ENGINE_FAST_ONLY
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../util.h"
+#include "../bf_ir.h"
+#include "../bf_scan.h"
+#include "../bf_io.h"
+#include "../bf_tape.h"
+#include "../bf_source.h"
+
+#if defined(__GNUC__) && !defined(BF_NO_COMPUTED_GOTO)
+#define BF_COMPUTED_GOTO 1
+#endif
+
+#define CELL_BITS 8
+#include "engine.h"
+#define CELL_BITS 16
+#include "engine.h"
+#define CELL_BITS 32
+#include "engine.h"
+#define CELL_BITS 64
+#include "engine.h"
+
+#include "jit_x86_64.h"
+
+// 編譯好的程式，所有執行緒唯讀共用
+struct batch_program {
+    const char *path;
+    struct program prog;
+    void (*run)(const struct program *prog, const char *const input, int debug_window);
+#ifdef BF_HAVE_JIT
+    jit_fn code;         // --jit 時的機器碼，否則為 NULL
+    size_t code_size;
+#endif
+};
+
+struct job {
+    int program;         // batch_program 的索引
+    const char *input;   // NULL = 沒有輸入
+    char *output;
+    int failed;
+};
+
+// 一個執行緒的工作佇列：jobs[head, tail) 尚未執行，擁有者從 tail 取，其他執行緒從 head 偷
+struct deque {
+    pthread_mutex_t lock;
+    int head, tail;
+};
+
+struct batch {
+    struct batch_program *programs;
+    int num_programs;
+    struct job *jobs;
+    int num_jobs;
+    struct deque *queues;
+    int threads;
+    size_t tape_size;
+    int cell_bits;
+    size_t output_buffer;
+};
+
+struct worker {
+    struct batch *batch;
+    int id;
+    int done;            // 這個執行緒執行的工作數
+    int stolen;          // 其中從其他執行緒偷來的工作數
+};
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static char *copy_string(const char *s, size_t len){
+    char *copy = malloc(len + 1);
+    if (copy == NULL){
+        err("memory allocation failed");
+    }
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// 取得 path 對應的程式索引；第一次出現時讀取並編譯
+static int batch_program(struct batch *b, const char *path, unsigned passes_mask, int jit){
+    for (int i = 0; i < b->num_programs; i++){
+        if (strcmp(b->programs[i].path, path) == 0){
+            return i;
+        }
+    }
+    b->programs = realloc(b->programs, sizeof(struct batch_program) * (size_t)(b->num_programs + 1));
+    if (b->programs == NULL){
+        err("memory allocation failed");
+    }
+    struct batch_program *p = &b->programs[b->num_programs];
+    struct source src;
+    if (source_open(&src, path) != 0){
+        fprintf(stderr, "bf_batch: can't open program %s\n", path);
+        exit(1);
+    }
+    p->path = path;
+    p->prog = compile_source(&src, passes_mask, b->cell_bits);
+    source_close(&src);
+    switch (b->cell_bits) {
+        case 16: p->run = run_fast_16; break;
+        case 32: p->run = run_fast_32; break;
+        case 64: p->run = run_fast_64; break;
+        default: p->run = run_fast_8; break;
+    }
+#ifdef BF_HAVE_JIT
+    p->code = NULL;
+    if (jit){
+        struct code_buffer code = {NULL, 0, 0, NULL, 0, 0};
+        jit_emit(&p->prog, 0, p->prog.size - 1, &code);
+        p->code_size = code.size;
+        p->code = jit_load(&code);
+    }
+#else
+    if (jit){
+        err("--jit is only supported on x86-64 Linux");
+    }
+#endif
+    return b->num_programs++;
+}
+
+// 讀取 manifest；欄位以空白分隔
+static void read_manifest(struct batch *b, const char *path, const char *output_dir, unsigned passes_mask, int jit){
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (fp == NULL){
+        fprintf(stderr, "bf_batch: can't open manifest %s\n", path);
+        exit(1);
+    }
+    int capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, fp) != -1){
+        char *fields[3] = {NULL, NULL, NULL};
+        int n = 0;
+        char *save;
+        for (char *f = strtok_r(line, " \t\r\n", &save); f != NULL && n < 3; f = strtok_r(NULL, " \t\r\n", &save)){
+            fields[n++] = f;
+        }
+        if (n == 0 || fields[0][0] == '#'){
+            continue;
+        }
+        if (b->num_jobs == capacity){
+            capacity = capacity ? capacity * 2 : 256;
+            b->jobs = realloc(b->jobs, sizeof(struct job) * (size_t)capacity);
+            if (b->jobs == NULL){
+                err("memory allocation failed");
+            }
+        }
+        struct job *job = &b->jobs[b->num_jobs];
+        job->program = batch_program(b, copy_string(fields[0], strlen(fields[0])), passes_mask, jit);
+        job->input = fields[1] == NULL || strcmp(fields[1], "-") == 0 ? NULL : copy_string(fields[1], strlen(fields[1]));
+        if (fields[2] != NULL){
+            job->output = copy_string(fields[2], strlen(fields[2]));
+        }else{
+            char out[PATH_MAX];
+            snprintf(out, sizeof(out), "%s/%d.out", output_dir, b->num_jobs);
+            job->output = copy_string(out, strlen(out));
+        }
+        job->failed = 0;
+        b->num_jobs++;
+    }
+    free(line);
+    if (fp != stdin){
+        fclose(fp);
+    }
+}
+
+// 取下一個工作：先從自己的 deque 尾端，沒有時依序從其他執行緒的 deque 前端偷；全部清空時回傳 -1
+static int next_job(struct batch *b, int self, int *stolen){
+    struct deque *q = &b->queues[self];
+    pthread_mutex_lock(&q->lock);
+    int job = q->head < q->tail ? --q->tail : -1;
+    pthread_mutex_unlock(&q->lock);
+    if (job >= 0){
+        return job;
+    }
+    for (int i = 1; i < b->threads; i++){
+        struct deque *victim = &b->queues[(self + i) % b->threads];
+        pthread_mutex_lock(&victim->lock);
+        job = victim->head < victim->tail ? victim->head++ : -1;
+        pthread_mutex_unlock(&victim->lock);
+        if (job >= 0){
+            ++*stolen;
+            return job;
+        }
+    }
+    // 工作在開始前就全部分配好，不會再增加：所有 deque 都空了即可結束
+    return -1;
+}
+
+// 以目前執行緒的紙帶執行程式；越界時 SIGSEGV handler 會 siglongjmp 回這裡，回傳 0 表示越界
+static int run_program(const struct batch_program *p){
+    sigjmp_buf recover;
+    if (sigsetjmp(recover, 1) != 0){
+        bf_tape.recover = NULL;
+        return 0;
+    }
+    bf_tape.recover = &recover;
+#ifdef BF_HAVE_JIT
+    if (p->code != NULL){
+        p->code(bf_tape.cells);
+    }else
+#endif
+    {
+        p->run(&p->prog, NULL, 0);
+    }
+    bf_tape.recover = NULL;
+    return 1;
+}
+
+static void run_job(struct batch *b, struct job *job, int id){
+    const struct batch_program *p = &b->programs[job->program];
+    int in = -1;
+    if (job->input != NULL && (in = open(job->input, O_RDONLY)) < 0){
+        fprintf(stderr, "bf_batch: job %d: can't open input %s\n", id, job->input);
+        job->failed = 1;
+        return;
+    }
+    int out = open(job->output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0){
+        fprintf(stderr, "bf_batch: job %d: can't open output %s\n", id, job->output);
+        job->failed = 1;
+        if (in >= 0){
+            close(in);
+        }
+        return;
+    }
+    bf_out.fd = out;
+    bf_out.len = 0;
+    input_open(in);
+    tape_reset();
+    if (!run_program(p)){
+        fprintf(stderr, "bf_batch: job %d (%s): tape overflow: cell %ld is outside the tape [0, %zu)\n",
+                id, p->path, bf_tape.fault_cell, bf_tape.size);
+        job->failed = 1;
+    }
+    output_flush();
+    input_close();
+    close(out);
+    if (in >= 0){
+        close(in);
+    }
+}
+
+static void *worker_main(void *arg){
+    struct worker *w = arg;
+    struct batch *b = w->batch;
+    // 每個執行緒一份紙帶與輸出緩衝，所有工作重複使用
+    tape_alloc(b->tape_size, (size_t)b->cell_bits / 8);
+    bf_out.size = b->output_buffer;
+    bf_out.bytes = malloc(bf_out.size);
+    if (bf_out.bytes == NULL){
+        err("memory allocation failed");
+    }
+    int job;
+    while ((job = next_job(b, w->id, &w->stolen)) >= 0){
+        run_job(b, &b->jobs[job], job);
+        w->done++;
+    }
+    free(bf_out.bytes);
+    tape_free();
+    return NULL;
+}
+
+#define USAGE "Usage: bf_batch [--threads N] [--output-dir DIR] [--jit] [--passes LIST] [--cell-bits 8|16|32|64] [--tape-size N] [--output-buffer N] manifest"
+
+int main(int argc, char *argv[]){
+    struct batch b;
+    memset(&b, 0, sizeof(b));
+    b.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    b.tape_size = BF_TAPE_DEFAULT;
+    b.cell_bits = 8;
+    b.output_buffer = BF_OUTPUT_BUFFER_DEFAULT;
+    unsigned passes_mask = PASS_ALL;
+    const char *output_dir = ".";
+    const char *manifest = NULL;
+    int jit = 0;
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+            b.threads = atoi(argv[++i]);
+            if (b.threads < 1){
+                err("--threads must be a positive number");
+            }
+        }else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc){
+            output_dir = argv[++i];
+        }else if (strcmp(argv[i], "--jit") == 0){
+            jit = 1;
+        }else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc){
+            passes_mask = parse_pass_list(argv[++i]);
+        }else if (strcmp(argv[i], "--cell-bits") == 0 && i + 1 < argc){
+            b.cell_bits = atoi(argv[++i]);
+            if (!valid_cell_bits(b.cell_bits)){
+                err("--cell-bits must be 8, 16, 32 or 64");
+            }
+        }else if (strcmp(argv[i], "--tape-size") == 0 && i + 1 < argc){
+            b.tape_size = parse_size(argv[++i]);
+        }else if (strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc){
+            long n = atol(argv[++i]);
+            b.output_buffer = n > 0 ? (size_t)n : 1;
+        }else if (manifest == NULL){
+            manifest = argv[i];
+        }else{
+            err(USAGE);
+        }
+    }
+    if (manifest == NULL){
+        err(USAGE);
+    }
+    if (b.threads < 1){
+        b.threads = 1;
+    }
+    struct stat st;
+    if (stat(output_dir, &st) != 0 && mkdir(output_dir, 0755) != 0){
+        fprintf(stderr, "bf_batch: can't create %s: %s\n", output_dir, strerror(errno));
+        return 1;
+    }
+
+    double start = now_ms();
+    read_manifest(&b, manifest, output_dir, passes_mask, jit);
+    double parsed = now_ms();
+    if (b.threads > b.num_jobs && b.num_jobs > 0){
+        b.threads = b.num_jobs;
+    }
+
+    // 工作依順序平均切成連續的區段，之後由 work stealing 平衡
+    b.queues = calloc((size_t)b.threads, sizeof(struct deque));
+    struct worker *workers = calloc((size_t)b.threads, sizeof(struct worker));
+    pthread_t *tids = calloc((size_t)b.threads, sizeof(pthread_t));
+    if (b.queues == NULL || workers == NULL || tids == NULL){
+        err("memory allocation failed");
+    }
+    for (int i = 0; i < b.threads; i++){
+        pthread_mutex_init(&b.queues[i].lock, NULL);
+        b.queues[i].head = (int)((long)b.num_jobs * i / b.threads);
+        b.queues[i].tail = (int)((long)b.num_jobs * (i + 1) / b.threads);
+        workers[i] = (struct worker){&b, i, 0, 0};
+    }
+    for (int i = 0; i < b.threads; i++){
+        if (pthread_create(&tids[i], NULL, worker_main, &workers[i]) != 0){
+            err("unable to create worker thread");
+        }
+    }
+    int stolen = 0;
+    for (int i = 0; i < b.threads; i++){
+        pthread_join(tids[i], NULL);
+        stolen += workers[i].stolen;
+    }
+    double finished = now_ms();
+
+    int failed = 0;
+    for (int i = 0; i < b.num_jobs; i++){
+        failed += b.jobs[i].failed;
+    }
+    double run_ms = finished - parsed;
+    fprintf(stderr, "bf_batch: %d jobs (%d failed), %d programs, %d threads, %d stolen; "
+            "compile %.1f ms, run %.1f ms, %.1f jobs/s\n",
+            b.num_jobs, failed, b.num_programs, b.threads, stolen,
+            parsed - start, run_ms, run_ms > 0 ? b.num_jobs * 1000.0 / run_ms : 0.0);
+
+    for (int i = 0; i < b.num_programs; i++){
+#ifdef BF_HAVE_JIT
+        if (b.programs[i].code != NULL){
+            munmap((void *)b.programs[i].code, b.programs[i].code_size);
+        }
+#endif
+        free_program(&b.programs[i].prog);
+        free((char *)b.programs[i].path);
+    }
+    for (int i = 0; i < b.num_jobs; i++){
+        free((char *)b.jobs[i].input);
+        free(b.jobs[i].output);
+    }
+    for (int i = 0; i < b.threads; i++){
+        pthread_mutex_destroy(&b.queues[i].lock);
+    }
+    free(b.programs);
+    free(b.jobs);
+    free(b.queues);
+    free(workers);
+    free(tids);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+// 單一儲存格寬度的完整引擎模板，由 main.c 以不同的 CELL_BITS（8/16/32/64）#include 多次：
+//   scan_N     - 掃描迴圈，8 位元使用 bf_scan.h 的 SIMD 核心，較寬的儲存格逐格比較
+//   run_fast_N - 一般執行迴圈
+//   run_debug_N - 除錯執行迴圈
+//   run_profile_N - 記錄每個指令執行次數的迴圈（--profile / --count-ops）
+//   run_tiered_N - 分層執行的迴圈，熱迴圈交給 JIT（--tiered，只在有 JIT 的平台）
+// 每種寬度都是獨立展開的函式，儲存格型別在編譯期決定，8 位元版本與原本的迴圈完全相同。
+// 定義 BF_ENGINE_FAST_ONLY 時只展開 scan_N 與 run_fast_N（bf_batch 不需要除錯與 profiling）。
+
+#ifndef CELL_BITS
+#error "CELL_BITS must be defined before including engine.h"
+#endif
+
+#define ENGINE_PASTE2(a, b) a##b
+#define ENGINE_PASTE(a, b) ENGINE_PASTE2(a, b)
+#define CELL_T ENGINE_PASTE(ENGINE_PASTE(uint, CELL_BITS), _t)
+#define SCAN_NAME ENGINE_PASTE(scan_, CELL_BITS)
+
+// Scan loop：從 ptr 依步長找到第一個 0。紙帶內沒有 0 時移到步長上第一個超出紙帶的格子並讀取它，
+// 由保護頁觸發越界回報，與 x86 / LLVM 後端逐格前進時在同一格出錯
+static CELL_T *SCAN_NAME(CELL_T *ptr, int scan_step, CELL_T *tape){
+    CELL_T *edge;
+#if CELL_BITS == 8
+    // 實際搜尋交給 bf_scan.h 的 SIMD 核心（SSE2 / AVX2，執行期選擇）
+    uint8_t *result;
+    if (scan_step > 0) {
+        result = scan_right(ptr, (size_t)scan_step, tape + bf_tape.size);
+        if (result) {
+            return result;
+        }
+        edge = ptr + ((size_t)(tape + bf_tape.size - ptr) + scan_step - 1) / scan_step * scan_step;
+    } else {
+        result = scan_left(ptr, (size_t)-scan_step, tape);
+        if (result) {
+            return result;
+        }
+        edge = ptr - ((size_t)(ptr - tape) / -scan_step + 1) * -scan_step;
+    }
+#else
+    CELL_T *last = tape + bf_tape.size - 1;
+    if (scan_step > 0) {
+        while (*ptr && (size_t)(last - ptr) >= (size_t)scan_step) {
+            ptr += scan_step;
+        }
+    } else {
+        while (*ptr && (size_t)(ptr - tape) >= (size_t)-scan_step) {
+            ptr += scan_step;
+        }
+    }
+    if (!*ptr) {
+        return ptr;
+    }
+    edge = ptr + scan_step;
+#endif
+    (void)*(volatile CELL_T *)edge;
+    return edge;
+}
+
+#define RUN_NAME ENGINE_PASTE(run_fast_, CELL_BITS)
+#define RUN_DEBUG 0
+#define RUN_PROFILE 0
+#define RUN_TIERED 0
+#include "exec_loop.h"
+
+#ifndef BF_ENGINE_FAST_ONLY
+#define RUN_NAME ENGINE_PASTE(run_debug_, CELL_BITS)
+#define RUN_DEBUG 1
+#define RUN_PROFILE 0
+#define RUN_TIERED 0
+#include "exec_loop.h"
+
+#define RUN_NAME ENGINE_PASTE(run_profile_, CELL_BITS)
+#define RUN_DEBUG 0
+#define RUN_PROFILE 1
+#define RUN_TIERED 0
+#include "exec_loop.h"
+#endif
+
+#ifdef BF_HAVE_TIERED
+#define RUN_NAME ENGINE_PASTE(run_tiered_, CELL_BITS)
+#define RUN_DEBUG 0
+#define RUN_PROFILE 0
+#define RUN_TIERED 1
+#include "exec_loop.h"
+#endif
+
+#undef SCAN_NAME
+#undef CELL_T
+#undef ENGINE_PASTE
+#undef ENGINE_PASTE2
+#undef CELL_BITS
@@ -0,0 +1,161 @@
+// 解譯器執行迴圈的模板，由 engine.h 以不同參數 #include 多次：
+//   RUN_NAME  - 產生的函式名稱
+//   RUN_DEBUG - 0 或 1，是否在每個指令後輸出除錯狀態
+//   RUN_PROFILE - 0 或 1，是否把每個指令的執行次數與分支統計記到 profile（--profile / --count-ops）
+//   RUN_TIERED - 0 或 1，是否計算熱迴圈並交給 JIT（--tiered，見 tier.h）
+//   CELL_T    - 儲存格型別（uint8_t / uint16_t / uint32_t / uint64_t）
+//   SCAN_NAME - 同一寬度的掃描函式
+// RUN_DEBUG 是前置處理期常數，一般版本中的除錯程式碼在編譯期就被移除。
+// （含 computed goto 的函式無法被 inline，所以用 #include 展開而非 inline 函式）
+
+#ifndef RUN_NAME
+#error "RUN_NAME must be defined before including exec_loop.h"
+#endif
+
+static void RUN_NAME(const struct program *prog, const char *const input, int debug_window){
+
+    // 紙帶由 tape_alloc() 以 mmap 配置，初始全為 0，前後有保護頁
+    CELL_T *const tape = (CELL_T *)bf_tape.cells;
+
+    //set the pointer to the left most cell of the tape
+    CELL_T *ptr=tape;
+
+    const struct op *op = prog->ops;
+    CELL_T factor = 0;  // 乘法迴圈的計數格數值，由 OP_MUL 載入供 OP_MUL_ADD 使用
+#if RUN_DEBUG
+	int last_stdout_char = '\n'; // 追蹤最近一次 stdout 字元，預設視為已換行
+#else
+    (void)input;
+    (void)debug_window;
+#endif
+
+// profiling 時在分派前記錄執行次數，此時 op 尚未被跳躍改變
+#if RUN_PROFILE
+#define PROFILE_HIT() (++profile.hits[op - prog->ops])
+#define PROFILE_TAKEN(n) (profile.taken[op - prog->ops] += (n))
+#else
+#define PROFILE_HIT() ((void)0)
+#define PROFILE_TAKEN(n) ((void)0)
+#endif
+
+#ifdef BF_COMPUTED_GOTO
+    static const void *const dispatch[] = {
+        [OP_ADD] = &&L_OP_ADD,     [OP_MOVE] = &&L_OP_MOVE,
+        [OP_OUT] = &&L_OP_OUT,     [OP_IN] = &&L_OP_IN,
+        [OP_JZ] = &&L_OP_JZ,       [OP_JNZ] = &&L_OP_JNZ,
+        [OP_SCAN] = &&L_OP_SCAN,   [OP_MUL] = &&L_OP_MUL,
+        [OP_MUL_ADD] = &&L_OP_MUL_ADD, [OP_CLEAR] = &&L_OP_CLEAR,
+        [OP_END] = &&L_OP_END,
+    };
+#define CASE(t) L_##t:
+#define DISPATCH() do { PROFILE_HIT(); goto *dispatch[op->type]; } while (0)
+#else
+#define CASE(t) case t:
+#define DISPATCH() goto dispatch
+#endif
+
+#if RUN_DEBUG
+#define NEXT() do { \
+        /* 確保除錯輸出與正常輸出分行，避免混寫在同一列 */ \
+        if (last_stdout_char != '\n') { \
+            fputc('\n', stderr); \
+            last_stdout_char = '\n'; \
+        } \
+        debug_print_state(op->pos, input[op->pos], tape, (long)(ptr - tape), debug_window); \
+        ++op; \
+        DISPATCH(); \
+    } while (0)
+#define TRACK_OUTPUT(c) (last_stdout_char = (c))
+#else
+#define NEXT() do { ++op; DISPATCH(); } while (0)
+#define TRACK_OUTPUT(c) ((void)0)
+#endif
+
+#ifdef BF_COMPUTED_GOTO
+    DISPATCH();
+    {
+#else
+dispatch:
+    PROFILE_HIT();
+    switch (op->type) {
+#endif
+        CASE(OP_ADD)
+            ptr[op->offset] += op->arg;  // 直接加，不用迴圈
+            NEXT();
+        CASE(OP_MOVE)
+            ptr += op->arg;
+            NEXT();
+        CASE(OP_OUT)
+            output_putc((uint8_t)ptr[op->offset]);
+            TRACK_OUTPUT((uint8_t)ptr[op->offset]);
+            NEXT();
+        CASE(OP_IN)
+            ptr[op->offset]=(CELL_T)input_getc();
+            NEXT();
+        CASE(OP_JZ)
+#if RUN_TIERED
+            if (tier.code[op - prog->ops]){
+                // 已編譯的迴圈：原生碼執行到迴圈結束，接著從對應的 ] 之後繼續
+                ptr = (CELL_T *)tier.code[op - prog->ops]((uint8_t *)ptr);
+                op = prog->ops + op->arg;
+                NEXT();
+            }
+#endif
+            if (!*ptr){
+                PROFILE_TAKEN(1);
+                op = prog->ops + op->arg;
+            }
+            NEXT();
+        CASE(OP_JNZ)
+            if (*ptr){
+                PROFILE_TAKEN(1);
+                op = prog->ops + op->arg;
+#if RUN_TIERED
+                // 迴圈剛被編譯時不前進，重新分派到 [ 改走原生碼
+                if (tier_backedge(prog, (int)(op - prog->ops))){
+                    DISPATCH();
+                }
+#endif
+            }
+            NEXT();
+        CASE(OP_SCAN)
+            if (*ptr){
+#if RUN_PROFILE
+                CELL_T *from = ptr;
+                ptr = SCAN_NAME(ptr, op->arg, tape);
+                PROFILE_TAKEN((uint64_t)((ptr - from) / op->arg));
+#else
+                ptr = SCAN_NAME(ptr, op->arg, tape);
+#endif
+            }
+            NEXT();
+        CASE(OP_MUL)
+            // 計數格為 0 時整個迴圈（含結尾的 OP_CLEAR）都不執行
+            factor = ptr[op->offset];
+            if (!factor){
+                PROFILE_TAKEN(1);
+                op += op->arg + 1;
+            }
+            NEXT();
+        CASE(OP_MUL_ADD)
+            ptr[op->offset] += factor * op->arg;
+            NEXT();
+        CASE(OP_CLEAR)
+            ptr[op->offset] = 0;  // 清零計數格
+            NEXT();
+        CASE(OP_END)
+            return;
+    }
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef TRACK_OUTPUT
+#undef PROFILE_HIT
+#undef PROFILE_TAKEN
+}
+
+#undef RUN_NAME
+#undef RUN_DEBUG
+#undef RUN_PROFILE
+#undef RUN_TIERED
@@ -0,0 +1,330 @@
+// 行程內 x86-64 JIT（--jit）：與 compiler_x86_64.c 相同的指令選擇，
+// 但直接編碼成機器碼寫入可執行的 mmap 區塊並呼叫，省去組譯、連結與啟動新行程。
+// 產生的函式為 uint8_t *fn(uint8_t *ptr)：
+//   %r12 = 數據指標（由 %rdi 傳入，結束時由 %rax 傳回）
+//   --jit 編譯整個程式並以紙帶開頭呼叫；--tiered 只編譯熱迴圈（tier_compile()），傳入的是解譯器當下的指標
+//   儲存格寬度取自 IR 的 cell_bits：同一個 opcode 依寬度加上 0x66 / REX.W 前綴，位移乘上每格位元組數
+//   %eax / %ecx = 線性迴圈的計數值與乘積
+//   I/O 呼叫 jit_putchar / jit_getchar，與解譯器共用 bf_io.h 的輸出緩衝
+//   掃描迴圈呼叫 jit_scan，與解譯器共用 bf_scan.h 的 SIMD 核心
+// 括號先以 rel32 佔位，遇到對應的 ] 時回填。
+// 呼叫 C 函式的 movabsq 立即值另外記錄成 relocation，--cache 存下的機器碼載入時再填入這個行程中的位址。
+
+#if defined(__x86_64__) && defined(__linux__)
+#define BF_HAVE_JIT 1
+
+#include <sys/mman.h>
+#include "../bf_x86_64.h"
+
+// 機器碼呼叫的 C 函式；快取中以編號記錄（PIE + ASLR 下每次執行的位址都不同）
+enum jit_symbol {
+    JIT_PUTCHAR,
+    JIT_GETCHAR,
+    JIT_SCAN_8,
+    JIT_SCAN_16,
+    JIT_SCAN_32,
+    JIT_SCAN_64,
+    JIT_SYMBOL_COUNT,
+};
+
+static void jit_putchar(int c){
+    output_putc((uint8_t)c);
+}
+
+static int jit_getchar(void){
+    return input_getc();
+}
+
+// 掃描迴圈與解譯器共用同寬度的 scan_N()
+#define JIT_SCAN(bits) \
+    static void *jit_scan_##bits(uint##bits##_t *ptr, int step){ \
+        return scan_##bits(ptr, step, (uint##bits##_t *)bf_tape.cells); \
+    }
+JIT_SCAN(8)
+JIT_SCAN(16)
+JIT_SCAN(32)
+JIT_SCAN(64)
+#undef JIT_SCAN
+
+static enum jit_symbol jit_scan_symbol(int bytes){
+    switch (bytes) {
+        case 2: return JIT_SCAN_16;
+        case 4: return JIT_SCAN_32;
+        case 8: return JIT_SCAN_64;
+        default: return JIT_SCAN_8;
+    }
+}
+
+static const void *jit_symbol_address(enum jit_symbol symbol){
+    switch (symbol) {
+        case JIT_PUTCHAR: return (const void *)jit_putchar;
+        case JIT_GETCHAR: return (const void *)jit_getchar;
+        case JIT_SCAN_16: return (const void *)jit_scan_16;
+        case JIT_SCAN_32: return (const void *)jit_scan_32;
+        case JIT_SCAN_64: return (const void *)jit_scan_64;
+        default: return (const void *)jit_scan_8;
+    }
+}
+
+// movabsq $fn, %rax; call *%rax
+static void emit_call(struct code_buffer *code, enum jit_symbol symbol){
+    if (code->reloc_count == code->reloc_capacity){
+        code->reloc_capacity = code->reloc_capacity ? code->reloc_capacity * 2 : 64;
+        code->relocs = realloc(code->relocs, sizeof(struct jit_reloc) * code->reloc_capacity);
+        if (code->relocs == NULL){
+            err("memory allocation failed");
+        }
+    }
+    emit_bytes(code, "\x48\xb8", 2);
+    code->relocs[code->reloc_count++] = (struct jit_reloc){(uint32_t)code->size, (uint32_t)symbol};
+    emit_u64(code, (uint64_t)(uintptr_t)jit_symbol_address(symbol));
+    emit_bytes(code, "\xff\xd0", 2);
+}
+
+// 把 relocation 指到的 movabsq 立即值改成這個行程中的函式位址（從快取載入的機器碼使用）；
+// 位置或編號不合法時回傳 -1
+static int jit_relocate(struct code_buffer *code){
+    for (size_t i = 0; i < code->reloc_count; i++){
+        const struct jit_reloc *r = &code->relocs[i];
+        if (r->symbol >= JIT_SYMBOL_COUNT || (size_t)r->at + 8 > code->size){
+            return -1;
+        }
+        uint64_t address = (uint64_t)(uintptr_t)jit_symbol_address((enum jit_symbol)r->symbol);
+        memcpy(code->bytes + r->at, &address, 8);
+    }
+    return 0;
+}
+
+typedef uint8_t *(*jit_fn)(uint8_t *ptr);
+
+// 將 IR 的 [first, last] 區間編碼為機器碼；區間內的括號必須成對
+static void jit_emit(const struct program *prog, int first, int last, struct code_buffer *code){
+    // 每個 [ 的 je rel32 位置，] 時回填；0 表示尚未產生（序言之後的位置不會是 0）
+    size_t *patch = calloc((size_t)prog->size + 1, sizeof(size_t));
+    if (patch == NULL){
+        err("memory allocation failed");
+    }
+
+    // push %r12（同時讓呼叫 C 函式時 %rsp 對齊 16）；movq %rdi, %r12
+    emit_bytes(code, "\x41\x54\x49\x89\xfc", 5);
+
+    const int bytes = prog->cell_bits / 8;
+    for (int i = first; i <= last; i++){
+        const struct op *op = &prog->ops[i];
+        switch (op->type) {
+            case OP_ADD:
+                {
+                    int64_t k = cell_value(op->arg, prog->cell_bits);
+                    if (k == 1 || k == -1){
+                        // inc / dec disp(%r12)
+                        emit_cell_op(code, bytes, 0xfe, 0xff, k == 1 ? 0 : 1, op->offset);
+                    }else{
+                        // add $k, disp(%r12)
+                        emit_cell_op(code, bytes, 0x80, 0x81, 0, op->offset);
+                        emit_cell_imm(code, bytes, k);
+                    }
+                }
+                break;
+            case OP_MOVE:
+                emit_move_r12(code, op->arg * bytes);
+                break;
+            case OP_OUT:
+                // movzbl disp(%r12), %edi：只輸出最低位元組
+                emit_bytes(code, "\x41\x0f\xb6", 3);
+                emit_r12_operand(code, 7, op->offset * bytes);
+                emit_call(code, JIT_PUTCHAR);
+                break;
+            case OP_IN:
+                emit_call(code, JIT_GETCHAR);
+                if (bytes == 8){
+                    emit_bytes(code, "\x48\x98", 2);  // cltq：EOF 的 -1 延伸到 64 位元
+                }
+                // mov %al/%ax/%eax/%rax, disp(%r12)
+                emit_cell_op(code, bytes, 0x88, 0x89, 0, op->offset);
+                break;
+            case OP_JZ:
+                // je rel32 → 回填到對應 ] 之後
+                emit_cmp_cell_zero(code, bytes);
+                emit_bytes(code, "\x0f\x84", 2);
+                patch[i] = code->size;
+                emit_i32(code, 0);
+                break;
+            case OP_JNZ:
+                {
+                    // jne rel32 → 迴圈體開頭（[ 的 je 之後）；對應的 [ 必須在區間內且已產生，
+                    // 否則是未經 ir_validate 的壞 IR，不能以未設定的位置回填
+                    if (op->arg < first || op->arg >= i || patch[op->arg] == 0){
+                        err("corrupt IR: unmatched bracket in JIT range");
+                    }
+                    size_t body = patch[op->arg] + 4;
+                    emit_cmp_cell_zero(code, bytes);
+                    emit_bytes(code, "\x0f\x85", 2);
+                    emit_i32(code, 0);
+                    patch_rel32(code, code->size - 4, body);
+                    patch_rel32(code, patch[op->arg], code->size);
+                }
+                break;
+            case OP_SCAN:
+                {
+                    // [>]、[<<] 等掃描迴圈：目前格為 0 時直接跳過，否則呼叫 jit_scan_N（8 位元為 SIMD 核心）
+                    emit_cmp_cell_zero(code, bytes);
+                    emit_bytes(code, "\x0f\x84", 2);
+                    size_t skip_at = code->size;
+                    emit_i32(code, 0);
+                    emit_bytes(code, "\x4c\x89\xe7", 3);  // movq %r12, %rdi
+                    emit_u8(code, 0xbe);                   // movl $step, %esi
+                    emit_i32(code, op->arg);
+                    emit_call(code, jit_scan_symbol(bytes));
+                    emit_bytes(code, "\x49\x89\xc4", 3);  // movq %rax, %r12
+                    patch_rel32(code, skip_at, code->size);
+                }
+                break;
+            case OP_MUL:
+                {
+                    // 線性迴圈：計數格為 0 時跳過，避免以偏移量存取到紙帶外
+                    // 載入計數格：movzbl / movzwl / movl / movq disp(%r12), %eax (%rax)
+                    if (bytes == 1 || bytes == 2){
+                        emit_bytes(code, bytes == 1 ? "\x41\x0f\xb6" : "\x41\x0f\xb7", 3);
+                        emit_r12_operand(code, 0, op->offset * bytes);
+                    }else{
+                        emit_u8(code, bytes == 8 ? 0x49 : 0x41);
+                        emit_u8(code, 0x8b);
+                        emit_r12_operand(code, 0, op->offset * bytes);
+                    }
+                    if (bytes == 8){
+                        emit_bytes(code, "\x48\x85\xc0\x0f\x84", 5); // testq %rax, %rax; je rel32
+                    }else{
+                        emit_bytes(code, "\x85\xc0\x0f\x84", 4);     // testl %eax, %eax; je rel32
+                    }
+                    size_t skip_at = code->size;
+                    emit_i32(code, 0);
+                    for (int j = 1; j <= op->arg; j++){
+                        const struct op *term = &op[j];
+                        if (term->arg == 1){
+                            emit_cell_op(code, bytes, 0x00, 0x01, 0, term->offset);  // add %al, disp(%r12)
+                        }else if (term->arg == -1){
+                            emit_cell_op(code, bytes, 0x28, 0x29, 0, term->offset);  // sub %al, disp(%r12)
+                        }else{
+                            if (bytes == 8){
+                                emit_u8(code, 0x48);                // imulq $m, %rax, %rcx
+                            }
+                            emit_bytes(code, "\x69\xc8", 2);       // imull $m, %eax, %ecx
+                            emit_i32(code, term->arg);
+                            emit_cell_op(code, bytes, 0x00, 0x01, 1, term->offset);  // add %cl, disp(%r12)
+                        }
+                    }
+                    emit_cell_op(code, bytes, 0xc6, 0xc7, 0, op->offset);  // mov $0, disp(%r12)
+                    emit_cell_imm(code, bytes, 0);
+                    patch_rel32(code, skip_at, code->size);
+                    i += op->arg + 1;  // 已處理後面的 OP_MUL_ADD 與 OP_CLEAR
+                }
+                break;
+            case OP_MUL_ADD:
+                break;
+            case OP_CLEAR:
+                emit_cell_op(code, bytes, 0xc6, 0xc7, 0, op->offset);  // mov $0, disp(%r12)
+                emit_cell_imm(code, bytes, 0);
+                break;
+            case OP_END:
+                break;
+        }
+    }
+
+    // movq %r12, %rax; pop %r12; ret
+    emit_bytes(code, "\x4c\x89\xe0\x41\x5c\xc3", 6);
+    free(patch);
+}
+
+// 機器碼序列化（--cache）：uint64 的機器碼長度與 relocation 數，接著機器碼與 relocation 表
+static inline void *jit_pack(const struct code_buffer *code, size_t *size){
+    uint64_t header[2] = {code->size, code->reloc_count};
+    *size = sizeof(header) + code->size + sizeof(struct jit_reloc) * code->reloc_count;
+    uint8_t *data = malloc(*size);
+    if (data == NULL){
+        err("memory allocation failed");
+    }
+    memcpy(data, header, sizeof(header));
+    memcpy(data + sizeof(header), code->bytes, code->size);
+    memcpy(data + sizeof(header) + code->size, code->relocs, sizeof(struct jit_reloc) * code->reloc_count);
+    return data;
+}
+
+// 還原 jit_pack() 的結果並重新填入函式位址；格式不合法時回傳 -1
+static inline int jit_unpack(const void *bytes, size_t size, struct code_buffer *code){
+    uint64_t header[2];
+    if (size < sizeof(header)){
+        return -1;
+    }
+    memcpy(header, bytes, sizeof(header));
+    if (header[0] == 0 || header[0] > size || header[1] > size
+        || size != sizeof(header) + header[0] + sizeof(struct jit_reloc) * header[1]){
+        return -1;
+    }
+    const uint8_t *p = (const uint8_t *)bytes + sizeof(header);
+    code->size = code->capacity = (size_t)header[0];
+    code->reloc_count = code->reloc_capacity = (size_t)header[1];
+    code->bytes = malloc(code->size);
+    code->relocs = malloc(sizeof(struct jit_reloc) * code->reloc_count + 1);
+    if (code->bytes == NULL || code->relocs == NULL){
+        err("memory allocation failed");
+    }
+    memcpy(code->bytes, p, code->size);
+    memcpy(code->relocs, p + code->size, sizeof(struct jit_reloc) * code->reloc_count);
+    if (jit_relocate(code) != 0){
+        free(code->bytes);
+        free(code->relocs);
+        *code = (struct code_buffer){NULL, 0, 0, NULL, 0, 0};
+        return -1;
+    }
+    return 0;
+}
+
+// 機器碼先寫入可寫頁面，完成後改為唯讀可執行（W^X）
+static jit_fn jit_load(struct code_buffer *code){
+    void *mem = mmap(NULL, code->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED){
+        err("mmap failed");
+    }
+    memcpy(mem, code->bytes, code->size);
+    free(code->bytes);
+    free(code->relocs);
+    code->bytes = NULL;
+    code->relocs = NULL;
+    if (mprotect(mem, code->size, PROT_READ | PROT_EXEC) != 0){
+        err("mprotect failed");
+    }
+    return (jit_fn)mem;
+}
+
+// 載入整個程式的機器碼並以紙帶開頭執行（jit_emit() 的結果或從快取讀回的機器碼）
+static inline void jit_execute(struct code_buffer *code){
+    jit_fn fn = jit_load(code);
+
+    // 紙帶與解譯器相同，由 tape_alloc() 配置；越界時由保護頁觸發 SIGSEGV 回報位置
+    fn(bf_tape.cells);
+
+    munmap((void *)fn, code->size);
+}
+
+#ifdef BF_HAVE_TIERED
+// 分層執行：把 start 的 [ 到對應 ] 的整個迴圈編譯成原生函式（宣告在 tier.h）
+static tier_fn tier_compile(const struct program *prog, int start, size_t *size){
+    struct code_buffer code = {NULL, 0, 0, NULL, 0, 0};
+    jit_emit(prog, start, prog->ops[start].arg, &code);
+    *size = code.size;
+    return jit_load(&code);
+}
+
+static void tier_free(const struct program *prog){
+    for (int i = 0; i < prog->size; i++){
+        if (tier.code[i] != NULL){
+            munmap((void *)tier.code[i], tier.code_size[i]);
+        }
+    }
+    free(tier.code);
+    free(tier.code_size);
+    free(tier.backedges);
+}
+#endif
+
+#endif
@@ -4,24 +4,44 @@
 #include <stddef.h>
 #include <string.h>
 #include "../util.h"
+#include "../bf_ir.h"
+#include "../bf_scan.h"
+#include "../bf_io.h"
+#include "../bf_tape.h"
+#include "../bf_cache.h"
+#include "../bf_bytecode.h"
+#include "../bf_source.h"
+#include "profile.h"
+#include "tier.h"
 #include <ctype.h>
 
 
 
+// 讀取第 i 格的數值，儲存格寬度由 bf_tape.cell_bytes 決定（只供除錯輸出使用）
+static unsigned long long cell_at(const void *tape, long i){
+    switch (bf_tape.cell_bytes) {
+        case 2: return ((const uint16_t *)tape)[i];
+        case 4: return ((const uint32_t *)tape)[i];
+        case 8: return ((const uint64_t *)tape)[i];
+        default: return ((const uint8_t *)tape)[i];
+    }
+}
+
 // 除錯輸出：顯示指令計數器、當前指令、資料指標與記憶體視窗
-static void debug_print_state(int ip, char instr, const uint8_t *tape, const uint8_t *ptr, int window){
-    int dp = (int)(ptr - tape);
+static void debug_print_state(int ip, char instr, const void *tape, long dp, int window){
+    long last = (long)bf_tape.size - 1;
     if (dp < 0) dp = 0;
-    if (dp > 29999) dp = 29999;
-    int start = dp - window;
-    int end = dp + window;
+    if (dp > last) dp = last;
+    long start = dp - window;
+    long end = dp + window;
     if (start < 0) start = 0;
-    if (end > 29999) end = 29999;
+    if (end > last) end = last;
 
-	// 產生可讀的字元顯示
+	// 產生可讀的字元顯示（寬儲存格以低 8 位元顯示，與 `.` 的輸出相同）
 	char chbuf[8];
 	const char *chrepr;
-	unsigned v = (unsigned)*ptr;
+	unsigned long long val = cell_at(tape, dp);
+	unsigned v = (unsigned)(val & 0xFFu);
 	if (v == 0) {
 		chrepr = "\\0";
 	} else if (v == '\n') {
@@ -35,298 +55,154 @@ static void debug_print_state(int ip, char instr, const uint8_t *tape, const uin
 		chbuf[1] = '\0';
 		chrepr = chbuf;
 	} else {
-		snprintf(chbuf, sizeof(chbuf), "\\x%02X", v & 0xFFu);
+		snprintf(chbuf, sizeof(chbuf), "\\x%02X", v);
 		chrepr = chbuf;
 	}
 
-	fprintf(stderr, "[DEBUG] ip=%d instr=%c dp=%d val=%u ch='%s' | tape[%d..%d]: ",
-	        ip, instr, dp, v, chrepr, start, end);
-    for (int i = start; i <= end; ++i){
+	fprintf(stderr, "[DEBUG] ip=%d instr=%c dp=%ld val=%llu ch='%s' | tape[%ld..%ld]: ",
+	        ip, instr, dp, val, chrepr, start, end);
+    for (long i = start; i <= end; ++i){
         if (i == dp){
-            fprintf(stderr, "[%u] ", (unsigned)tape[i]);
+            fprintf(stderr, "[%llu] ", cell_at(tape, i));
         }else{
-            fprintf(stderr, "%u ", (unsigned)tape[i]);
+            fprintf(stderr, "%llu ", cell_at(tape, i));
         }
     }
     fprintf(stderr, "\n");
 }
 
 
-// 計算連續相同字元的數量
-int continuous_count(const char *p){
-    int count = 0;
-    char first = *p;
-    while (*p == first && *p != '\0') {
-        count++;
-        p++;
-    }
-    return count;
-}
-
-//Clear loops & Copy loops & Multiplication loops optimization
-int check_loops(char *p,int *index,int *mult){
-    int res,offset=0,_index=0;
-    if (*(p+1)!='-') return -1;
-    p+=2;
-    while (*p!=']'){
-        if (*p=='[' || *p=='-' || *p=='.' || *p==',') {
-            return -1;
-        }
-        res=continuous_count(p);
-        if (*p=='>') {
-            offset+=res;
-        }
-        else if (*p=='<') {
-            offset-=res;
-        }
-        else if (*p=='+'){
-            index[_index]=offset;
-            mult[_index]=res;
-            _index++;
-        }
-        p+=res;
-    }
-    if (offset!=0) return -1;
-    return _index;
-}
-
-// Scan loops optimization: 檢測 [>]、[<]、[>>>] 等模式
-// 返回值：0 表示不是 scan loop，正數表示向右移動步數，負數表示向左移動步數
-int check_scan_loop(const char *p) {
-    if (*p != '[') return 0;
-    p++; // 跳過 '['
-    
-    // 檢查循環內只有 > 或 <
-    if (*p != '>' && *p != '<') return 0;
-    
-    char direction = *p;
-    int step = 0;
-    
-    while (*p == direction) {
-        step++;
-        p++;
-    }
-    
-    // 必須以 ] 結束，且中間沒有其他指令
-    if (*p != ']') return 0;
-    
-    // 返回移動步數（正數向右，負數向左）
-    return (direction == '>') ? step : -step;
-}
+// 預設使用 GCC/Clang 的 labels-as-values 做 threaded dispatch：
+// 每個 handler 結尾各自間接跳到下一個 handler，而非共用 switch 的單一分支。
+// 以 -DBF_NO_COMPUTED_GOTO 編譯（或非 GNU 編譯器）則退回 switch
+#if defined(__GNUC__) && !defined(BF_NO_COMPUTED_GOTO)
+#define BF_COMPUTED_GOTO 1
+#endif
 
-// 移除換行符號和非指令字符
-// 只保留 Brainfuck 的有效指令：><+-.,[]
-// 這樣可以避免連續指令被換行截斷
-char* remove_non_instructions(const char *input) {
-    if (input == NULL) return NULL;
-    
-    // 計算需要的空間（最多與原字串相同長度）
-    size_t len = strlen(input);
-    char *output = (char*)malloc(len + 1);
-    if (output == NULL) return NULL;
-    
-    size_t j = 0;
-    for (size_t i = 0; i < len; i++) {
-        char c = input[i];
-        // 只保留有效的 Brainfuck 指令
-        if (c == '>' || c == '<' || c == '+' || c == '-' || 
-            c == '.' || c == ',' || c == '[' || c == ']') {
-            output[j++] = c;
-        }
-        // 其他字符（包括換行、空格、註解等）都忽略
-    }
-    output[j] = '\0';
-    
-    return output;
-}
+// 每種儲存格寬度各自展開一套引擎（engine.h）：scan_N、run_fast_N、run_debug_N、run_profile_N、run_tiered_N，
+// 執行迴圈本體定義在 exec_loop.h，除錯版本與一般版本各自成為獨立的迴圈，run_fast_N() 內完全沒有除錯判斷
+#define CELL_BITS 8
+#include "engine.h"
+#define CELL_BITS 16
+#include "engine.h"
+#define CELL_BITS 32
+#include "engine.h"
+#define CELL_BITS 64
+#include "engine.h"
 
+#include "jit_x86_64.h"
 
-void interpret(const char *const input, int debug, int debug_window){
+typedef void (*run_fn)(const struct program *prog, const char *const input, int debug_window);
 
-    //initialize the tape with 30000 zeroes
-    uint8_t tape[30000]={0};
+enum engine_mode {
+    MODE_FAST,
+    MODE_DEBUG,
+    MODE_PROFILE,   // profile_init() 必須先配置好統計陣列
+    MODE_TIERED,    // tier_init() 必須先配置好迴圈狀態
+    MODE_COUNT,
+};
 
-    //set the pointer to the left most cell of the tape
-    uint8_t *ptr=tape;
+#ifdef BF_HAVE_TIERED
+#define RUN_TIERED_FN(bits) run_tiered_##bits
+#else
+#define RUN_TIERED_FN(bits) NULL
+#endif
 
-    char current_char;
-	int last_stdout_char = '\n'; // 追蹤最近一次 stdout 字元，預設視為已換行
-    for (int i=0;(current_char=input[i])!='\0';++i){
-        switch (current_char) {
-            case '>':
-                {
-                    int count = continuous_count(&input[i]);
-                    ptr += count;
-                    i += count - 1;  // -1 因為 for 迴圈會 ++i
-                    // ++ptr;
-                    break;
-                }
-            case '<':
-                {
-                    int count = continuous_count(&input[i]);
-                    ptr -= count;
-                    i += count - 1;
-                    // --ptr;
-                break;
-                }
-            case '+':
-            {
-                
-                int count = continuous_count(&input[i]);
-                *ptr += count;  // 直接加，不用迴圈
-                i += count - 1;
-                
-                break;
-            }
-            case '-':{
-               
-                int count=continuous_count(&input[i]);
-                *ptr -= count;  // 直接減，不用迴圈
-                i += count - 1;
-                
-                break;
-            }
-            case '.':
-				putchar(*ptr);
-				fflush(stdout);
-				last_stdout_char = *ptr;
-                break;
-            case ',':
-				*ptr=getchar();
-                break;
-            case '[':
-                {
-                    // 先檢查是否為 Scan loop ([>], [<], [>>>] 等)
-                    int scan_step = check_scan_loop(&input[i]);
-                    
-                    if (scan_step != 0 && *ptr != 0) {
-                        // Scan loop 優化
-                        if (scan_step > 0) {
-                            // 向右掃描 [>], [>>] 等
-                            // 使用 memchr 快速找到值為 0 的位置
-                            uint8_t *result;
-                            uint8_t *search_ptr = ptr;
-                            const uint8_t *tape_end = tape + 30000;
-                            
-                            while (search_ptr < tape_end) {
-                                size_t remaining = tape_end - search_ptr;
-                                result = memchr(search_ptr, 0, remaining);
-                                if (result == NULL) {
-                                    // 沒找到，移動到最後
-                                    ptr = (uint8_t*)tape_end - 1;
-                                    break;
-                                }
-                                
-                                // 檢查是否在正確的步長位置上
-                                ptrdiff_t offset = result - ptr;
-                                if (offset % scan_step == 0) {
-                                    ptr = result;
-                                    break;
-                                }
-                                // 否則繼續從下一個位置搜尋
-                                search_ptr = result + 1;
-                            }
-                        } else {
-                            // 向左掃描 [<], [<<] 等
-                            int step = -scan_step;
-                            const uint8_t *tape_start = tape;
-                            
-                            // 反向查找第一個 0（按步長）
-                            while (ptr > tape_start && *ptr != 0) {
-                                ptr -= step;
-                                if (ptr < tape_start) {
-                                    ptr = (uint8_t*)tape_start;
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        // 跳到對應的 ]
-                        int loop = 1;
-                        while (loop > 0) {
-                            current_char = input[++i];
-                            if (current_char == ']') {
-                                --loop;
-                            }
-                            else if (current_char == '[') {
-                                ++loop;
-                            }
-                        }
-                    }
-                    else {
-                        // 嘗試優化循環（清零、複製、乘法循環）
-                        int index[100], mult[100];
-                        int loop_info = check_loops((char*)&input[i], index, mult);
-                        
-                        if (loop_info >= 0 && *ptr != 0) {
-                            // 可以優化的循環
-                            for (int j = 0; j < loop_info; j++) {
-                                ptr[index[j]] += *ptr * mult[j];
-                            }
-                            *ptr = 0;  // 清零當前單元格
-                            
-                            // 跳到對應的 ]
-                            int loop = 1;
-                            while (loop > 0) {
-                                current_char = input[++i];
-                                if (current_char == ']') {
-                                    --loop;
-                                }
-                                else if (current_char == '[') {
-                                    ++loop;
-                                }
-                            }
-                        }
-                        else if (!(*ptr)) {
-                            // 如果當前單元格為0，跳過整個循環
-                            int loop = 1;
-                            while (loop > 0) {
-                                current_char = input[++i];
-                                if (current_char == ']') {
-                                    --loop;
-                                }
-                                else if (current_char == '[') {
-                                    ++loop;
-                                }
-                            }
-                        }
-                        // 否則正常執行循環（不做任何事，讓程式繼續執行）
-                    }
-                }
-                break;
+static const struct engine {
+    int cell_bits;
+    run_fn run[MODE_COUNT];
+} engines[] = {
+    {8,  {run_fast_8,  run_debug_8,  run_profile_8,  RUN_TIERED_FN(8)}},
+    {16, {run_fast_16, run_debug_16, run_profile_16, RUN_TIERED_FN(16)}},
+    {32, {run_fast_32, run_debug_32, run_profile_32, RUN_TIERED_FN(32)}},
+    {64, {run_fast_64, run_debug_64, run_profile_64, RUN_TIERED_FN(64)}},
+};
 
-            case ']':
-                if (*ptr){
-                    int loop=1;
-                    while (loop>0){
-                        current_char=input[--i];
-                        if (current_char=='['){
-                            --loop;
-                        }
-                        else if (current_char==']'){
-                            ++loop;
-                        }
-                    }
-                }
-                break;
+// 依 IR 的儲存格寬度與執行模式選擇對應的引擎
+void interpret(const struct program *prog, const char *const input, enum engine_mode mode, int debug_window){
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++){
+        if (engines[i].cell_bits == prog->cell_bits && engines[i].run[mode] != NULL){
+            engines[i].run[mode](prog, input, debug_window);
+            return;
         }
-        if (debug){
-			// 確保除錯輸出與正常輸出分行，避免混寫在同一列
-			if (last_stdout_char != '\n') {
-				fputc('\n', stderr);
-				last_stdout_char = '\n';
-			}
-			debug_print_state(i, current_char, tape, ptr, debug_window);
+    }
+    err("unsupported cell width");
+}
+
+// 取得 IR：快取命中時直接讀回，否則解析、最佳化並存入快取（cache 為 NULL 時不使用快取）
+static struct program load_program(struct cache *cache, struct cache_key key, struct source *src, unsigned mask, int cell_bits){
+    struct program prog;
+    size_t size;
+    void *data = cache ? cache_load(cache, key, "ir", &size) : NULL;
+    if (data != NULL && bfc_view(data, size, &prog) == NULL){
+        // 快取項目是 .bfc 映像，複製出 op 陣列讓呼叫端照常 free_program()
+        struct op *ops = malloc(sizeof(struct op) * (size_t)prog.size);
+        if (ops == NULL){
+            err("memory allocation failed");
         }
+        memcpy(ops, prog.ops, sizeof(struct op) * (size_t)prog.size);
+        prog.ops = ops;
+        prog.capacity = prog.size;
+        free(data);
+        return prog;
     }
+    free(data);
+    prog = compile_source(src, mask, cell_bits);
+    if (cache != NULL){
+        data = bfc_image(&prog, mask, &size);
+        cache_store(cache, key, "ir", data, size);
+        free(data);
+    }
+    return prog;
 }
 
+#ifdef BF_HAVE_JIT
+// 取得整個程式的機器碼：快取命中時讀回並重新填入函式位址，否則編譯並存入快取
+static void load_jit_code(struct cache *cache, struct cache_key key, struct source *src, unsigned mask, int cell_bits,
+                          struct code_buffer *code){
+    size_t size;
+    void *data = cache ? cache_load(cache, key, "jit", &size) : NULL;
+    if (data != NULL && jit_unpack(data, size, code) == 0){
+        free(data);
+        return;
+    }
+    free(data);
+    struct program prog = compile_source(src, mask, cell_bits);
+    jit_emit(&prog, 0, prog.size - 1, code);
+    free_program(&prog);
+    if (cache != NULL){
+        data = jit_pack(code, &size);
+        cache_store(cache, key, "jit", data, size);
+        free(data);
+    }
+}
+#endif
+
+#define USAGE "Usage: interpreter [-d|--debug] [-w|--debug-window N] [--passes LIST] [--jit] [--tiered] [--tier-threshold N] [--unbuffered] [--output-buffer N] [--tape-size N] [--cell-bits 8|16|32|64] [--count-ops] [--profile] [--cache] [--cache-dir DIR] [--cache-size N] [--cache-stats] [--emit-bfc FILE] <inputfile|file.bfc>"
+
 int main(int argc,char *argv[]){
     int debug = 0;
 	int debug_window = 8;
+    unsigned passes_mask = PASS_ALL;
+    int passes_given = 0;
+    int jit = 0;
+    int tiered = 0;
+    long tier_threshold = 0;
+    int unbuffered = 0;
+    size_t output_buffer = BF_OUTPUT_BUFFER_DEFAULT;
+    size_t tape_size = BF_TAPE_DEFAULT;
+    int cell_bits = 8;
+    int cell_bits_given = 0;
+    int count_ops = 0;
+    int profiling = 0;
+    int use_cache = 0;
+    int cache_stats = 0;
+    const char *cache_dir = NULL;
+    size_t cache_size = BF_CACHE_SIZE_DEFAULT;
+    const char *emit_bfc = NULL;
     const char *filepath = NULL;
 
-	// 參數解析：支援 -d/--debug 與 -w/--debug-window <N> 以及檔名
+	// 參數解析：支援 -d/--debug、-w/--debug-window <N>、--passes <清單>、--jit、--tiered、--tier-threshold <N>、--unbuffered、--output-buffer <N>、--tape-size <N>、--cell-bits <N>、--count-ops、--profile、--cache、--cache-dir <目錄>、--cache-size <N>、--cache-stats、--emit-bfc <檔名> 以及檔名
     for (int i = 1; i < argc; ++i){
         if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--debug") == 0){
             debug = 1;
@@ -335,31 +211,185 @@ int main(int argc,char *argv[]){
 			if (w < 1) w = 1;
 			if (w > 64) w = 64; // 合理上限
 			debug_window = w;
+        }else if (strcmp(argv[i], "--jit") == 0){
+            jit = 1;
+        }else if (strcmp(argv[i], "--tiered") == 0){
+            tiered = 1;
+        }else if (strcmp(argv[i], "--tier-threshold") == 0 && (i + 1 < argc)){
+            tiered = 1;
+            tier_threshold = atol(argv[++i]);
+            if (tier_threshold < 1 || tier_threshold > UINT32_MAX){
+                err("--tier-threshold must be a positive number");
+            }
+        }else if (strcmp(argv[i], "--unbuffered") == 0){
+            unbuffered = 1;
+        }else if (strcmp(argv[i], "--output-buffer") == 0 && (i + 1 < argc)){
+            long n = atol(argv[++i]);
+            output_buffer = n > 0 ? (size_t)n : 1;
+        }else if (strcmp(argv[i], "--tape-size") == 0 && (i + 1 < argc)){
+            tape_size = parse_size(argv[++i]);
+        }else if (strcmp(argv[i], "--cell-bits") == 0 && (i + 1 < argc)){
+            cell_bits = atoi(argv[++i]);
+            cell_bits_given = 1;
+            if (!valid_cell_bits(cell_bits)){
+                err("--cell-bits must be 8, 16, 32 or 64");
+            }
+        }else if (strcmp(argv[i], "--count-ops") == 0){
+            count_ops = 1;
+        }else if (strcmp(argv[i], "--profile") == 0){
+            profiling = 1;
+        }else if (strcmp(argv[i], "--cache") == 0){
+            use_cache = 1;
+        }else if (strcmp(argv[i], "--cache-dir") == 0 && (i + 1 < argc)){
+            use_cache = 1;
+            cache_dir = argv[++i];
+        }else if (strcmp(argv[i], "--cache-size") == 0 && (i + 1 < argc)){
+            use_cache = 1;
+            cache_size = parse_size(argv[++i]);
+        }else if (strcmp(argv[i], "--cache-stats") == 0){
+            use_cache = 1;
+            cache_stats = 1;
+        }else if (strcmp(argv[i], "--emit-bfc") == 0 && (i + 1 < argc)){
+            emit_bfc = argv[++i];
+        }else if (strcmp(argv[i], "--passes") == 0 && (i + 1 < argc)){
+            passes_mask = parse_pass_list(argv[++i]);
+            passes_given = 1;
         }else if (filepath == NULL){
             filepath = argv[i];
         }else{
-			err("Usage: interpreter [-d|--debug] [-w|--debug-window N] <inputfile>");
+			err(USAGE);
         }
     }
     if (filepath == NULL){
-		err("Usage: interpreter [-d|--debug] [-w|--debug-window N] <inputfile>");
+		err(USAGE);
+    }
+
+    // 除錯模式預設不做位移折疊，讓顯示的指標位置與原始碼一致
+    if (debug && !passes_given){
+        passes_mask &= ~PASS_OFFSETS;
+    }
+
+    // .bfc 是已最佳化的位元組碼：直接映射執行，儲存格寬度取自檔案，沒有原始碼可供除錯與分析顯示
+    int bytecode = bfc_is_file(filepath);
+    if (bytecode && emit_bfc != NULL){
+        err("--emit-bfc needs a source file");
+    }
+    if (bytecode && (debug || profiling)){
+        err("--debug and --profile need the source file, not a .bfc file");
+    }
+
+    struct program prog = {NULL, 0, 0, cell_bits};
+    void *image = NULL;
+    size_t image_size = 0;
+    struct source src;
+    if (bytecode){
+        image = bfc_map(filepath, &prog, &image_size);
+        if (cell_bits_given && cell_bits != prog.cell_bits){
+            err("--cell-bits does not match the .bfc file");
+        }
+        cell_bits = prog.cell_bits;
+    }else{
+        if (source_open(&src, filepath) != 0){
+            err("can't open file");
+        }
+        // 除錯輸出與熱點報告以位置查詢原始碼；一般執行時 pipe 進來的程式邊讀邊解析，不保留原始碼
+        if (debug || profiling){
+            source_slurp(&src);
+        }
+    }
+    const char *file_content = bytecode ? NULL : src.text;
+
+    // --emit-bfc：只做一次最佳化並寫出位元組碼，不執行
+    if (emit_bfc != NULL){
+        prog = compile_source(&src, passes_mask, cell_bits);
+        bfc_write(emit_bfc, &prog, passes_mask);
+        free_program(&prog);
+        source_close(&src);
+        return 0;
+    }
+
+    // 除錯訊息寫到 stderr，輸出必須立即寫出才能與除錯訊息正確交錯
+    output_init(unbuffered || debug ? 1 : output_buffer);
+    if (strcmp(filepath, "-") == 0){
+        input_open(-1);     // 程式本身從 stdin 讀入，`,` 一律讀到 EOF
+    }else{
+        input_init();
     }
+    tape_alloc(tape_size, (size_t)cell_bits / 8);
 
-    char *file_content=read_file(filepath);
-    if (file_content==NULL){
-        err("can't open file");
+    if ((jit || tiered) && (count_ops || profiling)){
+        err("--count-ops and --profile are not supported with --jit or --tiered");
     }
-    
-    // 移除換行符號和非指令字符，避免連續指令被截斷
-    char *cleaned_content = remove_non_instructions(file_content);
-    free(file_content);
-    
-    if (cleaned_content == NULL) {
-        err("memory allocation failed");
+    if (debug && (count_ops || profiling)){
+        err("--count-ops and --profile cannot be combined with --debug");
+    }
+    if (jit && tiered){
+        err("--jit and --tiered are mutually exclusive");
+    }
+
+    // 快取的鍵包含影響編譯結果的選項；建置時間讓重新建置的解譯器不會讀到舊版產生的 IR 或機器碼。
+    // 鍵只看指令字元，IR 中的原始碼位置可能來自排版不同的檔案，所以顯示位置的除錯與分析模式不使用快取；
+    // 鍵必須在解析之前算出，pipe 進來的程式（file_content 為 NULL）也不使用快取
+    struct cache cache;
+    struct cache *cachep = NULL;
+    struct cache_key key = {0, 0};
+    if (use_cache && file_content != NULL && !debug && !count_ops && !profiling && cache_open(&cache, cache_dir, cache_size) == 0){
+        char options[128];
+        snprintf(options, sizeof(options), "passes=%x cell_bits=%d build=%s %s", passes_mask, cell_bits, __DATE__, __TIME__);
+        cachep = &cache;
+        key = cache_key(file_content, src.size, jit && !debug ? "jit" : "interpreter", options);
+    }
+
+    if (jit && !debug){
+#ifdef BF_HAVE_JIT
+        struct code_buffer code = {NULL, 0, 0, NULL, 0, 0};
+        if (bytecode){
+            jit_emit(&prog, 0, prog.size - 1, &code);
+        }else{
+            load_jit_code(cachep, key, &src, passes_mask, cell_bits, &code);
+        }
+        jit_execute(&code);
+#else
+        err("--jit is only supported on x86-64 Linux");
+#endif
+    }else if (tiered && !debug){
+#ifdef BF_HAVE_TIERED
+        if (!bytecode){
+            prog = load_program(cachep, key, &src, passes_mask, cell_bits);
+        }
+        tier_init(&prog, tier_threshold ? (uint32_t)tier_threshold : BF_TIER_THRESHOLD_DEFAULT);
+        interpret(&prog, file_content, MODE_TIERED, debug_window);
+        tier_free(&prog);
+#else
+        err("--tiered is only supported on x86-64 Linux");
+#endif
+    }else{
+        if (!bytecode){
+            prog = load_program(cachep, key, &src, passes_mask, cell_bits);
+        }
+        if (count_ops || profiling){
+            profile_init(&prog);
+        }
+        interpret(&prog, file_content, debug ? MODE_DEBUG : count_ops || profiling ? MODE_PROFILE : MODE_FAST, debug_window);
+    }
+    output_flush();
+    if (count_ops){
+        fprintf(stderr, "executed ops: %llu\n", (unsigned long long)profile_total(&prog));
+    }
+    if (profiling){
+        profile_report(&prog, file_content, stderr);
+    }
+    if (cachep != NULL){
+        cache_close(cachep, cache_stats ? stderr : NULL);
+    }
+    profile_free();
+    tape_free();
+    if (image != NULL){
+        bfc_unmap(image, image_size);
+    }else{
+        free_program(&prog);
+        source_close(&src);
     }
-    
-	interpret(cleaned_content, debug, debug_window);
-    free(cleaned_content);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,203 @@
+// 熱點迴圈分析（--profile）與指令計數（--count-ops）：
+// run_profile_N 對每個 IR 指令記錄執行次數（hits）與分支 / 快速路徑的統計（taken）：
+//   OP_JZ   - 迴圈整個被跳過的次數
+//   OP_JNZ  - 跳回迴圈開頭的次數
+//   OP_SCAN - 掃描前進的步數
+//   OP_MUL  - 計數格為 0、整個線性迴圈被跳過的次數
+// 結束時依迴圈（含內層）執行的指令數排序，輸出熱點迴圈、走的是哪一種快速路徑以及原始碼片段。
+#ifndef BF_PROFILE_H
+#define BF_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../bf_ir.h"
+
+#define PROFILE_TOP 30          // 報告最多列出的迴圈數
+#define PROFILE_SNIPPET 48      // 原始碼片段的最大長度
+
+static struct {
+    uint64_t *hits;
+    uint64_t *taken;
+} profile;
+
+static void profile_init(const struct program *prog){
+    profile.hits = calloc((size_t)prog->size, sizeof(uint64_t));
+    profile.taken = calloc((size_t)prog->size, sizeof(uint64_t));
+    if (profile.hits == NULL || profile.taken == NULL){
+        err("memory allocation failed");
+    }
+}
+
+static void profile_free(void){
+    free(profile.hits);
+    free(profile.taken);
+    profile.hits = profile.taken = NULL;
+}
+
+static uint64_t profile_ops(int first, int last){
+    uint64_t sum = 0;
+    for (int i = first; i <= last; i++){
+        sum += profile.hits[i];
+    }
+    return sum;
+}
+
+// 執行過的 IR 指令總數（不含結尾的 OP_END）
+static uint64_t profile_total(const struct program *prog){
+    return profile_ops(0, prog->size - 2);
+}
+
+// 從 i 開始的迴圈最後一個 IR 指令；i 不是迴圈開頭時回傳 -1
+static int profile_loop_end(const struct program *prog, int i){
+    const struct op *op = &prog->ops[i];
+    switch (op->type) {
+        case OP_JZ:
+            return op->arg;
+        case OP_MUL:
+            return i + op->arg + 1;
+        case OP_SCAN:
+            return i;
+        case OP_CLEAR:
+            // 線性迴圈結尾的 OP_CLEAR 屬於前面的 OP_MUL
+            return i > 0 && prog->ops[i - 1].type == OP_MUL_ADD ? -1 : i;
+        default:
+            return -1;
+    }
+}
+
+struct profile_loop {
+    const char *kind;       // loop / inner / clear / scan / mul
+    uint64_t executions;    // 進入迴圈的次數
+    uint64_t iterations;    // 迴圈體執行次數（scan 為前進的步數，clear / mul 不適用）
+    uint64_t self;          // 迴圈本身執行的 IR 指令數（不含內層迴圈）
+    uint64_t ops;           // 迴圈內（含內層迴圈）執行的 IR 指令數
+    int open, close;        // 原始碼中 [ 與 ] 的位置
+};
+
+// 從 ] 的位置往回找對應的 [
+static int profile_match_open(const char *input, int close){
+    int depth = 0;
+    for (int i = close; i >= 0; i--){
+        if (input[i] == ']'){
+            depth++;
+        }else if (input[i] == '[' && --depth == 0){
+            return i;
+        }
+    }
+    return close;
+}
+
+// 原始碼片段：只保留 Brainfuck 指令，過長時截斷
+static void profile_snippet(const char *input, int open, int close, char *out, size_t size){
+    size_t n = 0;
+    for (int i = open; i <= close; i++){
+        if (input[i] == '\0' || strchr("+-<>.,[]", input[i]) == NULL){
+            continue;
+        }
+        if (n + 1 == size){
+            memcpy(out + size - 4, "...", 3);
+            break;
+        }
+        out[n++] = input[i];
+    }
+    out[n] = '\0';
+}
+
+static int profile_compare(const void *a, const void *b){
+    const struct profile_loop *x = a, *y = b;
+    if (x->self != y->self){
+        return x->self < y->self ? 1 : -1;
+    }
+    return x->open - y->open;
+}
+
+// 把每個迴圈（一般迴圈與被改寫成快速路徑的迴圈）整理成一筆，
+// 依迴圈本身執行的指令數排序輸出，內層的熱點不會被外層迴圈蓋過
+static void profile_report(const struct program *prog, const char *input, FILE *fp){
+    struct profile_loop *loops = malloc(sizeof(struct profile_loop) * (size_t)prog->size);
+    if (loops == NULL){
+        err("memory allocation failed");
+    }
+    int n = 0;
+    uint64_t total = profile_total(prog);
+    for (int i = 0; i < prog->size; i++){
+        const struct op *op = &prog->ops[i];
+        int end = profile_loop_end(prog, i);
+        if (end < 0 || profile.hits[i] == 0){
+            continue;
+        }
+        struct profile_loop *l = &loops[n++];
+        l->executions = profile.hits[i];
+        l->iterations = 0;
+        l->ops = profile_ops(i, end);
+        l->self = l->ops;
+        // 扣掉直接內層迴圈的指令數；沒有內層迴圈的一般迴圈就是最佳化器還不認得的寫法
+        int inner = 1;
+        for (int j = i + 1; j < end; j++){
+            int child_end = profile_loop_end(prog, j);
+            if (child_end >= 0){
+                l->self -= profile_ops(j, child_end);
+                inner = 0;
+                j = child_end;
+            }
+        }
+        switch (op->type) {
+            case OP_JZ:
+                l->kind = inner ? "inner" : "loop";
+                l->iterations = profile.hits[i] - profile.taken[i] + profile.taken[end];
+                l->open = op->pos;
+                l->close = prog->ops[end].pos;
+                break;
+            case OP_SCAN:
+                l->kind = "scan";
+                l->iterations = profile.taken[i];
+                break;
+            case OP_MUL:
+                l->kind = "mul";
+                break;
+            default:
+                l->kind = "clear";
+                break;
+        }
+        if (op->type != OP_JZ){
+            // 快速路徑的 pos 是原本迴圈的 ]
+            l->close = op->pos;
+            l->open = profile_match_open(input, op->pos);
+        }
+    }
+    qsort(loops, (size_t)n, sizeof(struct profile_loop), profile_compare);
+
+    fprintf(fp, "profile: %llu ops executed, %d loops entered\n", (unsigned long long)total, n);
+    fprintf(fp, "%4s %9s %-5s %13s %13s %14s %6s %14s  %s\n",
+            "rank", "line:col", "kind", "executions", "iterations", "self ops", "%self", "total ops", "source");
+    for (int i = 0; i < n && i < PROFILE_TOP; i++){
+        const struct profile_loop *l = &loops[i];
+        int line = 1, col = 1;
+        for (int j = 0; j < l->open; j++){
+            if (input[j] == '\n'){
+                line++;
+                col = 1;
+            }else{
+                col++;
+            }
+        }
+        char where[24], iterations[24], snippet[PROFILE_SNIPPET + 1];
+        snprintf(where, sizeof(where), "%d:%d", line, col);
+        if (strcmp(l->kind, "clear") == 0 || strcmp(l->kind, "mul") == 0){
+            snprintf(iterations, sizeof(iterations), "-");
+        }else{
+            snprintf(iterations, sizeof(iterations), "%llu", (unsigned long long)l->iterations);
+        }
+        profile_snippet(input, l->open, l->close, snippet, sizeof(snippet));
+        fprintf(fp, "%4d %9s %-5s %13llu %13s %14llu %5.1f%% %14llu  %s\n",
+                i + 1, where, l->kind, (unsigned long long)l->executions, iterations,
+                (unsigned long long)l->self, total ? 100.0 * (double)l->self / (double)total : 0.0,
+                (unsigned long long)l->ops, snippet);
+    }
+    free(loops);
+}
+
+#endif
@@ -0,0 +1,49 @@
+// 分層執行（--tiered）：程式先由解譯器執行，run_tiered_N 在每個 ] 往回跳時累計該迴圈的次數，
+// 超過門檻就以 JIT（jit_x86_64.h 的 tier_compile()）把整個迴圈（含內層迴圈）編譯成原生函式，
+// 之後每次執行到該迴圈的 [ 都改為呼叫原生碼。原生函式為 ptr → ptr：
+// 傳入目前的資料指標，迴圈結束時回傳新的指標，紙帶、輸出 / 輸入緩衝與掃描核心都和解譯器共用，切換對程式不可見。
+#ifndef BF_TIER_H
+#define BF_TIER_H
+
+#if defined(__x86_64__) && defined(__linux__)
+#define BF_HAVE_TIERED 1
+
+#define BF_TIER_THRESHOLD_DEFAULT 1000
+
+typedef uint8_t *(*tier_fn)(uint8_t *ptr);
+
+static struct {
+    tier_fn *code;          // 以迴圈 [ 的 IR 位置為索引，尚未編譯時為 NULL
+    size_t *code_size;      // 原生碼佔用的 mmap 大小，結束時釋放
+    uint32_t *backedges;    // 每個迴圈往回跳的次數
+    uint32_t threshold;
+    int compiled;           // 已編譯的迴圈數
+} tier;
+
+// 定義在 jit_x86_64.h：把 start（OP_JZ）到對應 OP_JNZ 的迴圈編譯成原生函式
+static tier_fn tier_compile(const struct program *prog, int start, size_t *size);
+
+static void tier_init(const struct program *prog, uint32_t threshold){
+    tier.code = calloc((size_t)prog->size, sizeof(tier_fn));
+    tier.code_size = calloc((size_t)prog->size, sizeof(size_t));
+    tier.backedges = calloc((size_t)prog->size, sizeof(uint32_t));
+    if (tier.code == NULL || tier.code_size == NULL || tier.backedges == NULL){
+        err("memory allocation failed");
+    }
+    tier.threshold = threshold;
+    tier.compiled = 0;
+}
+
+// ] 往回跳時呼叫：回傳 1 表示迴圈剛被編譯，呼叫端應回到 [ 改走原生碼
+static int tier_backedge(const struct program *prog, int start){
+    if (++tier.backedges[start] != tier.threshold){
+        return 0;
+    }
+    tier.code[start] = tier_compile(prog, start, &tier.code_size[start]);
+    tier.compiled++;
+    return 1;
+}
+
+#endif
+
+#endif
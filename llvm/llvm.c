@@ -1,245 +1,838 @@
+// LLVM 後端：以 LLVM C API 建構模組，不再輸出文字後重新解析。
+// 固定的執行期函式（紙帶配置與越界 handler、輸入緩衝）以一小段文字 IR 寫成，解析一次後在同一個模組中
+// 以 LLVMBuilder 產生 @main。產生的模組可以：
+//   預設        - 以文字 IR 輸出到 stdout（之後可交給 llc / clang）
+//   -O0..-O3    - 先以 new pass manager 的 default<On> 最佳化
+//   --jit       - 以 ORC LLJIT 在行程內編譯並執行（預設 -O2），不需要 clang 與新的行程
+//   --timings   - 在 stderr 回報 IR 建構、最佳化、codegen（或輸出）與執行各階段的時間
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Analysis.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm/Config/llvm-config.h>
 #include "../util.h"
+#include "../bf_ir.h"
+#include "../bf_source.h"
 
-static int count_eliminate=0;
+// 紙帶大小的預設值（格數），實際配置時向上取整到頁面大小
+#define TAPE_SIZE_DEFAULT 30000
+#define PAGE_SIZE 4096
+// 紙帶前後 PROT_NONE 保護區的大小
+#define TAPE_GUARD (1 << 20)
 
-//備註:brainfuck做dead code elimination有點多餘，因為根本不會有dead code，算是二次驗證
-char *eliminate_dead_code(char *text_body) {
-    size_t text_len=strlen(text_body);
-    char *opt=malloc(text_len+1);
-    if (opt==NULL) {
-        fprintf(stderr,"Memory allocation failed\n");
+// 指標型別的寫法：LLVM 15 起預設為 opaque pointer，一律寫成 `ptr`；
+// LLVM 14 的 opaque pointer 仍是實驗性質（LoopAccessAnalysis 會對其呼叫 getPointerElementType 而崩潰），
+// 因此沿用 typed pointer。IR_PTR_TO(t) 是指向 t 的指標，IR_PTR 即 i8* / ptr
+#if LLVM_VERSION_MAJOR >= 15
+#define IR_PTR_TO(t) "ptr"
+#else
+#define IR_PTR_TO(t) t "*"
+#endif
+#define IR_PTR IR_PTR_TO("i8")
+#define IR_SEGV_HANDLER IR_PTR_TO("void (i32, " IR_PTR ", " IR_PTR ")")
+
+// 執行期函式用到的 C 函式庫宣告
+static const char * const runtime_declarations =
+    "declare i64 @lseek(i32, i64, i32)\n"
+    "declare i64 @read(i32, " IR_PTR ", i64)\n"
+    "declare i64 @write(i32, " IR_PTR ", i64)\n"
+    "declare " IR_PTR " @mmap(" IR_PTR ", i64, i32, i32, i32, i64)\n"
+    "declare i32 @mprotect(" IR_PTR ", i64, i32)\n"
+    "declare i32 @sigaction(i32, " IR_PTR ", " IR_PTR ")\n"
+    "declare void @_exit(i32)\n"
+    "declare " IR_PTR " @memchr(" IR_PTR ", i32, i64)\n"
+    "declare " IR_PTR " @memrchr(" IR_PTR ", i32, i64)\n";
+
+// 輸出執行期函式：. 寫進 64 KiB 的 @bf_out_buf，滿了、等待輸入前與結束時由 @bf_flush 以 write(2) 寫出
+// （不經過 stdio，越界的 SIGSEGV handler 也能安全地送出已緩衝的輸出）。寫入失敗時丟棄剩下的內容
+static const char * const output_runtime =
+    "@bf_out_buf = internal global [65536 x i8] zeroinitializer\n"
+    "@bf_out_len = internal global i64 0\n"
+    "\n"
+    "define internal void @bf_flush() {\n"
+    "entry:\n"
+    "  %len = load i64, " IR_PTR_TO("i64") " @bf_out_len\n"
+    "  %buf = getelementptr inbounds [65536 x i8], " IR_PTR_TO("[65536 x i8]") " @bf_out_buf, i64 0, i64 0\n"
+    "  br label %loop\n"
+    "loop:\n"
+    "  %done = phi i64 [ 0, %entry ], [ %next, %wrote ]\n"
+    "  %more = icmp slt i64 %done, %len\n"
+    "  br i1 %more, label %write, label %end\n"
+    "write:\n"
+    "  %p = getelementptr i8, " IR_PTR " %buf, i64 %done\n"
+    "  %rest = sub i64 %len, %done\n"
+    "  %n = call i64 @write(i32 1, " IR_PTR " %p, i64 %rest)\n"
+    "  %ok = icmp sgt i64 %n, 0\n"
+    "  br i1 %ok, label %wrote, label %end\n"
+    "wrote:\n"
+    "  %next = add i64 %done, %n\n"
+    "  br label %loop\n"
+    "end:\n"
+    "  store i64 0, " IR_PTR_TO("i64") " @bf_out_len\n"
+    "  ret void\n"
+    "}\n"
+    "\n"
+    "define internal void @bf_putchar(i8 %c) {\n"
+    "entry:\n"
+    "  %len = load i64, " IR_PTR_TO("i64") " @bf_out_len\n"
+    "  %slot = getelementptr inbounds [65536 x i8], " IR_PTR_TO("[65536 x i8]") " @bf_out_buf, i64 0, i64 %len\n"
+    "  store i8 %c, " IR_PTR " %slot\n"
+    "  %next = add i64 %len, 1\n"
+    "  store i64 %next, " IR_PTR_TO("i64") " @bf_out_len\n"
+    "  %full = icmp eq i64 %next, 65536\n"
+    "  br i1 %full, label %flush, label %done\n"
+    "flush:\n"
+    "  call void @bf_flush()\n"
+    "  br label %done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n";
+
+// 輸入執行期函式：stdin 為一般檔案時 mmap 整個檔案，`,` 只是指標遞增；
+// 否則（pipe、tty，lseek 會失敗）以 read 一次讀入 64 KiB 區塊。讀完時回傳 -1，與 getchar 的 EOF 相同。
+// 以 lseek(SEEK_END) 取得檔案大小，mmap 失敗時把檔案位置移回原處。
+static const char * const input_runtime =
+    "@bf_in_buf = internal global [65536 x i8] zeroinitializer\n"
+    "@bf_in_pos = internal global " IR_PTR " null\n"
+    "@bf_in_end = internal global " IR_PTR " null\n"
+    "@bf_in_mapped = internal global i1 false\n"
+    "\n"
+    "define internal void @bf_input_init() {\n"
+    "entry:\n"
+    "  %cur = call i64 @lseek(i32 0, i64 0, i32 1)\n"
+    "  %seekable = icmp sge i64 %cur, 0\n"
+    "  br i1 %seekable, label %size, label %done\n"
+    "size:\n"
+    "  %end = call i64 @lseek(i32 0, i64 0, i32 2)\n"
+    "  %has_data = icmp sgt i64 %end, %cur\n"
+    "  br i1 %has_data, label %map, label %restore\n"
+    "map:\n"
+    "  %base = call " IR_PTR " @mmap(" IR_PTR " null, i64 %end, i32 1, i32 2, i32 0, i64 0)\n"
+    "  %failed = icmp eq " IR_PTR " %base, inttoptr (i64 -1 to " IR_PTR ")\n"
+    "  br i1 %failed, label %restore, label %mapped\n"
+    "mapped:\n"
+    "  %pos = getelementptr i8, " IR_PTR " %base, i64 %cur\n"
+    "  %lim = getelementptr i8, " IR_PTR " %base, i64 %end\n"
+    "  store " IR_PTR " %pos, " IR_PTR_TO(IR_PTR) " @bf_in_pos\n"
+    "  store " IR_PTR " %lim, " IR_PTR_TO(IR_PTR) " @bf_in_end\n"
+    "  store i1 true, " IR_PTR_TO("i1") " @bf_in_mapped\n"
+    "  ret void\n"
+    "restore:\n"
+    "  call i64 @lseek(i32 0, i64 %cur, i32 0)\n"
+    "  br label %done\n"
+    "done:\n"
+    "  ret void\n"
+    "}\n"
+    "\n"
+    "define internal i32 @bf_getchar() {\n"
+    "entry:\n"
+    "  %pos = load " IR_PTR ", " IR_PTR_TO(IR_PTR) " @bf_in_pos\n"
+    "  %end = load " IR_PTR ", " IR_PTR_TO(IR_PTR) " @bf_in_end\n"
+    "  %avail = icmp ult " IR_PTR " %pos, %end\n"
+    "  br i1 %avail, label %take, label %refill\n"
+    "take:\n"
+    "  %p = phi " IR_PTR " [ %pos, %entry ], [ %buf, %filled ]\n"
+    "  %c = load i8, " IR_PTR " %p\n"
+    "  %next = getelementptr i8, " IR_PTR " %p, i64 1\n"
+    "  store " IR_PTR " %next, " IR_PTR_TO(IR_PTR) " @bf_in_pos\n"
+    "  %r = zext i8 %c to i32\n"
+    "  ret i32 %r\n"
+    "refill:\n"
+    "  %mapped = load i1, " IR_PTR_TO("i1") " @bf_in_mapped\n"
+    "  br i1 %mapped, label %eof, label %read\n"
+    "read:\n"
+    "  call void @bf_flush()\n"  // 可能等待輸入前先送出提示文字
+    "  %buf = getelementptr inbounds [65536 x i8], " IR_PTR_TO("[65536 x i8]") " @bf_in_buf, i64 0, i64 0\n"
+    "  %n = call i64 @read(i32 0, " IR_PTR " %buf, i64 65536)\n"
+    "  %got = icmp sgt i64 %n, 0\n"
+    "  br i1 %got, label %filled, label %eof\n"
+    "filled:\n"
+    "  %lim = getelementptr i8, " IR_PTR " %buf, i64 %n\n"
+    "  store " IR_PTR " %lim, " IR_PTR_TO(IR_PTR) " @bf_in_end\n"
+    "  br label %take\n"
+    "eof:\n"
+    "  ret i32 -1\n"
+    "}\n";
+
+// 紙帶越界的 SIGSEGV handler：si_addr（siginfo 位移 16）減去紙帶起點，再右移 @bf_cell_shift 即為越界的格子位置，
+// 送出已緩衝的輸出後回報位置並以狀態 1 結束。與 bf_tape.h 相同只用 write(2)（async-signal-safe）：
+// 訊息在堆疊上的緩衝區組好（@bf_append 複製字串、@bf_append_long 寫入十進位數字）後一次寫出
+static const char * const tape_runtime =
+    "@bf_tape = internal global " IR_PTR " null\n"
+    "@bf_tape_size = internal constant i64 0\n"      // 格數，由 build_module() 設定初始值
+    "@bf_cell_shift = internal constant i64 0\n"     // log2(每格位元組數)
+    "@bf_segv_prefix = private constant [20 x i8] c\"tape overflow: cell \"\n"
+    "@bf_segv_middle = private constant [25 x i8] c\" is outside the tape [0, \"\n"
+    "@bf_segv_suffix = private constant [2 x i8] c\")\\0A\"\n"
+    "@bf_tape_error = private constant [28 x i8] c\"unable to allocate the tape\\0A\"\n"
+    "\n"
+    // 把 src 的 n 個位元組複製到 buf + len，回傳新的長度
+    "define internal i64 @bf_append(" IR_PTR " %buf, i64 %len, " IR_PTR " %src, i64 %n) {\n"
+    "entry:\n"
+    "  br label %loop\n"
+    "loop:\n"
+    "  %i = phi i64 [ 0, %entry ], [ %next, %copy ]\n"
+    "  %more = icmp ult i64 %i, %n\n"
+    "  br i1 %more, label %copy, label %done\n"
+    "copy:\n"
+    "  %from = getelementptr i8, " IR_PTR " %src, i64 %i\n"
+    "  %c = load i8, " IR_PTR " %from\n"
+    "  %at = add i64 %len, %i\n"
+    "  %to = getelementptr i8, " IR_PTR " %buf, i64 %at\n"
+    "  store i8 %c, " IR_PTR " %to\n"
+    "  %next = add i64 %i, 1\n"
+    "  br label %loop\n"
+    "done:\n"
+    "  %end = add i64 %len, %n\n"
+    "  ret i64 %end\n"
+    "}\n"
+    "\n"
+    // 把有號整數 v 以十進位寫到 buf + len，回傳新的長度
+    "define internal i64 @bf_append_long(" IR_PTR " %buf, i64 %len, i64 %v) {\n"
+    "entry:\n"
+    "  %digits = alloca [20 x i8]\n"
+    "  %first = getelementptr inbounds [20 x i8], " IR_PTR_TO("[20 x i8]") " %digits, i64 0, i64 0\n"
+    "  %negative = icmp slt i64 %v, 0\n"
+    "  %minus = sub i64 0, %v\n"
+    "  %u = select i1 %negative, i64 %minus, i64 %v\n"
+    "  br label %loop\n"
+    "loop:\n"
+    "  %x = phi i64 [ %u, %entry ], [ %q, %loop ]\n"
+    "  %k = phi i64 [ 20, %entry ], [ %at, %loop ]\n"
+    "  %q = udiv i64 %x, 10\n"
+    "  %r = urem i64 %x, 10\n"
+    "  %r8 = trunc i64 %r to i8\n"
+    "  %digit = add i8 %r8, 48\n"
+    "  %at = sub i64 %k, 1\n"
+    "  %slot = getelementptr i8, " IR_PTR " %first, i64 %at\n"
+    "  store i8 %digit, " IR_PTR " %slot\n"
+    "  %again = icmp ne i64 %q, 0\n"
+    "  br i1 %again, label %loop, label %sign\n"
+    "sign:\n"
+    "  br i1 %negative, label %minus_sign, label %copy\n"
+    "minus_sign:\n"
+    "  %dash = getelementptr i8, " IR_PTR " %buf, i64 %len\n"
+    "  store i8 45, " IR_PTR " %dash\n"
+    "  %signed_len = add i64 %len, 1\n"
+    "  br label %copy\n"
+    "copy:\n"
+    "  %start = phi i64 [ %len, %sign ], [ %signed_len, %minus_sign ]\n"
+    "  %src = getelementptr i8, " IR_PTR " %first, i64 %at\n"
+    "  %count = sub i64 20, %at\n"
+    "  %end = call i64 @bf_append(" IR_PTR " %buf, i64 %start, " IR_PTR " %src, i64 %count)\n"
+    "  ret i64 %end\n"
+    "}\n"
+    "\n"
+    "define internal void @bf_segv(i32 %sig, " IR_PTR " %info, " IR_PTR " %context) {\n"
+    "entry:\n"
+    "  %addr_field = getelementptr i8, " IR_PTR " %info, i64 16\n"
+    "  %addr_ptr = bitcast " IR_PTR " %addr_field to " IR_PTR_TO(IR_PTR) "\n"
+    "  %addr = load " IR_PTR ", " IR_PTR_TO(IR_PTR) " %addr_ptr\n"
+    "  %tape = load " IR_PTR ", " IR_PTR_TO(IR_PTR) " @bf_tape\n"
+    "  %a = ptrtoint " IR_PTR " %addr to i64\n"
+    "  %t = ptrtoint " IR_PTR " %tape to i64\n"
+    "  %offset = sub i64 %a, %t\n"
+    "  %shift = load i64, " IR_PTR_TO("i64") " @bf_cell_shift\n"
+    "  %cell = ashr i64 %offset, %shift\n"
+    "  call void @bf_flush()\n"
+    "  %msg = alloca [128 x i8]\n"
+    "  %m = getelementptr inbounds [128 x i8], " IR_PTR_TO("[128 x i8]") " %msg, i64 0, i64 0\n"
+    "  %prefix = getelementptr inbounds [20 x i8], " IR_PTR_TO("[20 x i8]") " @bf_segv_prefix, i64 0, i64 0\n"
+    "  %middle = getelementptr inbounds [25 x i8], " IR_PTR_TO("[25 x i8]") " @bf_segv_middle, i64 0, i64 0\n"
+    "  %suffix = getelementptr inbounds [2 x i8], " IR_PTR_TO("[2 x i8]") " @bf_segv_suffix, i64 0, i64 0\n"
+    "  %size = load i64, " IR_PTR_TO("i64") " @bf_tape_size\n"
+    "  %l1 = call i64 @bf_append(" IR_PTR " %m, i64 0, " IR_PTR " %prefix, i64 20)\n"
+    "  %l2 = call i64 @bf_append_long(" IR_PTR " %m, i64 %l1, i64 %cell)\n"
+    "  %l3 = call i64 @bf_append(" IR_PTR " %m, i64 %l2, " IR_PTR " %middle, i64 25)\n"
+    "  %l4 = call i64 @bf_append_long(" IR_PTR " %m, i64 %l3, i64 %size)\n"
+    "  %l5 = call i64 @bf_append(" IR_PTR " %m, i64 %l4, " IR_PTR " %suffix, i64 2)\n"
+    "  call i64 @write(i32 2, " IR_PTR " %m, i64 %l5)\n"
+    "  call void @_exit(i32 1)\n"
+    "  unreachable\n"
+    "}\n"
+    "\n"
+    "define internal void @bf_tape_failed() {\n"
+    "entry:\n"
+    "  %msg = getelementptr inbounds [28 x i8], " IR_PTR_TO("[28 x i8]") " @bf_tape_error, i64 0, i64 0\n"
+    "  call i64 @write(i32 2, " IR_PTR " %msg, i64 28)\n"
+    "  call void @_exit(i32 1)\n"
+    "  unreachable\n"
+    "}\n"
+    "\n"
+    // 紙帶：mmap 一塊 PROT_NONE 區域，只把中間 %bytes 位元組改為可讀寫，前後各留 %guard 的保護區；
+    // 頁面在第一次寫入時才配置，初始全為 0。越界存取由 @bf_segv 回報位置，不需要逐次比較邊界
+    "define internal " IR_PTR " @bf_tape_init(i64 %bytes, i64 %guard) {\n"
+    "entry:\n"
+    "  %guards = shl i64 %guard, 1\n"
+    "  %total = add i64 %bytes, %guards\n"
+    "  %map = call " IR_PTR " @mmap(" IR_PTR " null, i64 %total, i32 0, i32 16418, i32 -1, i64 0)\n"
+    "  %map_failed = icmp eq " IR_PTR " %map, inttoptr (i64 -1 to " IR_PTR ")\n"
+    "  br i1 %map_failed, label %failed, label %mapped\n"
+    "mapped:\n"
+    "  %memory = getelementptr i8, " IR_PTR " %map, i64 %guard\n"
+    "  %protect = call i32 @mprotect(" IR_PTR " %memory, i64 %bytes, i32 3)\n"
+    "  %protect_failed = icmp ne i32 %protect, 0\n"
+    "  br i1 %protect_failed, label %failed, label %ready\n"
+    "failed:\n"
+    "  call void @bf_tape_failed()\n"
+    "  unreachable\n"
+    "ready:\n"
+    "  store " IR_PTR " %memory, " IR_PTR_TO(IR_PTR) " @bf_tape\n"
+    // struct sigaction：sa_sigaction 在位移 0，sa_flags 在位移 136（SA_SIGINFO = 4）；
+    // 以整個結構的零值 store 清空，不需要 llvm.memset
+    "  %action = alloca [152 x i8], align 8\n"
+    "  store [152 x i8] zeroinitializer, " IR_PTR_TO("[152 x i8]") " %action, align 8\n"
+    "  %action_ptr = getelementptr inbounds [152 x i8], " IR_PTR_TO("[152 x i8]") " %action, i64 0, i64 0\n"
+    "  %handler_ptr = bitcast " IR_PTR " %action_ptr to " IR_PTR_TO(IR_SEGV_HANDLER) "\n"
+    "  store " IR_SEGV_HANDLER " @bf_segv, " IR_PTR_TO(IR_SEGV_HANDLER) " %handler_ptr\n"
+    "  %flags_field = getelementptr i8, " IR_PTR " %action_ptr, i64 136\n"
+    "  %flags_ptr = bitcast " IR_PTR " %flags_field to " IR_PTR_TO("i32") "\n"
+    "  store i32 4, " IR_PTR_TO("i32") " %flags_ptr\n"
+    "  call i32 @sigaction(i32 11, " IR_PTR " %action_ptr, " IR_PTR " null)\n"
+    "  ret " IR_PTR " %memory\n"
+    "}\n";
+
+// 程式是否含有 `,`；沒有時不產生輸入執行期函式
+static int uses_input(const struct program *prog) {
+    for (int i = 0; i < prog->size; i++) {
+        if (prog->ops[i].type == OP_IN) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// LLVMErrorRef 不為成功時印出訊息並結束
+static void check_error(LLVMErrorRef error, const char *what) {
+    if (error != NULL) {
+        char *msg = LLVMGetErrorMessage(error);
+        fprintf(stderr, "%s: %s\n", what, msg);
+        LLVMDisposeErrorMessage(msg);
         exit(1);
     }
+}
 
-    size_t write_pos=0;
+// 產生 @bf_run 時的狀態
+struct codegen {
+    LLVMContextRef ctx;
+    LLVMModuleRef module;
+    LLVMBuilderRef builder;
+    LLVMValueRef run;
+    LLVMTypeRef cell;       // i8 / i16 / i32 / i64
+    LLVMTypeRef i32, i64, ptr_type;
+    LLVMValueRef ptr;       // 目前的資料指標：SSA 值，經由迴圈的 phi 傳遞，不存回記憶體
+    LLVMValueRef tape;      // 紙帶起點（@bf_run 的參數）
+    uint64_t tape_cells;    // 紙帶格數
+    int cell_bits;
+};
 
-    for (size_t i=0;i<text_len;i++) {
-        char current=text_body[i];
+// 一個迴圈：進入時的區塊與指標、迴圈體開頭的 phi 與出口
+struct loop {
+    LLVMBasicBlockRef entry, body, exit;
+    LLVMValueRef start, phi;
+};
 
-        //非brainfuck指令，直接跳過
-        if (current!='+' && current!='-' &&
-            current != '>' && current != '<' && 
-            current != '.' && current != ',' && 
-            current != '[' && current != ']') {
-                continue;
-        }
+static LLVMValueRef emit_call(struct codegen *g, const char *name, LLVMValueRef *args, unsigned n) {
+    LLVMValueRef fn = LLVMGetNamedFunction(g->module, name);
+    return LLVMBuildCall2(g->builder, LLVMGlobalGetValueType(fn), fn, args, n, "");
+}
 
-        //檢查上一個指令是否能抵銷
-        if (write_pos > 0 ){
-            char prev=opt[write_pos-1];
-
-            if ((prev=='+' && current=='-') ||
-                (prev=='-' && current=='+') ||
-                (prev=='>' && current=='<') ||
-                (prev=='<' && current=='>')) {
-                    write_pos--;
-                    count_eliminate++;
-                    continue;
-                }
-        }
+static LLVMBasicBlockRef new_block(struct codegen *g, const char *kind, int i) {
+    char name[48];
+    snprintf(name, sizeof(name), "bf_%s%d", kind, i);
+    return LLVMAppendBasicBlockInContext(g->ctx, g->run, name);
+}
+
+static LLVMValueRef const_cell(struct codegen *g, int64_t v) {
+    return LLVMConstInt(g->cell, (unsigned long long)cell_value(v, g->cell_bits), 1);
+}
 
-        opt[write_pos++]=current;
+// ptr + delta 格。不加 inbounds：越界的指標要能真的走到保護區觸發 SIGSEGV
+static LLVMValueRef emit_offset(struct codegen *g, LLVMValueRef ptr, int delta) {
+    if (delta == 0) {
+        return ptr;
     }
+    LLVMValueRef index = LLVMConstInt(g->i64, (unsigned long long)(int64_t)delta, 1);
+    return LLVMBuildGEP2(g->builder, g->cell, ptr, &index, 1, "");
+}
 
-    opt[write_pos]='\0';
-    return opt;
+// 位移折疊後，儲存格以 %ptr + 常數位移 的 GEP 存取
+static LLVMValueRef emit_cell_ptr(struct codegen *g, int offset) {
+    return emit_offset(g, g->ptr, offset);
+}
 
-} 
+static LLVMValueRef emit_cell_load(struct codegen *g, int offset) {
+    return LLVMBuildLoad2(g->builder, g->cell, emit_cell_ptr(g, offset), "");
+}
 
+// 載入 memory[ptr] 並判斷是否不為 0
+static LLVMValueRef emit_cell_nonzero(struct codegen *g) {
+    return LLVMBuildICmp(g->builder, LLVMIntNE, emit_cell_load(g, 0), const_cell(g, 0), "");
+}
 
-void compiler(const char * const text_body) {
-    int num_brackets=0;
-    int matching_brackets=0;
-    struct stack stack={.size=0,.items={0}};
-    int register_counter=0; //llvm virtual register counter
+// 8 位元、步長 ±1 的掃描迴圈（[>]、[<]）改呼叫 memchr / memrchr，由 C 函式庫的向量化實作一次比較多格。
+// 搜尋範圍到紙帶邊界為止；找不到 0 時指標停在第一個紙帶外的格子，並實際讀取它觸發越界回報，
+// 與逐格掃描走出紙帶的行為相同
+static void emit_scan_memchr(struct codegen *g, int step, int i) {
+    LLVMBasicBlockRef entry = LLVMGetInsertBlock(g->builder);
+    LLVMValueRef start = g->ptr;
+    LLVMBasicBlockRef search = new_block(g, "scan_search", i);
+    LLVMBasicBlockRef overflow = new_block(g, "scan_overflow", i);
+    LLVMBasicBlockRef end = new_block(g, "scan_end", i);
+    LLVMBuildCondBr(g->builder, emit_cell_nonzero(g), search, end);
 
-    //llvm IR code generation
-    const char * const prologue=
-    "; ModuleID = 'brainfuck'\n"
-    "source_filename = \"brainfuck\"\n"
-    "target datalayout = \"e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128\"\n"
-    "target triple = \"x86_64-pc-linux-gnu\"\n"
-    "\n"
-    "; 聲明外部 C 函數\n"
-    "declare i32 @putchar(i32)\n"
-    "declare i32 @getchar()\n"
-    "declare void @llvm.memset.p0i8.i64(i8* nocapture writeonly, i8, i64, i1 immarg)\n"
-    "\n"
-    "; Brainfuck 主函數\n"
-    "define dso_local i32 @main() {\n"
-    "entry:\n"
-    "  ; 分配 30,000 字節的記憶體數組\n"
-    "  %memory = alloca [30000 x i8], align 16\n"
-    "  \n"
-    "  ; 初始化記憶體為 0\n"
-    "  %memory_ptr = bitcast [30000 x i8]* %memory to i8*\n"
-    "  call void @llvm.memset.p0i8.i64(i8* align 16 %memory_ptr, i8 0, i64 30000, i1 false)\n"
-    "  \n"
-    "  ; 初始化指標為 0\n"
-    "  %ptr = alloca i32, align 4\n"
-    "  store i32 0, i32* %ptr, align 4\n"
-    "  \n"
-    "  br label %bf_code\n"
-    "\n"
-    "bf_code:\n";
+    LLVMPositionBuilderAtEnd(g->builder, search);
+    LLVMValueRef base, len, edge;
+    LLVMValueRef first = LLVMBuildPtrToInt(g->builder, g->tape, g->i64, "");
+    LLVMValueRef here = LLVMBuildPtrToInt(g->builder, start, g->i64, "");
+    if (step > 0) {
+        // (ptr, tape_end)
+        base = emit_offset(g, start, 1);
+        edge = emit_offset(g, g->tape, (int)g->tape_cells);
+        LLVMValueRef last = LLVMConstInt(g->i64, g->tape_cells - 1, 0);
+        len = LLVMBuildSub(g->builder, LLVMBuildAdd(g->builder, first, last, ""), here, "");
+    } else {
+        // [tape, ptr)
+        base = g->tape;
+        edge = emit_offset(g, g->tape, -1);
+        len = LLVMBuildSub(g->builder, here, first, "");
+    }
+    LLVMValueRef args[] = {base, LLVMConstInt(g->i32, 0, 0), len};
+    LLVMValueRef found = emit_call(g, step > 0 ? "memchr" : "memrchr", args, 3);
+    LLVMValueRef missing = LLVMBuildIsNull(g->builder, found, "");
+    LLVMBuildCondBr(g->builder, missing, overflow, end);
 
-    puts(prologue);
+    LLVMPositionBuilderAtEnd(g->builder, overflow);
+    LLVMSetVolatile(LLVMBuildLoad2(g->builder, g->cell, edge, ""), 1);
+    LLVMBuildBr(g->builder, end);
 
-    for (unsigned long i=0;text_body[i]!='\0';i++) {
-        
-        int count=1;
-        char current=text_body[i];
+    LLVMPositionBuilderAtEnd(g->builder, end);
+    g->ptr = LLVMBuildPhi(g->builder, g->ptr_type, "");
+    LLVMValueRef values[] = {start, found, edge};
+    LLVMBasicBlockRef blocks[] = {entry, search, overflow};
+    LLVMAddIncoming(g->ptr, values, blocks, 3);
+}
 
-        //combine consecutive instructions
-        if (current=='+' || current == '-' || current == '>' || current=='<'){
-            while (text_body[i+1]==current){
-                count++;
-                i++;
-            }
+// 從 ops[i] 開始連續、位移相鄰（遞增或遞減）的 OP_CLEAR 個數，例如 [-]>[-]>[-]
+static int clear_run(const struct program *prog, int i) {
+    int n = 1;
+    int dir = 0;
+    while (i + n < prog->size && prog->ops[i + n].type == OP_CLEAR) {
+        int delta = prog->ops[i + n].offset - prog->ops[i + n - 1].offset;
+        if ((delta != 1 && delta != -1) || (dir != 0 && delta != dir)) {
+            break;
         }
+        dir = delta;
+        n++;
+    }
+    return n;
+}
+
+// 迴圈一律產生 rotated 形式：進入前先判斷一次，迴圈體結尾（latch）再判斷是否回到開頭。
+// 迴圈體開頭以 phi 合併進入時與 latch 的指標，出口以 phi 合併「整個跳過」與「正常結束」兩條路徑，
+// 讓 LLVM 的迴圈 pass 直接看到歸納變數
+static void emit_loop_open(struct codegen *g, struct loop *l, const char *kind, int i) {
+    l->entry = LLVMGetInsertBlock(g->builder);
+    l->start = g->ptr;
+    char name[32];
+    snprintf(name, sizeof(name), "%s_body", kind);
+    l->body = new_block(g, name, i);
+    snprintf(name, sizeof(name), "%s_end", kind);
+    l->exit = new_block(g, name, i);
+    LLVMBuildCondBr(g->builder, emit_cell_nonzero(g), l->body, l->exit);
+    LLVMPositionBuilderAtEnd(g->builder, l->body);
+    l->phi = LLVMBuildPhi(g->builder, g->ptr_type, "");
+    LLVMAddIncoming(l->phi, &l->start, &l->entry, 1);
+    g->ptr = l->phi;
+}
 
+static void emit_loop_close(struct codegen *g, struct loop *l) {
+    LLVMBasicBlockRef latch = LLVMGetInsertBlock(g->builder);
+    LLVMValueRef end = g->ptr;
+    LLVMBuildCondBr(g->builder, emit_cell_nonzero(g), l->body, l->exit);
+    LLVMAddIncoming(l->phi, &end, &latch, 1);
+    LLVMMoveBasicBlockAfter(l->exit, latch);
+    LLVMPositionBuilderAtEnd(g->builder, l->exit);
+    LLVMValueRef exit_phi = LLVMBuildPhi(g->builder, g->ptr_type, "");
+    LLVMValueRef values[] = {l->start, end};
+    LLVMBasicBlockRef blocks[] = {l->entry, latch};
+    LLVMAddIncoming(exit_phi, values, blocks, 2);
+    g->ptr = exit_phi;
+}
+
+// 解析執行期文字 IR，並在同一個模組中把 IR（已由 bf_ir.h 做完指令合併、死代碼消除、迴圈辨識、位移折疊）
+// 翻譯為 @bf_run(ptr noalias %tape)，@main 配置紙帶後呼叫它，結束前以 @bf_flush 寫出緩衝的輸出；
+// unbuffered 時每個 @bf_putchar 之後 @bf_flush，需要從 stdin 讀取前一律 @bf_flush 送出提示文字
+static LLVMModuleRef build_module(LLVMContextRef ctx, const struct program *prog, int unbuffered, size_t tape_size) {
+    int cell_bytes = prog->cell_bits / 8;
+    int input = uses_input(prog);
+
+    size_t runtime_size = strlen(runtime_declarations) + strlen(output_runtime) + strlen(tape_runtime) + strlen(input_runtime) + 1;
+    char *runtime = malloc(runtime_size);
+    if (runtime == NULL) {
+        err("memory allocation failed");
+    }
+    snprintf(runtime, runtime_size, "%s%s%s%s", runtime_declarations, output_runtime, tape_runtime, input ? input_runtime : "");
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(runtime, strlen(runtime), "brainfuck");
+    free(runtime);
+    LLVMModuleRef module;
+    char *msg = NULL;
+    if (LLVMParseIRInContext(ctx, buffer, &module, &msg)) {
+        fprintf(stderr, "runtime IR: %s\n", msg);
+        exit(1);
+    }
+    LLVMSetSourceFileName(module, "brainfuck", strlen("brainfuck"));
+
+    struct codegen g;
+    g.ctx = ctx;
+    g.module = module;
+    g.builder = LLVMCreateBuilderInContext(ctx);
+    g.cell_bits = prog->cell_bits;
+    g.cell = LLVMIntTypeInContext(ctx, (unsigned)prog->cell_bits);
+    g.i32 = LLVMInt32TypeInContext(ctx);
+    g.i64 = LLVMInt64TypeInContext(ctx);
+    g.ptr_type = LLVMPointerType(g.cell, 0);  // opaque pointer 模式下即為 ptr
 
-        switch (current) {
-            case '>':
+    // 以下 tape_size 為位元組數
+    tape_size = (tape_size * cell_bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    LLVMSetInitializer(LLVMGetNamedGlobal(module, "bf_tape_size"), LLVMConstInt(g.i64, tape_size / cell_bytes, 0));
+    LLVMSetInitializer(LLVMGetNamedGlobal(module, "bf_cell_shift"), LLVMConstInt(g.i64, (unsigned)__builtin_ctz(cell_bytes), 0));
+
+    // Brainfuck 主函數：紙帶以 noalias 參數傳入，輸出緩衝與 read 等外部函式不可能讀寫紙帶，
+    // 儲存格的值可以跨過輸出保留在暫存器中
+    g.run = LLVMAddFunction(module, "bf_run", LLVMFunctionType(LLVMVoidTypeInContext(ctx), &g.ptr_type, 1, 0));
+    LLVMSetLinkage(g.run, LLVMInternalLinkage);
+    unsigned noalias = LLVMGetEnumAttributeKindForName("noalias", strlen("noalias"));
+    LLVMAddAttributeAtIndex(g.run, 1, LLVMCreateEnumAttribute(ctx, noalias, 0));
+    LLVMPositionBuilderAtEnd(g.builder, LLVMAppendBasicBlockInContext(ctx, g.run, "entry"));
+    g.ptr = LLVMGetParam(g.run, 0);
+    g.tape = g.ptr;
+    g.tape_cells = tape_size / cell_bytes;
+
+    // 以 [ 在 IR 中的位置作為迴圈編號，] 時取回對應的迴圈
+    struct loop *loops = calloc((size_t)prog->size, sizeof(struct loop));
+    if (loops == NULL) {
+        err("memory allocation failed");
+    }
+    for (int i = 0; i < prog->size; i++) {
+        const struct op *op = &prog->ops[i];
+        switch (op->type) {
+            case OP_ADD:
                 {
-                    int r1 = register_counter++;
-                    int r2 = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r1);
-                    printf("  %%r%d = add i32 %%r%d, %d\n", r2, r1, count);
-                    printf("  store i32 %%r%d, i32* %%ptr, align 4\n", r2);
+                    LLVMValueRef cellptr = emit_cell_ptr(&g, op->offset);
+                    LLVMValueRef val = LLVMBuildLoad2(g.builder, g.cell, cellptr, "");
+                    LLVMBuildStore(g.builder, LLVMBuildAdd(g.builder, val, const_cell(&g, op->arg), ""), cellptr);
                 }
                 break;
-            case '<':
-                {
-                    int r1 = register_counter++;
-                    int r2 = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r1);
-                    printf("  %%r%d = sub i32 %%r%d, %d\n", r2, r1, count);
-                    printf("  store i32 %%r%d, i32* %%ptr, align 4\n", r2);
-                }
+            case OP_MOVE:
+                g.ptr = emit_offset(&g, g.ptr, op->arg);
                 break;
-            case '+':
+            case OP_OUT:
                 {
-                    int r_ptr = register_counter++;
-                    int r_cellptr = register_counter++;
-                    int r_val = register_counter++;
-                    int r_new = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r_ptr);
-                    printf("  %%r%d = getelementptr inbounds [30000 x i8], [30000 x i8]* %%memory, i32 0, i32 %%r%d\n", r_cellptr, r_ptr);
-                    printf("  %%r%d = load i8, i8* %%r%d\n", r_val, r_cellptr);
-                    printf("  %%r%d = add i8 %%r%d, %d\n", r_new, r_val, count);
-                    printf("  store i8 %%r%d, i8* %%r%d\n", r_new, r_cellptr);
+                    // 只輸出最低位元組
+                    LLVMValueRef val = emit_cell_load(&g, op->offset);
+                    if (g.cell_bits > 8) {
+                        val = LLVMBuildTrunc(g.builder, val, LLVMInt8TypeInContext(ctx), "");
+                    }
+                    emit_call(&g, "bf_putchar", &val, 1);
+                    if (unbuffered) {
+                        emit_call(&g, "bf_flush", NULL, 0);
+                    }
                 }
                 break;
-            case '-':
+            case OP_IN:
                 {
-                    int r_ptr = register_counter++;
-                    int r_cellptr = register_counter++;
-                    int r_val = register_counter++;
-                    int r_new = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r_ptr);
-                    printf("  %%r%d = getelementptr inbounds [30000 x i8], [30000 x i8]* %%memory, i32 0, i32 %%r%d\n", r_cellptr, r_ptr);
-                    printf("  %%r%d = load i8, i8* %%r%d\n", r_val, r_cellptr);
-                    printf("  %%r%d = sub i8 %%r%d, %d\n", r_new, r_val, count);
-                    printf("  store i8 %%r%d, i8* %%r%d\n", r_new, r_cellptr);
+                    // EOF 的 -1 以符號延伸存入 64 位元儲存格，與解譯器相同
+                    LLVMValueRef val = emit_call(&g, "bf_getchar", NULL, 0);
+                    if (g.cell_bits < 32) {
+                        val = LLVMBuildTrunc(g.builder, val, g.cell, "");
+                    } else if (g.cell_bits > 32) {
+                        val = LLVMBuildSExt(g.builder, val, g.cell, "");
+                    }
+                    LLVMBuildStore(g.builder, val, emit_cell_ptr(&g, op->offset));
                 }
                 break;
-            case '.':
-                {
-                    int r_ptr = register_counter++;
-                    int r_cellptr = register_counter++;
-                    int r_val = register_counter++;
-                    int r_ext = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r_ptr);
-                    printf("  %%r%d = getelementptr inbounds [30000 x i8], [30000 x i8]* %%memory, i32 0, i32 %%r%d\n", r_cellptr, r_ptr);
-                    printf("  %%r%d = load i8, i8* %%r%d\n", r_val, r_cellptr);
-                    printf("  %%r%d = zext i8 %%r%d to i32\n", r_ext, r_val);
-                    printf("  call i32 @putchar(i32 %%r%d)\n", r_ext);
-                }
+            case OP_JZ:
+                emit_loop_open(&g, &loops[i], "loop", i);
                 break;
-            case ',':
-                {
-                    int r_in = register_counter++;
-                    int r_tr = register_counter++;
-                    int r_ptr = register_counter++;
-                    int r_cellptr = register_counter++;
-                    printf("  %%r%d = call i32 @getchar()\n", r_in);
-                    printf("  %%r%d = trunc i32 %%r%d to i8\n", r_tr, r_in);
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r_ptr);
-                    printf("  %%r%d = getelementptr inbounds [30000 x i8], [30000 x i8]* %%memory, i32 0, i32 %%r%d\n", r_cellptr, r_ptr);
-                    printf("  store i8 %%r%d, i8* %%r%d\n", r_tr, r_cellptr);
+            case OP_JNZ:
+                emit_loop_close(&g, &loops[op->arg]);
+                break;
+            case OP_SCAN:
+                if (g.cell_bits == 8 && (op->arg == 1 || op->arg == -1)) {
+                    emit_scan_memchr(&g, op->arg, i);
+                } else {
+                    // [>>]、[<<<] 等其他步長或較寬的儲存格：迴圈體只有指標前進
+                    struct loop scan;
+                    emit_loop_open(&g, &scan, "scan", i);
+                    g.ptr = emit_offset(&g, g.ptr, op->arg);
+                    emit_loop_close(&g, &scan);
                 }
                 break;
-            case '[':
+            case OP_MUL:
                 {
-                    int loop_id = num_brackets++;
-                    if (stack_push(&stack, loop_id) != 0) {
-                        err("Loop stack overflow");
+                    // 線性迴圈：計數格為 0 時跳過，避免以偏移量存取到紙帶外
+                    LLVMBasicBlockRef mul_body = new_block(&g, "mul_body", i);
+                    LLVMBasicBlockRef mul_end = new_block(&g, "mul_end", i);
+                    LLVMValueRef counter = emit_cell_ptr(&g, op->offset);
+                    LLVMValueRef factor = LLVMBuildLoad2(g.builder, g.cell, counter, "");
+                    LLVMValueRef nonzero = LLVMBuildICmp(g.builder, LLVMIntNE, factor, const_cell(&g, 0), "");
+                    LLVMBuildCondBr(g.builder, nonzero, mul_body, mul_end);
+                    LLVMPositionBuilderAtEnd(g.builder, mul_body);
+                    for (int j = 1; j <= op->arg; j++) {
+                        const struct op *term = &op[j];
+                        LLVMValueRef termptr = emit_cell_ptr(&g, term->offset);
+                        LLVMValueRef val = LLVMBuildLoad2(g.builder, g.cell, termptr, "");
+                        LLVMValueRef prod = LLVMBuildMul(g.builder, factor, const_cell(&g, term->arg), "");
+                        LLVMBuildStore(g.builder, LLVMBuildAdd(g.builder, val, prod, ""), termptr);
                     }
-                    printf("  br label %%bf_loop_check%d\n", loop_id);
-                    printf("\n");
-                    printf("bf_loop_check%d:\n", loop_id);
-                    int r_ptr = register_counter++;
-                    int r_cellptr = register_counter++;
-                    int r_val = register_counter++;
-                    int r_cmp = register_counter++;
-                    printf("  %%r%d = load i32, i32* %%ptr, align 4\n", r_ptr);
-                    printf("  %%r%d = getelementptr inbounds [30000 x i8], [30000 x i8]* %%memory, i32 0, i32 %%r%d\n", r_cellptr, r_ptr);
-                    printf("  %%r%d = load i8, i8* %%r%d\n", r_val, r_cellptr);
-                    printf("  %%r%d = icmp ne i8 %%r%d, 0\n", r_cmp, r_val);
-                    printf("  br i1 %%r%d, label %%bf_loop_body%d, label %%bf_loop_end%d\n", r_cmp, loop_id, loop_id);
-                    printf("\n");
-                    printf("bf_loop_body%d:\n", loop_id);
+                    LLVMBuildStore(g.builder, const_cell(&g, 0), counter);
+                    LLVMBuildBr(g.builder, mul_end);
+                    LLVMPositionBuilderAtEnd(g.builder, mul_end);
+                    i += op->arg + 1;  // 已處理後面的 OP_MUL_ADD 與 OP_CLEAR
                 }
                 break;
-            case ']':
+            case OP_MUL_ADD:
+                break;
+            case OP_CLEAR:
                 {
-                    int loop_id = -1;
-                    if (stack_pop(&stack, &loop_id) != 0) {
-                        err("Unmatched closing bracket ']'");
+                    // 相鄰的多個清零合併成一個 llvm.memset
+                    int n = clear_run(prog, i);
+                    if (n == 1) {
+                        LLVMBuildStore(g.builder, const_cell(&g, 0), emit_cell_ptr(&g, op->offset));
+                        break;
                     }
-                    printf("  br label %%bf_loop_check%d\n", loop_id);
-                    printf("\n");
-                    printf("bf_loop_end%d:\n", loop_id);
+                    int low = op->offset < op[n - 1].offset ? op->offset : op[n - 1].offset;
+                    LLVMValueRef bytes = LLVMConstInt(g.i64, (unsigned long long)n * (unsigned)cell_bytes, 0);
+                    LLVMBuildMemSet(g.builder, emit_cell_ptr(&g, low), LLVMConstInt(LLVMInt8TypeInContext(ctx), 0, 0),
+                                    bytes, (unsigned)cell_bytes);
+                    i += n - 1;
                 }
                 break;
-            default:
-                // 已於 eliminate_dead_code 過濾非指令，這裡可忽略
+            case OP_END:
                 break;
         }
     }
-    if (stack.size != 0) {
-        err("Unmatched opening bracket '['");
+    LLVMBuildRetVoid(g.builder);
+    free(loops);
+
+    // @main：配置紙帶、初始化輸入後執行程式
+    LLVMValueRef main_fn = LLVMAddFunction(module, "main", LLVMFunctionType(g.i32, NULL, 0, 0));
+    LLVMPositionBuilderAtEnd(g.builder, LLVMAppendBasicBlockInContext(ctx, main_fn, "entry"));
+    LLVMValueRef tape_args[] = {LLVMConstInt(g.i64, tape_size, 0), LLVMConstInt(g.i64, TAPE_GUARD, 0)};
+    LLVMValueRef tape = emit_call(&g, "bf_tape_init", tape_args, 2);
+    tape = LLVMBuildPointerCast(g.builder, tape, g.ptr_type, "");
+    if (input) {
+        emit_call(&g, "bf_input_init", NULL, 0);
     }
-    printf("  ret i32 0\n");
-    printf("}\n");
-}
+    LLVMBuildCall2(g.builder, LLVMGlobalGetValueType(g.run), g.run, &tape, 1, "");
+    emit_call(&g, "bf_flush", NULL, 0);
+    LLVMBuildRet(g.builder, LLVMConstInt(g.i32, 0, 0));
+    LLVMDisposeBuilder(g.builder);
 
-int main(int argc, char *argv[]) {
-    
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input file> \n",argv[0]);
+    if (LLVMVerifyModule(module, LLVMReturnStatusAction, &msg)) {
+        fprintf(stderr, "invalid module: %s\n", msg);
         exit(1);
     }
+    LLVMDisposeMessage(msg);
+    return module;
+}
 
-    char *text_body=read_file(argv[1]);
-    if (text_body==NULL) {
-        fprintf(stderr, "Could not read input file %s \n",argv[1]);
+// 以主機的 target 建立 TargetMachine，供 pass pipeline 取得目標資訊
+static LLVMTargetMachineRef host_target_machine(const char *triple, int opt_level) {
+    LLVMTargetRef target;
+    char *msg = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, &msg)) {
+        fprintf(stderr, "%s\n", msg);
         exit(1);
     }
+    char *cpu = LLVMGetHostCPUName();
+    char *features = LLVMGetHostCPUFeatures();
+    static const LLVMCodeGenOptLevel levels[] = {
+        LLVMCodeGenLevelNone, LLVMCodeGenLevelLess, LLVMCodeGenLevelDefault, LLVMCodeGenLevelAggressive,
+    };
+    LLVMTargetMachineRef tm = LLVMCreateTargetMachine(target, triple, cpu, features, levels[opt_level],
+                                                      LLVMRelocPIC, LLVMCodeModelDefault);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+    return tm;
+}
 
-    char *optimized_text=eliminate_dead_code(text_body);
-    free(text_body);
+// 以 new pass manager 的 default<On> 最佳化模組；-O0 不做任何 pass
+static void optimize_module(LLVMModuleRef module, LLVMTargetMachineRef tm, int opt_level) {
+    if (opt_level == 0) {
+        return;
+    }
+    char pipeline[32];
+    snprintf(pipeline, sizeof(pipeline), "default<O%d>", opt_level);
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    check_error(LLVMRunPasses(module, pipeline, tm, options), "optimization failed");
+    LLVMDisposePassBuilderOptions(options);
+}
 
+struct timings {
+    double build, optimize, codegen, run;
+};
 
-    // printf("Eliminated %d instructions\n",count_eliminate);
+// 文字 IR 輸出：設定主機的 triple 與 data layout，最佳化後印到 stdout
+static void emit_text(const struct program *prog, int unbuffered, size_t tape_size, int opt_level, struct timings *t) {
+    double start = now_ms();
+    LLVMContextRef ctx = LLVMContextCreate();
+    LLVMModuleRef module = build_module(ctx, prog, unbuffered, tape_size);
+    t->build = now_ms() - start;
 
+    start = now_ms();
+    char *triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetMachineRef tm = host_target_machine(triple, opt_level);
+    LLVMTargetDataRef layout = LLVMCreateTargetDataLayout(tm);
+    char *layout_str = LLVMCopyStringRepOfTargetData(layout);
+    LLVMSetTarget(module, triple);
+    LLVMSetDataLayout(module, layout_str);
+    optimize_module(module, tm, opt_level);
+    t->optimize = now_ms() - start;
 
-    compiler(optimized_text);
+    start = now_ms();
+    char *text = LLVMPrintModuleToString(module);
+    fputs(text, stdout);
+    fflush(stdout);
+    t->codegen = now_ms() - start;
 
+    LLVMDisposeMessage(text);
+    LLVMDisposeMessage(layout_str);
+    LLVMDisposeTargetData(layout);
+    LLVMDisposeTargetMachine(tm);
+    LLVMDisposeMessage(triple);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(ctx);
+}
+
+// 行程內執行：模組交給 ORC LLJIT，lookup @main 時才真正 codegen，
+// 產生的程式直接呼叫本行程的 write / mmap 等函式（DynamicLibrarySearchGenerator）
+static void run_jit(const struct program *prog, int unbuffered, size_t tape_size, int opt_level, struct timings *t) {
+    LLVMOrcLLJITRef jit;
+    check_error(LLVMOrcCreateLLJIT(&jit, NULL), "unable to create the JIT");
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMOrcDefinitionGeneratorRef process_symbols;
+    check_error(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&process_symbols, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL),
+                "unable to resolve process symbols");
+    LLVMOrcJITDylibAddGenerator(dylib, process_symbols);
+
+    double start = now_ms();
+    LLVMOrcThreadSafeContextRef tsc = LLVMOrcCreateNewThreadSafeContext();
+    LLVMModuleRef module = build_module(LLVMOrcThreadSafeContextGetContext(tsc), prog, unbuffered, tape_size);
+    t->build = now_ms() - start;
+
+    // 模組的 triple 與 data layout 必須與 JIT 一致
+    start = now_ms();
+    const char *triple = LLVMOrcLLJITGetTripleString(jit);
+    LLVMSetTarget(module, triple);
+    LLVMSetDataLayout(module, LLVMOrcLLJITGetDataLayoutStr(jit));
+    LLVMTargetMachineRef tm = host_target_machine(triple, opt_level);
+    optimize_module(module, tm, opt_level);
+    LLVMDisposeTargetMachine(tm);
+    t->optimize = now_ms() - start;
+
+    start = now_ms();
+    LLVMOrcThreadSafeModuleRef tsm = LLVMOrcCreateNewThreadSafeModule(module, tsc);
+    check_error(LLVMOrcLLJITAddLLVMIRModule(jit, dylib, tsm), "unable to add the module");
+    LLVMOrcExecutorAddress address;
+    check_error(LLVMOrcLLJITLookup(jit, &address, "main"), "unable to compile main");
+    t->codegen = now_ms() - start;
+
+    start = now_ms();
+    int (*bf_main)(void) = (int (*)(void))(uintptr_t)address;
+    bf_main();
+    t->run = now_ms() - start;
+
+    LLVMOrcDisposeThreadSafeContext(tsc);
+    check_error(LLVMOrcDisposeLLJIT(jit), "unable to dispose the JIT");
+}
+
+#define USAGE "Usage: %s [--passes LIST] [--unbuffered] [--tape-size N] [--cell-bits 8|16|32|64] [-O0|-O1|-O2|-O3] [--jit] [--timings] <input file> \n"
+
+int main(int argc, char *argv[]) {
+    unsigned passes_mask = PASS_ALL;
+    int unbuffered = 0;
+    size_t tape_size = TAPE_SIZE_DEFAULT;
+    int bits = 8;
+    int jit = 0;
+    int opt_level = -1;
+    int timings = 0;
+    const char *filepath = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes_mask = parse_pass_list(argv[++i]);
+        } else if (strcmp(argv[i], "--unbuffered") == 0) {
+            unbuffered = 1;
+        } else if (strcmp(argv[i], "--tape-size") == 0 && i + 1 < argc) {
+            tape_size = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--cell-bits") == 0 && i + 1 < argc) {
+            bits = atoi(argv[++i]);
+            if (!valid_cell_bits(bits)) {
+                err("--cell-bits must be 8, 16, 32 or 64");
+            }
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit = 1;
+        } else if (strcmp(argv[i], "--timings") == 0) {
+            timings = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '3' && argv[i][3] == '\0') {
+            opt_level = argv[i][2] - '0';
+        } else if (filepath == NULL) {
+            filepath = argv[i];
+        } else {
+            filepath = NULL;
+            break;
+        }
+    }
+    if (filepath == NULL) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+    // 文字輸出預設不最佳化（交給之後的 llc / clang），JIT 預設 -O2
+    if (opt_level < 0) {
+        opt_level = jit ? 2 : 0;
+    }
+
+    struct source src;
+    if (source_open(&src, filepath) != 0) {
+        fprintf(stderr, "Could not read input file %s \n",filepath);
+        exit(1);
+    }
 
+    struct program prog=compile_source(&src, passes_mask, bits);
+    source_close(&src);
+
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+    struct timings t = {0, 0, 0, 0};
+    if (jit) {
+        run_jit(&prog, unbuffered, tape_size, opt_level, &t);
+    } else {
+        emit_text(&prog, unbuffered, tape_size, opt_level, &t);
+    }
+    if (timings) {
+        fprintf(stderr, "timing: ir-build %.3f ms, optimize (O%d) %.3f ms, %s %.3f ms",
+                t.build, opt_level, t.optimize, jit ? "codegen" : "print", t.codegen);
+        if (jit) {
+            fprintf(stderr, ", run %.3f ms", t.run);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    free_program(&prog);
     return 0;
-}
\ No newline at end of file
+}
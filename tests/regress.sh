@@ -0,0 +1,189 @@
+#!/bin/bash
+# 回歸測試（make test）：每個案例執行一個命令，比較合併後的 stdout / stderr 與結束狀態。
+# 案例都是固定輸入的小程式，不依賴時間或環境；失敗時印出預期與實際的輸出，結束狀態為 1。
+# 每個案例限制 20 秒 CPU 時間，卡住的程式（例如步長 0 的掃描）算作失敗而不是讓測試停住。
+# 用法：tests/regress.sh [BUILD]（預設為 build）
+
+BUILD=${1:-build}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+passed=0
+failed=0
+
+# check NAME EXPECTED_OUTPUT EXPECTED_STATUS COMMAND...
+check(){
+    local name=$1 want=$2 want_status=$3
+    shift 3
+    local got status
+    got=$( (ulimit -t 20; "$@") 2>&1)
+    status=$?
+    if [ "$got" == "$want" ] && [ "$status" -eq "$want_status" ]; then
+        passed=$((passed + 1))
+    else
+        failed=$((failed + 1))
+        echo "FAIL $name"
+        echo "  expected (status $want_status): $want"
+        echo "  got      (status $status): $got"
+    fi
+}
+
+# program NAME SOURCE：把原始碼寫到 $WORK/NAME.bf
+program(){
+    printf '%s' "$2" > "$WORK/$1.bf"
+}
+
+# elf FLAGS... PROGRAM：以 compiler_x86_64 --emit-elf 編譯並執行
+elf(){
+    local args=("$@")
+    local source=${args[-1]}
+    rm -f "$WORK/elf.out"
+    "$BUILD/compiler_x86_64" "${args[@]:0:${#args[@]}-1}" --emit-elf "$WORK/elf.out" "$source" && "$WORK/elf.out"
+}
+
+ENGINES=("" "--jit" "--tiered" "--passes none" "--cell-bits 16")
+
+# 紙帶越界：指標移動與掃描迴圈在每個引擎都由保護頁攔截並回報同一格
+program left '<+'
+program scan_left "+[<]$(printf '+%.0s' {1..49})."
+program scan_left3 '+[<<<]+.'
+program scan_right "+$(printf '>+%.0s' {1..4095})$(printf '<%.0s' {1..4095})[>]+."
+program scan_right3 "+$(printf '>+%.0s' {1..4095})$(printf '<%.0s' {1..4095})[>>>]+."
+for engine in "${ENGINES[@]}"; do
+    size=32768
+    [ "$engine" == "--cell-bits 16" ] && size=30720
+    check "left $engine" "tape overflow: cell -1 is outside the tape [0, $size)" 1 "$BUILD/interpreter" $engine "$WORK/left.bf"
+    check "scan_left $engine" "tape overflow: cell -1 is outside the tape [0, $size)" 1 "$BUILD/interpreter" $engine "$WORK/scan_left.bf"
+    check "scan_left3 $engine" "tape overflow: cell -3 is outside the tape [0, $size)" 1 "$BUILD/interpreter" $engine "$WORK/scan_left3.bf"
+    check "scan_right $engine" "tape overflow: cell 4096 is outside the tape [0, 4096)" 1 "$BUILD/interpreter" $engine --tape-size 4096 "$WORK/scan_right.bf"
+    check "scan_right3 $engine" "tape overflow: cell 4098 is outside the tape [0, 4096)" 1 "$BUILD/interpreter" $engine --tape-size 4096 "$WORK/scan_right3.bf"
+done
+check "scan_left elf" "tape overflow: cell -1 is outside the tape [0, 32768)" 1 elf "$WORK/scan_left.bf"
+check "scan_right elf" "tape overflow: cell 4096 is outside the tape [0, 4096)" 1 elf --tape-size 4096 "$WORK/scan_right.bf"
+check "scan_left llvm" "tape overflow: cell -1 is outside the tape [0, 32768)" 1 "$BUILD/compiler_llvm" --jit "$WORK/scan_left.bf"
+check "scan_right llvm" "tape overflow: cell 4096 is outside the tape [0, 4096)" 1 "$BUILD/compiler_llvm" --jit --tape-size 4096 "$WORK/scan_right.bf"
+# 越界前已緩衝的輸出先送出，再回報位置
+program flush '++++++++[>++++++++<-]>+.[<<]'
+check "flush interpreter" "Atape overflow: cell -1 is outside the tape [0, 32768)" 1 "$BUILD/interpreter" "$WORK/flush.bf"
+check "flush elf" "Atape overflow: cell -1 is outside the tape [0, 32768)" 1 elf "$WORK/flush.bf"
+check "flush llvm" "Atape overflow: cell -1 is outside the tape [0, 32768)" 1 "$BUILD/compiler_llvm" --jit "$WORK/flush.bf"
+check "flush llvm -O0" "Atape overflow: cell -1 is outside the tape [0, 32768)" 1 "$BUILD/compiler_llvm" --jit -O0 "$WORK/flush.bf"
+
+# .bfc 驗證：檢查碼正確但內容偽造的檔案也要在執行前被拒絕
+# bfc_patch FILE INDEX FIELD VALUE：把第 INDEX 個 op 的第 FIELD 個 int（0 type、1 arg、2 offset）改為 VALUE，
+# 並重新計算標頭的 FNV-1a 64 檢查碼
+bfc_patch(){
+    local file=$1 at=$((32 + $2 * 16 + $3 * 4)) value=$4 h=-3750763034362895579 byte
+    printf "$(printf '\\x%02x\\x%02x\\x%02x\\x%02x' $((value & 255)) $((value >> 8 & 255)) $((value >> 16 & 255)) $((value >> 24 & 255)))" |
+        dd of="$file" bs=1 seek=$at conv=notrunc status=none
+    for byte in $(od -A n -t u1 -v -j 32 "$file"); do
+        h=$(((h ^ byte) * 1099511628211))
+    done
+    printf "$(for k in 0 1 2 3 4 5 6 7; do printf '\\x%02x' $((h >> (8 * k) & 255)); done)" |
+        dd of="$file" bs=1 seek=24 conv=notrunc status=none
+}
+
+# ops：0 ADD、1 SCAN(1)、2 ADD、3 MUL、4 MUL_ADD(offset 1)、5 CLEAR、6 END
+program bfc "+[>]+[>+<-]$(printf '+%.0s' {1..48})."
+"$BUILD/interpreter" --emit-bfc "$WORK/ok.bfc" "$WORK/bfc.bf"
+check "bfc valid" "0" 0 "$BUILD/interpreter" "$WORK/ok.bfc"
+cp "$WORK/ok.bfc" "$WORK/same.bfc"
+bfc_patch "$WORK/same.bfc" 1 1 1
+check "bfc re-checksummed" "0" 0 "$BUILD/interpreter" "$WORK/same.bfc"
+cp "$WORK/ok.bfc" "$WORK/checksum.bfc"
+printf '\002' | dd of="$WORK/checksum.bfc" bs=1 seek=36 conv=notrunc status=none
+check "bfc checksum" ".bfc checksum mismatch" 1 "$BUILD/interpreter" "$WORK/checksum.bfc"
+head -c 100 "$WORK/ok.bfc" > "$WORK/truncated.bfc"
+check "bfc truncated" "truncated or malformed .bfc file" 1 "$BUILD/interpreter" "$WORK/truncated.bfc"
+for patch in "jump 1 0 4" "scan_zero 1 1 0" "scan_far 1 1 1048576" "offset_far 4 2 -1048576" "mul_count 3 1 9" "opcode 2 0 42"; do
+    set -- $patch
+    cp "$WORK/ok.bfc" "$WORK/$1.bfc"
+    bfc_patch "$WORK/$1.bfc" $2 $3 $4
+    check "bfc $1" "corrupt .bfc instruction stream" 1 "$BUILD/interpreter" "$WORK/$1.bfc"
+done
+
+# 每個欄位都互指、只有結構錯誤的偽造檔，以前會讓 --jit / --tiered 用到未回填的跳躍位置
+# ops：0 ADD、1 JZ(8)、2 ADD、3 MUL(1)、4 MUL_ADD、5 CLEAR、6 OUT、7 ADD、8 JNZ(1)、9 END
+program loops '++[>+[>++<-]>.<<-]'
+"$BUILD/interpreter" --emit-bfc "$WORK/loops.bfc" "$WORK/loops.bf"
+# 線性迴圈的項目換成 ]（與 op 1 的 [ 互指），原本的 ] 改為 ADD 0
+cp "$WORK/loops.bfc" "$WORK/mul_body.bfc"
+for patch in "4 0 5" "4 1 1" "1 1 4" "8 0 0" "8 1 0"; do
+    bfc_patch "$WORK/mul_body.bfc" $patch
+done
+# 線性迴圈的項目換成指標移動
+cp "$WORK/loops.bfc" "$WORK/mul_move.bfc"
+bfc_patch "$WORK/mul_move.bfc" 4 0 1
+# ops：0 ADD、1 JZ(10)、2 MOVE、3 ADD、4 JZ(7)、5 OUT、6 ADD、7 JNZ(4)、8 ADD、9 MOVE、10 JNZ(1)、11 END；
+# 改成交錯的 [1↔7] [4↔10]
+program nested '++[>+[.-]<-]'
+"$BUILD/interpreter" --emit-bfc "$WORK/nested.bfc" "$WORK/nested.bf"
+cp "$WORK/nested.bfc" "$WORK/cross.bfc"
+for patch in "1 1 7" "7 1 1" "4 1 10" "10 1 4"; do
+    bfc_patch "$WORK/cross.bfc" $patch
+done
+for engine in "" "--jit" "--tiered --tier-threshold 1"; do
+    check "bfc loops $engine" $'\002\004' 0 "$BUILD/interpreter" $engine "$WORK/loops.bfc"
+    for name in mul_body mul_move cross; do
+        check "bfc $name $engine" "corrupt .bfc instruction stream" 1 "$BUILD/interpreter" $engine "$WORK/$name.bfc"
+    done
+done
+
+# 儲存格寬度（--cell-bits）：加減在 2^N 繞回，輸出只取最低的位元組
+# pow8 / pow16 / pow32 依序算出 2^8、2^16、2^32（16 × 16，再乘兩次 256），非零時印出 1；
+# 非零分支先移到下一個空格再印，不必逐次清除；不合併加減的 --passes none 需要 2^32 次遞增才到得了 2^32，不跑 pow32
+nonzero="[>$(printf '+%.0s' {1..49}).>]"
+times256="[>$(printf '+%.0s' {1..256})<-]>"
+program wrap_out '-.'
+program wrap_back "-+$(printf '+%.0s' {1..48})."
+program pow8 "$(printf '+%.0s' {1..16})[>$(printf '+%.0s' {1..16})<-]>$nonzero"
+program pow16 "$(printf '+%.0s' {1..16})[>$(printf '+%.0s' {1..16})<-]>$times256$nonzero"
+program pow32 "$(printf '+%.0s' {1..16})[>$(printf '+%.0s' {1..16})<-]>$times256$times256$times256$nonzero"
+for bits in 8 16 32 64; do
+    p8=1 p16=1 p32=1
+    [ "$bits" -le 8 ] && p8=
+    [ "$bits" -le 16 ] && p16=
+    [ "$bits" -le 32 ] && p32=
+    for engine in "" "--jit" "--tiered" "--passes none"; do
+        check "wrap_out $bits $engine" $'\377' 0 "$BUILD/interpreter" $engine --cell-bits $bits "$WORK/wrap_out.bf"
+        check "wrap_back $bits $engine" "0" 0 "$BUILD/interpreter" $engine --cell-bits $bits "$WORK/wrap_back.bf"
+        check "pow8 $bits $engine" "$p8" 0 "$BUILD/interpreter" $engine --cell-bits $bits "$WORK/pow8.bf"
+        check "pow16 $bits $engine" "$p16" 0 "$BUILD/interpreter" $engine --cell-bits $bits "$WORK/pow16.bf"
+        [ "$engine" != "--passes none" ] &&
+            check "pow32 $bits $engine" "$p32" 0 "$BUILD/interpreter" $engine --cell-bits $bits "$WORK/pow32.bf"
+    done
+    for compiler in elf "$BUILD/compiler_llvm --jit"; do
+        check "wrap_out $bits $compiler" $'\377' 0 $compiler --cell-bits $bits "$WORK/wrap_out.bf"
+        check "pow8 $bits $compiler" "$p8" 0 $compiler --cell-bits $bits "$WORK/pow8.bf"
+        check "pow16 $bits $compiler" "$p16" 0 $compiler --cell-bits $bits "$WORK/pow16.bf"
+        check "pow32 $bits $compiler" "$p32" 0 $compiler --cell-bits $bits "$WORK/pow32.bf"
+    done
+done
+
+# 編譯快取：第二次執行命中快取，輸出（與 --emit-elf 寫出的檔案）和第一次相同；影響產生內容的選項改變時不命中
+# quiet COMMAND...：只保留 stderr（快取統計），避免與程式輸出的順序互相影響
+quiet(){
+    "$@" > /dev/null
+}
+program cached '+++++++[>++++++++<-]>.'
+for engine in "" "--jit" "--tiered"; do
+    dir="$WORK/cache$engine"
+    check "cache miss $engine" "8" 0 "$BUILD/interpreter" $engine --cache-dir "$dir" "$WORK/cached.bf"
+    check "cache hit $engine" "8" 0 "$BUILD/interpreter" $engine --cache-dir "$dir" "$WORK/cached.bf"
+    check "cache stats $engine" "cache: 1 hits, 0 misses, 0 stored, 0 evicted (total 2 hits, 1 misses) in $dir" 0 \
+        quiet "$BUILD/interpreter" $engine --cache-dir "$dir" --cache-stats "$WORK/cached.bf"
+done
+dir="$WORK/cache-elf"
+check "cache elf miss" "cache: 0 hits, 1 misses, 1 stored, 0 evicted (total 0 hits, 1 misses) in $dir" 0 \
+    "$BUILD/compiler_x86_64" --cache-dir "$dir" --cache-stats --emit-elf "$WORK/first.elf" "$WORK/cached.bf"
+check "cache elf hit" "cache: 1 hits, 0 misses, 0 stored, 0 evicted (total 1 hits, 1 misses) in $dir" 0 \
+    "$BUILD/compiler_x86_64" --cache-dir "$dir" --cache-stats --emit-elf "$WORK/second.elf" "$WORK/cached.bf"
+check "cache elf same file" "" 0 cmp "$WORK/first.elf" "$WORK/second.elf"
+check "cache elf run" "8" 0 "$WORK/second.elf"
+check "cache elf tape size" "cache: 0 hits, 1 misses, 1 stored, 0 evicted (total 1 hits, 2 misses) in $dir" 0 \
+    "$BUILD/compiler_x86_64" --cache-dir "$dir" --cache-stats --tape-size 4096 --emit-elf "$WORK/third.elf" "$WORK/cached.bf"
+check "cache elf unbuffered" "cache: 0 hits, 1 misses, 1 stored, 0 evicted (total 1 hits, 3 misses) in $dir" 0 \
+    "$BUILD/compiler_x86_64" --cache-dir "$dir" --cache-stats --unbuffered --emit-elf "$WORK/fourth.elf" "$WORK/cached.bf"
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]
@@ -1,6 +1,15 @@
-#include <assert.h>
+#ifndef UTIL_H
+#define UTIL_H
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+// 多執行緒的程式（bf_batch）在 include 之前定義為 _Thread_local，
+// 讓 bf_io.h 的緩衝與 bf_tape.h 的紙帶每個執行緒各自一份；單執行緒的解譯器不受影響
+#ifndef BF_THREAD_LOCAL
+#define BF_THREAD_LOCAL
+#endif
 
 //print error message and exit
 static inline void err(const char *msg){
@@ -8,59 +17,32 @@ static inline void err(const char *msg){
     exit(1);
 }
 
-static inline char *read_file(const char *const filename){
-    if (filename ==NULL){
-        return NULL;
+//parse a size such as "30000", "64K", "16M" or "2G"; exit on invalid input
+static inline size_t parse_size(const char *text){
+    char *end;
+    unsigned long long n=strtoull(text,&end,10);
+    switch (*end){
+        case 'k': case 'K': n<<=10; end++; break;
+        case 'm': case 'M': n<<=20; end++; break;
+        case 'g': case 'G': n<<=30; end++; break;
+        default: break;
     }
-
-    FILE *fp=fopen(filename,"r");
-    if (fp==NULL){
-        return NULL;
+    if (end==text || *end!='\0' || n==0){
+        err("invalid size (use a positive number with an optional K, M or G suffix)");
     }
-
-    //fp move to the end of the file，using ftell(fp) to get the file size
-    assert(!fseek(fp,0,SEEK_END));
-    long file_size=ftell(fp);
-
-    //remove to beginning of the file
-    rewind(fp);
-
-    size_t code_size=sizeof(char)*(file_size+1);
-    char *code=malloc(code_size);
-
-    if (code==NULL){
-        return NULL;
-    }
-
-    //read the file into the code
-    fread(code,1,file_size,fp);
-    code[file_size]='\0';
-    assert(!fclose(fp));
-    return code;
-   
+    return (size_t)n;
 }
 
-#define STACKSIZE 100
-
-struct stack{
-    int size;
-    int items[STACKSIZE];
-};
+//64-bit FNV-1a, continuing from h (start with FNV1A_64_OFFSET)
+#define FNV1A_64_OFFSET 0xcbf29ce484222325ULL
 
-static inline int stack_push(struct stack * const p,const int x){
-    if (p->size==STACKSIZE){
-        return -1;
+static inline uint64_t fnv1a_64(uint64_t h,const void *data,size_t n){
+    const unsigned char *p=data;
+    for (size_t i=0;i<n;i++){
+        h^=p[i];
+        h*=0x100000001b3ULL;
     }
-
-    p->items[p->size++]=x;
-    return 0;
+    return h;
 }
 
-static inline int stack_pop(struct stack * const p,int *x){
-    if (p->size==0){
-        return -1;
-    }
-
-    *x=p->items[--p->size];
-    return 0;
-}
\ No newline at end of file
+#endif